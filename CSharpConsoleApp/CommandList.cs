@@ -0,0 +1,103 @@
+﻿using System;
+using System.Collections.Generic;
+using System.Linq;
+using System.Text;
+using System.Threading.Tasks;
+
+namespace CSharpConsoleApp
+{
+    enum DmaDirection : uint
+    {
+        MM2S = 1,
+        S2MM = 2,
+        Both = 3
+    }
+
+    /// <summary>
+    /// Records register and DDR operations and submits them to the library in a single call.
+    /// The layout matches the CommandOp description in M3202A_Library.h.
+    /// </summary>
+    class CommandList
+    {
+        private const UInt32 RegWriteOp = 1;
+        private const UInt32 RegArrayWriteOp = 2;
+        private const UInt32 DdrWriteOp = 3;
+        private const UInt32 DdrCopyOp = 4;
+        private const UInt32 WaitIdleOp = 5;
+
+        private readonly List<UInt32> _mCommands = new List<UInt32>();
+
+        /// <summary>
+        /// Number of commands recorded since the last Clear().
+        /// </summary>
+        public int Count { get; private set; }
+
+        private void AddAddress(UInt64 address)
+        {
+            _mCommands.Add((UInt32)(address & 0xFFFFFFFF));
+            _mCommands.Add((UInt32)(address >> 32));
+        }
+
+        public void RegWrite(UInt64 address, UInt32 value)
+        {
+            _mCommands.Add(RegWriteOp);
+            AddAddress(address);
+            _mCommands.Add(value);
+            Count++;
+        }
+
+        public void RegArrayWrite(UInt32[] data, UInt64 address, UInt32 length)
+        {
+            _mCommands.Add(RegArrayWriteOp);
+            AddAddress(address);
+            _mCommands.Add(length);
+            _mCommands.AddRange(data.Take((int)length));
+            Count++;
+        }
+
+        public void DdrWrite(UInt32[] data, UInt64 address, UInt32 length)
+        {
+            _mCommands.Add(DdrWriteOp);
+            AddAddress(address);
+            _mCommands.Add(length);
+            _mCommands.AddRange(data.Take((int)length));
+            Count++;
+        }
+
+        public void DdrCopy(UInt64 srcAddr, UInt64 destAddr, UInt32 length)
+        {
+            _mCommands.Add(DdrCopyOp);
+            AddAddress(srcAddr);
+            AddAddress(destAddr);
+            _mCommands.Add(length);
+            Count++;
+        }
+
+        /// <summary>
+        /// Blocks the list until the given channels of the DMA at dmaBaseAddr are idle.
+        /// </summary>
+        public void WaitIdle(UInt64 dmaBaseAddr, DmaDirection direction)
+        {
+            _mCommands.Add(WaitIdleOp);
+            AddAddress(dmaBaseAddr);
+            _mCommands.Add((UInt32)direction);
+            Count++;
+        }
+
+        public void Clear()
+        {
+            _mCommands.Clear();
+            Count = 0;
+        }
+
+        /// <summary>
+        /// Executes the recorded commands. On failure failedCommand is the index of the command that failed.
+        /// </summary>
+        public int Submit(out UInt32 failedCommand)
+        {
+            failedCommand = 0;
+            var commands = _mCommands.ToArray();
+            return FpgaOp.CommandListSubmit(commands, (UInt32)commands.Length, ref failedCommand);
+        }
+    }
+}
@@ -7,6 +7,233 @@ using System.Threading.Tasks;
 
 namespace CSharpConsoleApp
 {
+    // LibraryError of M3202A_Library.h, returned next to the RSP error codes
+    enum LibraryError : int
+    {
+        Timeout = -1000,
+        Cancelled = -1001,
+        DmaFault = -1002
+    }
+
+    [StructLayout(LayoutKind.Sequential)]
+    struct StreamStats
+    {
+        public UInt64 bytesWritten;
+        public UInt64 bytesRead;
+        public UInt64 chunksWritten;
+        public UInt64 chunksRead;
+        public UInt64 producerStalls;
+        public UInt64 consumerStalls;
+        public UInt64 writeQueued;
+        public UInt64 readQueued;
+        public double writeBytesPerSecond;
+        public double readBytesPerSecond;
+    }
+
+    [StructLayout(LayoutKind.Sequential)]
+    struct EtConfig
+    {
+        public UInt64 etRegBase;
+        public UInt64 dmaRegBase;
+        [MarshalAs(UnmanagedType.ByValArray, SizeConst = 2)]
+        public UInt64[] paInAddr;
+        [MarshalAs(UnmanagedType.ByValArray, SizeConst = 2)]
+        public UInt64[] envOutAddr;
+        public UInt32 samplesPerBlock;
+        public UInt32 osr;
+    }
+
+    [StructLayout(LayoutKind.Sequential)]
+    struct EtStats
+    {
+        public UInt64 blocks;
+        public UInt64 inputSamples;
+        public UInt64 outputSamples;
+        public double seconds;
+        public double samplesPerSecond;
+        public double uploadSeconds;
+        public double readbackSeconds;
+        public double waitSeconds;
+    }
+
+    [StructLayout(LayoutKind.Sequential)]
+    struct DmaChannelStatus
+    {
+        public UInt32 raw;
+        public UInt32 halted;
+        public UInt32 idle;
+        public UInt32 error;
+        public UInt32 ioc;
+    }
+
+    [StructLayout(LayoutKind.Sequential)]
+    struct DmaStatus
+    {
+        public DmaChannelStatus mm2s;
+        public DmaChannelStatus s2mm;
+    }
+
+    [StructLayout(LayoutKind.Sequential)]
+    struct DmaErrorCounters
+    {
+        public UInt64 chunks;
+        public UInt64 faults;
+        public UInt64 retries;
+        public UInt64 failures;
+    }
+
+    [StructLayout(LayoutKind.Sequential)]
+    struct LutStats
+    {
+        public UInt64 loads;
+        public UInt64 swaps;
+        public UInt64 writes;
+        public UInt64 entriesWritten;
+        public UInt64 entriesSkipped;
+    }
+
+    [StructLayout(LayoutKind.Sequential)]
+    struct DdrMapStats
+    {
+        public UInt64 readFaults;
+        public UInt64 writeFaults;
+        public UInt64 pagesFetched;
+        public UInt64 bytesFetched;
+        public UInt64 pagesWrittenBack;
+        public UInt64 bytesWrittenBack;
+        public UInt64 writeBacks;
+        public UInt64 fetchErrors;
+    }
+
+    [StructLayout(LayoutKind.Sequential)]
+    struct DdrReaderStats
+    {
+        public UInt64 reads;
+        public UInt64 hits;
+        public UInt64 misses;
+        public UInt64 waits;
+        public UInt64 resets;
+        public UInt64 bytesFromRing;
+        public UInt64 bytesDirect;
+        public UInt64 bytesPrefetched;
+    }
+
+    [StructLayout(LayoutKind.Sequential)]
+    struct TransferProgress
+    {
+        public UInt64 bytesDone;
+        public UInt64 bytesTotal;
+        public UInt32 finished;
+        public Int32 result;
+        public double seconds;
+    }
+
+    [StructLayout(LayoutKind.Sequential)]
+    struct IoClassStats
+    {
+        public UInt64 requests;
+        public UInt64 bytes;
+        public double meanSeconds;
+        public double p50Seconds;
+        public double p99Seconds;
+        public double p999Seconds;
+        public double maxSeconds;
+    }
+
+    [StructLayout(LayoutKind.Sequential)]
+    struct IoSchedulerStats
+    {
+        public UInt64 pieces;
+        public UInt64 queued;
+        [MarshalAs(UnmanagedType.ByValArray, SizeConst = 3)]
+        public IoClassStats[] classes;
+    }
+
+    [StructLayout(LayoutKind.Sequential)]
+    struct WaveformInfo
+    {
+        public UInt64 samples;
+        public UInt64 fileBytes;
+        public UInt32 blockSamples;
+        public UInt32 blocks;
+        public double scale;
+    }
+
+    [StructLayout(LayoutKind.Sequential)]
+    struct WaveformUploadStats
+    {
+        public UInt64 samples;
+        public UInt64 fileBytes;
+        public double readSeconds;
+        public double decodeSeconds;
+        public double writeSeconds;
+        public double seconds;
+    }
+
+    [StructLayout(LayoutKind.Sequential)]
+    struct TelemetrySample
+    {
+        public UInt64 timeNs;
+        public UInt32 sessionIdx;
+        public UInt32 queueDepth;
+        public UInt64 bytesToDdr;
+        public UInt64 bytesFromDdr;
+        public UInt64 bytesCopied;
+        public UInt64 pagerSwitches;
+        public double toDdrBytesPerSecond;
+        public double fromDdrBytesPerSecond;
+        [MarshalAs(UnmanagedType.ByValArray, SizeConst = 2)]
+        public double[] dmaBusy;
+    }
+
+    // Runs on the transfer thread; keep the delegate referenced until TransferClose
+    [UnmanagedFunctionPointer(CallingConvention.Cdecl)]
+    delegate void TransferCallback(UInt32 transferIdx, UInt64 bytesDone, UInt64 bytesTotal, IntPtr user);
+
+    [StructLayout(LayoutKind.Sequential)]
+    struct EnvelopeConfig
+    {
+        public double scale;
+        public UInt32 decimation;
+        public UInt32 histogramBins;
+    }
+
+    [StructLayout(LayoutKind.Sequential)]
+    struct EnvelopeStats
+    {
+        public UInt64 samples;
+        public UInt64 outputSamples;
+        public double min;
+        public double max;
+        public double mean;
+        public double rms;
+        public double readSeconds;
+        public double processSeconds;
+    }
+
+    [StructLayout(LayoutKind.Sequential)]
+    struct TraceOpStats
+    {
+        public UInt64 calls;
+        public UInt64 bytes;
+        public double recordedSeconds;
+        public double replaySeconds;
+        public double maxReplaySeconds;
+    }
+
+    [StructLayout(LayoutKind.Sequential)]
+    struct TraceReplayStats
+    {
+        public UInt64 records;
+        public UInt64 errors;
+        public UInt64 mismatches;
+        public double recordedSeconds;
+        public double recordedIdleSeconds;
+        public double replaySeconds;
+        [MarshalAs(UnmanagedType.ByValArray, SizeConst = 8)]
+        public TraceOpStats[] ops;
+    }
+
     class FpgaOp
     {
         [DllImport("M3202A_Library.dll", CallingConvention = CallingConvention.Cdecl, EntryPoint = "RegRead")]
@@ -33,8 +260,25 @@ namespace CSharpConsoleApp
         [DllImport("M3202A_Library.dll", CallingConvention = CallingConvention.Cdecl, EntryPoint = "RegArrayWrite")]
         public static extern int RegArrayWrite(UInt32[]data, UInt64 address, UInt32 length);
 
-        public int[] StreamRead(int streamIdx, int length) { return null; }
-        public void StreamWrite(int streamIdx, int[] data, int length) {}
+        [DllImport("M3202A_Library.dll", CallingConvention = CallingConvention.Cdecl, EntryPoint = "StreamOpen")]
+        public static extern int StreamOpen(UInt32 streamIdx, UInt32 chunkBytes, UInt32 ringBytes);
+
+        // length counts 32-bit words and must be even, kernel streams move 64-bit words
+        [DllImport("M3202A_Library.dll", CallingConvention = CallingConvention.Cdecl, EntryPoint = "StreamWrite")]
+        public static extern int StreamWrite(UInt32 streamIdx, UInt32[] data, UInt32 length);
+
+        [DllImport("M3202A_Library.dll", CallingConvention = CallingConvention.Cdecl, EntryPoint = "StreamRead")]
+        public static extern int StreamRead(UInt32 streamIdx, UInt32[] data, UInt32 length);
+
+        [DllImport("M3202A_Library.dll", CallingConvention = CallingConvention.Cdecl, EntryPoint = "StreamFlush")]
+        public static extern int StreamFlush(UInt32 streamIdx);
+
+        [DllImport("M3202A_Library.dll", CallingConvention = CallingConvention.Cdecl, EntryPoint = "StreamGetStats")]
+        public static extern int StreamGetStats(UInt32 streamIdx, ref StreamStats stats);
+
+        // returns LIBRARY_TIMEOUT (-1000) if the kernel never delivered a pending read
+        [DllImport("M3202A_Library.dll", CallingConvention = CallingConvention.Cdecl, EntryPoint = "StreamClose")]
+        public static extern int StreamClose(UInt32 streamIdx);
 
         [DllImport("M3202A_Library.dll", CallingConvention = CallingConvention.Cdecl, EntryPoint = "DdrRead")]
         public static extern int DdrRead(UInt32[] data, UInt64 address, UInt32 length);
@@ -44,5 +288,195 @@ namespace CSharpConsoleApp
 
         [DllImport("M3202A_Library.dll", CallingConvention = CallingConvention.Cdecl, EntryPoint = "DdrCopy")]
         public static extern int DdrCopy(UInt64 srcAddr, UInt64 destAddr, UInt32 length);
+
+        [DllImport("M3202A_Library.dll", CallingConvention = CallingConvention.Cdecl, EntryPoint = "EtRun")]
+        public static extern int EtRun(ref EtConfig config, UInt32[] iqIn, UInt32[] envOut, UInt32 numBlocks, ref EtStats stats);
+
+        [DllImport("M3202A_Library.dll", CallingConvention = CallingConvention.Cdecl, EntryPoint = "CommandListSubmit")]
+        public static extern int CommandListSubmit(UInt32[] commands, UInt32 length, ref UInt32 failedCommand);
+
+        [DllImport("M3202A_Library.dll", CallingConvention = CallingConvention.Cdecl, EntryPoint = "DmaGetStatus")]
+        public static extern int DmaGetStatus(UInt64 dmaBaseAddr, ref DmaStatus status);
+
+        [DllImport("M3202A_Library.dll", CallingConvention = CallingConvention.Cdecl, EntryPoint = "DmaGetStatusAll")]
+        public static extern int DmaGetStatusAll([Out] DmaStatus[] status);
+
+        [DllImport("M3202A_Library.dll", CallingConvention = CallingConvention.Cdecl, EntryPoint = "DmaGetErrorCounters")]
+        public static extern int DmaGetErrorCounters(ref DmaErrorCounters counters);
+
+        [DllImport("M3202A_Library.dll", CallingConvention = CallingConvention.Cdecl, EntryPoint = "DmaResetErrorCounters")]
+        public static extern void DmaResetErrorCounters();
+
+        [DllImport("M3202A_Library.dll", CallingConvention = CallingConvention.Cdecl, EntryPoint = "Crc32c")]
+        public static extern UInt32 Crc32c(UInt32 crc, UInt32[] data, UInt32 length);
+
+        [DllImport("M3202A_Library.dll", CallingConvention = CallingConvention.Cdecl, EntryPoint = "DdrWriteCrc")]
+        public static extern int DdrWriteCrc(UInt32[] data, UInt64 address, UInt32 length, ref UInt32 crc);
+
+        [DllImport("M3202A_Library.dll", CallingConvention = CallingConvention.Cdecl, EntryPoint = "DdrReadCrc")]
+        public static extern int DdrReadCrc(UInt32[] data, UInt64 address, UInt32 length, ref UInt32 crc);
+
+        [DllImport("M3202A_Library.dll", CallingConvention = CallingConvention.Cdecl, EntryPoint = "DdrCopyCrc")]
+        public static extern int DdrCopyCrc(UInt64 srcAddr, UInt64 destAddr, UInt32 length, ref UInt32 crc);
+
+        [DllImport("M3202A_Library.dll", CallingConvention = CallingConvention.Cdecl, EntryPoint = "DdrChecksum")]
+        public static extern int DdrChecksum(UInt64 address, UInt32 length, ref UInt32 crc);
+
+        /// <summary>
+        /// Address value marking the second bank and select register as absent.
+        /// </summary>
+        public const UInt64 LutNoAddress = UInt64.MaxValue;
+
+        [DllImport("M3202A_Library.dll", CallingConvention = CallingConvention.Cdecl, EntryPoint = "LutOpen")]
+        public static extern int LutOpen(UInt32 lutIdx, UInt64 bank0Address, UInt64 bank1Address, UInt64 selectAddress, UInt32 length);
+
+        [DllImport("M3202A_Library.dll", CallingConvention = CallingConvention.Cdecl, EntryPoint = "LutLoad")]
+        public static extern int LutLoad(UInt32 lutIdx, UInt32[] table, ref UInt32 entriesWritten);
+
+        [DllImport("M3202A_Library.dll", CallingConvention = CallingConvention.Cdecl, EntryPoint = "LutSwap")]
+        public static extern int LutSwap(UInt32 lutIdx);
+
+        [DllImport("M3202A_Library.dll", CallingConvention = CallingConvention.Cdecl, EntryPoint = "LutInvalidate")]
+        public static extern int LutInvalidate(UInt32 lutIdx);
+
+        [DllImport("M3202A_Library.dll", CallingConvention = CallingConvention.Cdecl, EntryPoint = "LutGetStats")]
+        public static extern int LutGetStats(UInt32 lutIdx, ref LutStats stats);
+
+        [DllImport("M3202A_Library.dll", CallingConvention = CallingConvention.Cdecl, EntryPoint = "LutClose")]
+        public static extern int LutClose(UInt32 lutIdx);
+
+        [DllImport("M3202A_Library.dll", CallingConvention = CallingConvention.Cdecl, EntryPoint = "SessionOpenDevice")]
+        public static extern int SessionOpenDevice(UInt32 sessionIdx, string deviceId);
+
+        [DllImport("M3202A_Library.dll", CallingConvention = CallingConvention.Cdecl, EntryPoint = "SessionCloseDevice")]
+        public static extern int SessionCloseDevice(UInt32 sessionIdx);
+
+        [DllImport("M3202A_Library.dll", CallingConvention = CallingConvention.Cdecl, EntryPoint = "DdrPeerCopy")]
+        public static extern int DdrPeerCopy(UInt32 srcSession, UInt64 srcAddr, UInt32 destSession, UInt64 destAddr, UInt32 length);
+
+        [DllImport("M3202A_Library.dll", CallingConvention = CallingConvention.Cdecl, EntryPoint = "DdrMapOpen")]
+        public static extern int DdrMapOpen(UInt32 mapIdx, UInt64 address, UInt32 length, out IntPtr view);
+
+        [DllImport("M3202A_Library.dll", CallingConvention = CallingConvention.Cdecl, EntryPoint = "DdrMapSync")]
+        public static extern int DdrMapSync(UInt32 mapIdx);
+
+        [DllImport("M3202A_Library.dll", CallingConvention = CallingConvention.Cdecl, EntryPoint = "DdrMapInvalidate")]
+        public static extern int DdrMapInvalidate(UInt32 mapIdx);
+
+        [DllImport("M3202A_Library.dll", CallingConvention = CallingConvention.Cdecl, EntryPoint = "DdrMapGetStats")]
+        public static extern int DdrMapGetStats(UInt32 mapIdx, ref DdrMapStats stats);
+
+        [DllImport("M3202A_Library.dll", CallingConvention = CallingConvention.Cdecl, EntryPoint = "DdrMapClose")]
+        public static extern int DdrMapClose(UInt32 mapIdx);
+
+        [DllImport("M3202A_Library.dll", CallingConvention = CallingConvention.Cdecl, EntryPoint = "TraceStart")]
+        public static extern int TraceStart(string path, UInt32 flags);
+
+        [DllImport("M3202A_Library.dll", CallingConvention = CallingConvention.Cdecl, EntryPoint = "TraceStop")]
+        public static extern int TraceStop();
+
+        [DllImport("M3202A_Library.dll", CallingConvention = CallingConvention.Cdecl, EntryPoint = "TraceReplay")]
+        public static extern int TraceReplay(string path, UInt32 flags, ref TraceReplayStats stats);
+
+        [DllImport("M3202A_Library.dll", CallingConvention = CallingConvention.Cdecl, EntryPoint = "EnvelopeUnpack")]
+        public static extern void EnvelopeUnpack(UInt32[] data, UInt32 length, double scale, double[] output);
+
+        [DllImport("M3202A_Library.dll", CallingConvention = CallingConvention.Cdecl, EntryPoint = "EnvelopeProcess")]
+        public static extern int EnvelopeProcess(UInt64 address, UInt32 length, ref EnvelopeConfig config, double[] output, UInt64[] histogram, ref EnvelopeStats stats);
+
+        [DllImport("M3202A_Library.dll", CallingConvention = CallingConvention.Cdecl, EntryPoint = "EtModelRun")]
+        public static extern int EtModelRun(UInt32 resamplerRate, UInt32[] shapingTable, UInt32[] iqIn, UInt32 inSamples, UInt32[] envOut, UInt32 outSamples);
+
+        [DllImport("M3202A_Library.dll", CallingConvention = CallingConvention.Cdecl, EntryPoint = "DdrReaderOpen")]
+        public static extern int DdrReaderOpen(UInt32 readerIdx, UInt64 address, UInt32 length, UInt32 depth);
+
+        [DllImport("M3202A_Library.dll", CallingConvention = CallingConvention.Cdecl, EntryPoint = "DdrReaderRead")]
+        public static extern int DdrReaderRead(UInt32 readerIdx, UInt32[] data, UInt64 address, UInt32 length);
+
+        [DllImport("M3202A_Library.dll", CallingConvention = CallingConvention.Cdecl, EntryPoint = "DdrReaderGetStats")]
+        public static extern int DdrReaderGetStats(UInt32 readerIdx, ref DdrReaderStats stats);
+
+        [DllImport("M3202A_Library.dll", CallingConvention = CallingConvention.Cdecl, EntryPoint = "DdrReaderClose")]
+        public static extern int DdrReaderClose(UInt32 readerIdx);
+
+        [DllImport("M3202A_Library.dll", CallingConvention = CallingConvention.Cdecl, EntryPoint = "DmaSetWaitTimeout")]
+        public static extern int DmaSetWaitTimeout(UInt32 milliseconds);
+
+        // data must be pinned until TransferClose
+        [DllImport("M3202A_Library.dll", CallingConvention = CallingConvention.Cdecl, EntryPoint = "TransferStart")]
+        public static extern int TransferStart(UInt32 transferIdx, UInt32 op, IntPtr data, UInt64 address, UInt64 copyAddress, UInt32 length, UInt32 deadlineMs, TransferCallback callback, IntPtr user);
+
+        [DllImport("M3202A_Library.dll", CallingConvention = CallingConvention.Cdecl, EntryPoint = "TransferGetProgress")]
+        public static extern int TransferGetProgress(UInt32 transferIdx, ref TransferProgress progress);
+
+        [DllImport("M3202A_Library.dll", CallingConvention = CallingConvention.Cdecl, EntryPoint = "TransferCancel")]
+        public static extern int TransferCancel(UInt32 transferIdx);
+
+        [DllImport("M3202A_Library.dll", CallingConvention = CallingConvention.Cdecl, EntryPoint = "TransferWait")]
+        public static extern int TransferWait(UInt32 transferIdx, UInt32 timeoutMs);
+
+        [DllImport("M3202A_Library.dll", CallingConvention = CallingConvention.Cdecl, EntryPoint = "TransferClose")]
+        public static extern int TransferClose(UInt32 transferIdx);
+
+        [DllImport("M3202A_Library.dll", CallingConvention = CallingConvention.Cdecl, EntryPoint = "IoSchedulerOpen")]
+        public static extern int IoSchedulerOpen(UInt32 sessionIdx);
+
+        [DllImport("M3202A_Library.dll", CallingConvention = CallingConvention.Cdecl, EntryPoint = "IoSubmit")]
+        public static extern int IoSubmit(UInt32 sessionIdx, UInt32 priority, UInt32 op, UInt32[] data, UInt64 address, UInt32 length);
+
+        [DllImport("M3202A_Library.dll", CallingConvention = CallingConvention.Cdecl, EntryPoint = "IoSchedulerGetStats")]
+        public static extern int IoSchedulerGetStats(UInt32 sessionIdx, ref IoSchedulerStats stats);
+
+        [DllImport("M3202A_Library.dll", CallingConvention = CallingConvention.Cdecl, EntryPoint = "IoSchedulerResetStats")]
+        public static extern int IoSchedulerResetStats(UInt32 sessionIdx);
+
+        [DllImport("M3202A_Library.dll", CallingConvention = CallingConvention.Cdecl, EntryPoint = "IoSchedulerClose")]
+        public static extern int IoSchedulerClose(UInt32 sessionIdx);
+
+        public const UInt32 WaveformDelta = 1;
+
+        [DllImport("M3202A_Library.dll", CallingConvention = CallingConvention.Cdecl, EntryPoint = "WaveformWrite")]
+        public static extern int WaveformWrite(string path, UInt32[] iq, UInt32 length, double scale, UInt32 flags);
+
+        [DllImport("M3202A_Library.dll", CallingConvention = CallingConvention.Cdecl, EntryPoint = "WaveformConvertCsv")]
+        public static extern int WaveformConvertCsv(string csvPath, string path, UInt32 flags, ref double scale);
+
+        [DllImport("M3202A_Library.dll", CallingConvention = CallingConvention.Cdecl, EntryPoint = "WaveformGetInfo")]
+        public static extern int WaveformGetInfo(string path, ref WaveformInfo info);
+
+        [DllImport("M3202A_Library.dll", CallingConvention = CallingConvention.Cdecl, EntryPoint = "WaveformUpload")]
+        public static extern int WaveformUpload(string path, UInt64 address, UInt32 first, UInt32 length, ref WaveformUploadStats stats);
+
+        [DllImport("M3202A_Library.dll", CallingConvention = CallingConvention.Cdecl, EntryPoint = "TelemetryStart")]
+        public static extern int TelemetryStart(UInt32 periodMs, UInt32 slots);
+
+        [DllImport("M3202A_Library.dll", CallingConvention = CallingConvention.Cdecl, EntryPoint = "TelemetryStop")]
+        public static extern int TelemetryStop();
+
+        // count is a size_t written by the library
+        [DllImport("M3202A_Library.dll", CallingConvention = CallingConvention.Cdecl, EntryPoint = "TelemetryRead")]
+        public static extern int TelemetryRead(UInt32 processId, [Out] TelemetrySample[] samples, UInt32 maxSamples, ref UIntPtr count);
+
+        // DDR sample layouts; pairs count IQ pairs, iq holds them interleaved I,Q
+        public const UInt32 SampleIq16 = 0;
+        public const UInt32 SampleIq24Markers = 1;
+        public const UInt32 SampleFloat32 = 2;
+        public const UInt32 SampleIq12Packed = 3;
+
+        [DllImport("M3202A_Library.dll", CallingConvention = CallingConvention.Cdecl, EntryPoint = "SampleFormatWords")]
+        public static extern int SampleFormatWords(UInt32 format, UInt32 pairs, ref UIntPtr words);
+
+        // markers may be null; scale 0 picks the scale that fits the peak magnitude
+        [DllImport("M3202A_Library.dll", CallingConvention = CallingConvention.Cdecl, EntryPoint = "SamplePack")]
+        public static extern int SamplePack(UInt32 format, double[] iq, UInt32 pairs, ref double scale, byte[] markers, [Out] UInt32[] words, ref UIntPtr clipped);
+
+        [DllImport("M3202A_Library.dll", CallingConvention = CallingConvention.Cdecl, EntryPoint = "SampleUnpack")]
+        public static extern int SampleUnpack(UInt32 format, UInt32[] words, UInt32 pairs, double scale, [Out] double[] iq, [Out] byte[] markers);
+
+        [DllImport("M3202A_Library.dll", CallingConvention = CallingConvention.Cdecl, EntryPoint = "DdrWriteSamples")]
+        public static extern int DdrWriteSamples(UInt32 format, double[] iq, UInt64 address, UInt32 pairs, ref double scale, byte[] markers, ref UIntPtr clipped);
+
+        [DllImport("M3202A_Library.dll", CallingConvention = CallingConvention.Cdecl, EntryPoint = "DdrReadSamples")]
+        public static extern int DdrReadSamples(UInt32 format, [Out] double[] iq, UInt64 address, UInt32 pairs, double scale, [Out] byte[] markers);
     }
 }
@@ -73,6 +73,305 @@ namespace CSharpConsoleApp
                 Console.WriteLine("DDR Test Failed!");
         }
 
+        static void TestDDRChecksum()
+        {
+            const uint dataLength = 16 * 1024 * 1024;
+            const UInt32 srcAddr = 0x10000000;
+            const UInt32 destAddr = 0x20000000;
+
+            UInt32[] dataIn = new UInt32[dataLength];
+            for (int i = 0; i < dataLength; i++) dataIn[i] = (UInt32)i;
+
+            UInt32 writeCrc = 0, copyCrc = 0;
+            FpgaOp.DdrWriteCrc(dataIn, srcAddr, dataLength, ref writeCrc);
+            FpgaOp.DdrCopyCrc(srcAddr, destAddr, dataLength, ref copyCrc);
+
+            if (writeCrc == copyCrc)
+                Console.WriteLine("DDR Checksum Test Passed! crc = {0:X8}", writeCrc);
+            else
+                Console.WriteLine("DDR Checksum Test Failed! {0:X8} != {1:X8}", writeCrc, copyCrc);
+        }
+
+        // Copies a P2P-aligned block from the module of SessionOpen (session 0)
+        // to a second module and back, then compares with the original
+        static void TestPeerCopy(string peerDeviceId)
+        {
+            const uint dataLength = 4 * 1024 * 1024;
+            const UInt32 peerSession = 1;
+
+            if (FpgaOp.SessionOpenDevice(peerSession, peerDeviceId) != 0)
+            {
+                Console.WriteLine("Peer Copy Test Failed! Cannot open {0}", peerDeviceId);
+                return;
+            }
+
+            DDRMemoryManager memMgr = new DDRMemoryManager(0x10000000, 256 * 1024 * 1024);
+            var src = memMgr.Allocate(dataLength * 4, true);
+            var dest = memMgr.Allocate(dataLength * 4, true);
+
+            UInt32[] dataIn = new UInt32[dataLength];
+            for (int i = 0; i < dataLength; i++) dataIn[i] = (UInt32)i;
+            FpgaOp.DdrWrite(dataIn, src.Address, dataLength);
+
+            FpgaOp.DdrPeerCopy(0, src.Address, peerSession, dest.Address, dataLength);
+            FpgaOp.DdrPeerCopy(peerSession, dest.Address, 0, dest.Address, dataLength);
+
+            UInt32[] dataOut = new UInt32[dataLength];
+            FpgaOp.DdrRead(dataOut, dest.Address, dataLength);
+            FpgaOp.SessionCloseDevice(peerSession);
+
+            if (dataIn.SequenceEqual(dataOut))
+                Console.WriteLine("Peer Copy Test Passed!");
+            else
+                Console.WriteLine("Peer Copy Test Failed!");
+        }
+
+        // Samples a 64 MB capture through a DDR map; only the touched pages are read
+        static void TestDdrMap()
+        {
+            const uint dataLength = 16 * 1024 * 1024;
+            const UInt32 captureAddr = 0x10000000;
+
+            IntPtr view;
+            if (FpgaOp.DdrMapOpen(0, captureAddr, dataLength, out view) != 0)
+            {
+                Console.WriteLine("DDR Map Test Failed! Cannot map the capture");
+                return;
+            }
+
+            Int64 sum = 0;
+            for (long i = 0; i < dataLength; i += 1024 * 1024)
+            {
+                sum += Marshal.ReadInt32(view, (int)(i * 4));
+            }
+
+            DdrMapStats stats = new DdrMapStats();
+            FpgaOp.DdrMapGetStats(0, ref stats);
+            FpgaOp.DdrMapClose(0);
+
+            Console.WriteLine("DDR Map Test: sum = {0}, {1} of {2} bytes fetched", sum, stats.bytesFetched, dataLength * 4);
+        }
+
+        static void ReplayTrace(string path)
+        {
+            string[] opNames = { "RegRead", "RegWrite", "RegArrayRead", "RegArrayWrite",
+                                 "DdrRead", "DdrWrite", "DdrCopy", "DdrChecksum" };
+
+            var stats = new TraceReplayStats();
+            var ret = FpgaOp.TraceReplay(path, 0, ref stats);
+            if (ret != 0)
+            {
+                Console.WriteLine("Trace Replay Failed! TraceReplay returned {0}", ret);
+                return;
+            }
+
+            Console.WriteLine("{0} calls, {1} errors, {2} mismatches", stats.records, stats.errors, stats.mismatches);
+            Console.WriteLine("Recorded {0:F3}s ({1:F3}s idle), replayed in {2:F3}s",
+                stats.recordedSeconds, stats.recordedIdleSeconds, stats.replaySeconds);
+            Console.WriteLine("{0,-14}{1,10}{2,14}{3,12}{4,12}{5,12}", "Call", "Count", "Bytes", "Recorded", "Replayed", "Slowest");
+            for (int i = 0; i < stats.ops.Length; i++)
+            {
+                TraceOpStats op = stats.ops[i];
+                if (op.calls == 0) continue;
+                Console.WriteLine("{0,-14}{1,10}{2,14}{3,12:F6}{4,12:F6}{5,12:F6}",
+                    opNames[i], op.calls, op.bytes, op.recordedSeconds, op.replaySeconds, op.maxReplaySeconds);
+            }
+        }
+
+        static void TestDdrReader()
+        {
+            const uint dataLength = 16 * 1024 * 1024;
+            const uint chunkLength = 4096;
+            const UInt32 captureAddr = 0x10000000;
+
+            if (FpgaOp.DdrReaderOpen(0, captureAddr, dataLength, 0) != 0)
+            {
+                Console.WriteLine("DDR Reader Test Failed! Cannot open the reader");
+                return;
+            }
+
+            UInt32[] chunk = new UInt32[chunkLength];
+            Int64 sum = 0;
+            for (uint i = 0; i < dataLength; i += chunkLength)
+            {
+                FpgaOp.DdrReaderRead(0, chunk, captureAddr + i * 4, chunkLength);
+                sum += chunk[0];
+            }
+
+            DdrReaderStats stats = new DdrReaderStats();
+            FpgaOp.DdrReaderGetStats(0, ref stats);
+            FpgaOp.DdrReaderClose(0);
+
+            Console.WriteLine("DDR Reader Test: sum = {0}, {1} of {2} reads served from read-ahead", sum, stats.hits, stats.reads);
+        }
+
+        static void TestTransfer()
+        {
+            const uint dataLength = 64 * 1024 * 1024;
+            const UInt32 waveformAddr = 0x10000000;
+
+            UInt32[] data = new UInt32[dataLength];
+            for (uint i = 0; i < dataLength; i++) data[i] = i;
+
+            // the library writes from its own thread, so the array must not move
+            GCHandle pinned = GCHandle.Alloc(data, GCHandleType.Pinned);
+            TransferCallback progress = (idx, done, total, user) =>
+                Console.WriteLine("Transfer {0}: {1} of {2} bytes", idx, done, total);
+
+            FpgaOp.TransferStart(0, 1, pinned.AddrOfPinnedObject(), waveformAddr, 0, dataLength, 10000, progress, IntPtr.Zero);
+            var ret = FpgaOp.TransferWait(0, 0);
+            var stats = new TransferProgress();
+            FpgaOp.TransferGetProgress(0, ref stats);
+            FpgaOp.TransferClose(0);
+            pinned.Free();
+            GC.KeepAlive(progress);
+
+            Console.WriteLine("Transfer Test returned {0}: {1} bytes in {2:F3}s", ret, stats.bytesDone, stats.seconds);
+        }
+
+        static void TestIoScheduler()
+        {
+            const uint dataLength = 16 * 1024 * 1024;
+            const UInt32 waveformAddr = 0x10000000;
+            const UInt64 regAddr = 0x21100;
+
+            FpgaOp.IoSchedulerOpen(0);
+
+            // one bulk upload while the main thread polls a register
+            UInt32[] data = new UInt32[dataLength];
+            var upload = Task.Run(() => FpgaOp.IoSubmit(0, 2, 5, data, waveformAddr, dataLength));
+
+            UInt32[] value = new UInt32[1];
+            while (!upload.IsCompleted) FpgaOp.IoSubmit(0, 0, 0, value, regAddr, 1);
+
+            var stats = new IoSchedulerStats();
+            FpgaOp.IoSchedulerGetStats(0, ref stats);
+            FpgaOp.IoSchedulerClose(0);
+
+            Console.WriteLine("I/O Scheduler Test: upload returned {0}, {1} register reads, p99 {2:F1}us, max {3:F1}us",
+                upload.Result, stats.classes[0].requests, stats.classes[0].p99Seconds * 1e6, stats.classes[0].maxSeconds * 1e6);
+        }
+
+        static void TestWaveform()
+        {
+            const UInt32 waveformAddr = 0x10000000;
+
+            // converted once; later runs only upload the .wfm file
+            double scale = 0;
+            var ret = FpgaOp.WaveformConvertCsv(@"c:\wjh\IQ.csv", @"c:\wjh\IQ.wfm", FpgaOp.WaveformDelta, ref scale);
+            if (ret != 0)
+            {
+                Console.WriteLine("Waveform Test Failed! Conversion returned {0}", ret);
+                return;
+            }
+
+            var info = new WaveformInfo();
+            FpgaOp.WaveformGetInfo(@"c:\wjh\IQ.wfm", ref info);
+
+            var stats = new WaveformUploadStats();
+            ret = FpgaOp.WaveformUpload(@"c:\wjh\IQ.wfm", waveformAddr, 0, 0, ref stats);
+            Console.WriteLine("Waveform Test returned {0}: {1} samples from {2} bytes, scaleFactor = {3}, {4:F3}s",
+                ret, stats.samples, info.fileBytes, info.scale, stats.seconds);
+        }
+
+        static void TestTelemetry()
+        {
+            // a monitor would call TelemetryRead with the id of this process
+            FpgaOp.TelemetryStart(50, 0);
+            for (int i = 0; i < 20; i++) TestDDR();
+            System.Threading.Thread.Sleep(100);
+
+            var samples = new TelemetrySample[16];
+            var count = UIntPtr.Zero;
+            var ret = FpgaOp.TelemetryRead(0, samples, (UInt32)samples.Length, ref count);
+            FpgaOp.TelemetryStop();
+            if (ret != 0 || count == UIntPtr.Zero)
+            {
+                Console.WriteLine("Telemetry Test Failed! Read returned {0}", ret);
+                return;
+            }
+
+            var last = samples[(int)count - 1];
+            Console.WriteLine("Telemetry Test: {0} samples, {1} bytes to DDR, {2} from DDR, {3} pager switches",
+                count, last.bytesToDdr, last.bytesFromDdr, last.pagerSwitches);
+        }
+
+        static void TestSampleFormats()
+        {
+            const UInt32 sampleAddr = 0x18000000;
+            const int pairs = 100000;
+
+            var iq = new double[2 * pairs];
+            var markers = new byte[pairs];
+            for (int i = 0; i < pairs; i++)
+            {
+                iq[2 * i] = 0.7 * Math.Cos(i * 0.001);
+                iq[2 * i + 1] = 0.7 * Math.Sin(i * 0.001);
+                markers[i] = (byte)(i % 16);
+            }
+
+            double scale = 0;
+            var clipped = UIntPtr.Zero;
+            var ret = FpgaOp.DdrWriteSamples(FpgaOp.SampleIq24Markers, iq, sampleAddr, pairs, ref scale, markers, ref clipped);
+            if (ret != 0)
+            {
+                Console.WriteLine("Sample Format Test Failed! Write returned {0}", ret);
+                return;
+            }
+
+            var back = new double[2 * pairs];
+            var backMarkers = new byte[pairs];
+            ret = FpgaOp.DdrReadSamples(FpgaOp.SampleIq24Markers, back, sampleAddr, pairs, scale, backMarkers);
+
+            double maxError = 0;
+            int badMarkers = 0;
+            for (int i = 0; i < pairs; i++)
+            {
+                maxError = Math.Max(maxError, Math.Max(Math.Abs(back[2 * i] - iq[2 * i]), Math.Abs(back[2 * i + 1] - iq[2 * i + 1])));
+                if (backMarkers[i] != markers[i]) badMarkers++;
+            }
+            Console.WriteLine("Sample Format Test returned {0}: scale {1}, {2} clipped, max error {3}, {4} marker mismatches",
+                ret, scale, clipped, maxError, badMarkers);
+        }
+
+        static void TestEtPipeline(UInt32[] block, int numOfSamples, int osr, int numBlocks)
+        {
+            var config = new EtConfig
+            {
+                etRegBase = 0x21000,
+                dmaRegBase = 0x20000,
+                paInAddr = new UInt64[] { 0x02000000, 0x04000000 },
+                envOutAddr = new UInt64[] { 0x03000000, 0x05000000 },
+                samplesPerBlock = (UInt32)numOfSamples,
+                osr = (UInt32)osr
+            };
+
+            UInt32[] iqIn = new UInt32[numOfSamples * numBlocks];
+            for (int i = 0; i < numBlocks; i++) Array.Copy(block, 0, iqIn, i * numOfSamples, numOfSamples);
+            UInt32[] envOut = new UInt32[numOfSamples * osr / 2 * numBlocks];
+
+            var stats = new EtStats();
+            var ret = FpgaOp.EtRun(ref config, iqIn, envOut, (UInt32)numBlocks, ref stats);
+            Console.WriteLine("EtRun returned {0}: {1} blocks, {2:F0} samples/s (upload {3:F3}s, readback {4:F3}s, wait {5:F3}s)",
+                ret, stats.blocks, stats.samplesPerSecond, stats.uploadSeconds, stats.readbackSeconds, stats.waitSeconds);
+        }
+
+        static void TestEtModel(UInt32[] block, UInt32[] shapingTable, UInt64 envOutAddr, int numOfSamples, int osr)
+        {
+            UInt32[] expected = new UInt32[numOfSamples * osr / 2];
+            FpgaOp.EtModelRun(0x80000000 / (UInt32)osr, shapingTable, block, (UInt32)numOfSamples, expected, (UInt32)(numOfSamples * osr));
+
+            UInt32[] actual = new UInt32[expected.Length];
+            FpgaOp.DdrRead(actual, envOutAddr, (UInt32)actual.Length);
+
+            int mismatches = 0;
+            for (int i = 0; i < expected.Length; i++)
+            {
+                if (expected[i] != actual[i]) mismatches++;
+            }
+            Console.WriteLine("ET Model Test: {0} of {1} envelope words differ from the reference", mismatches, expected.Length);
+        }
+
         static double GetMaxMagnitude(double[] data)
         {
             double max = 0.0;
@@ -225,12 +524,29 @@ namespace CSharpConsoleApp
         {
             SessionOpen();
 
+            // CSharpConsoleApp --replay <trace> reissues a capture made with TraceStart
+            if (args.Length == 2 && args[0] == "--replay")
+            {
+                ReplayTrace(args[1]);
+                SessionClose();
+                return;
+            }
+
             ShowAddressMap();
 
             #region Test
             //TestMemory();
             //TestRegOperation();
             //TestDDR();
+            //TestDDRChecksum();
+            //TestPeerCopy("80090200-0a2f-62f7-a2bb-edab00034901");
+            //TestDdrMap();
+            //TestDdrReader();
+            //TestTransfer();
+            //TestIoScheduler();
+            //TestWaveform();
+            //TestTelemetry();
+            //TestSampleFormats();
             #endregion
 
             //goto label;
@@ -277,18 +593,25 @@ namespace CSharpConsoleApp
             FpgaOp.RegWrite(Et_RegBase + 0x18, 0); 
 
             var shapingTable = CreateShapingTable();
-            FpgaOp.RegArrayWrite(shapingTable, Et_RegBase + 0x400, 256); //Shaping Table
+            UInt32 entriesWritten = 0;
+            FpgaOp.LutOpen(0, Et_RegBase + 0x400, FpgaOp.LutNoAddress, FpgaOp.LutNoAddress, 256);
+            FpgaOp.LutLoad(0, shapingTable, ref entriesWritten); //Shaping Table, only changed entries are written
             FpgaOp.RegWrite(Et_RegBase + 0x0, 1); // Clr
 
+            //TestEtPipeline(dataToDdr, numOfSamples, osr, 16);
+
             //Step 3. Setup Streamer32
             ConfigS2MM(Streamer_DMA_RegBase, envOutAddr, numOfSamples * osr * 2); // envOut each sample 2 bytes
             ConfigMM2S(Streamer_DMA_RegBase, paInAddr, numOfSamples * 4); // paIn each sample 4 bytes
 
-            //Step 4. Read back the ET output
-            UInt32[] dataFromDdr = new UInt32[numOfSamples * osr / 2]; 
-            FpgaOp.DdrRead(dataFromDdr, envOutAddr, numOfSamples * osr / 2);
-            var envData = UnpackToShort(dataFromDdr);
-            var envData_Double = ScaleToFloatingPoint(envData);
+            //Step 4. Read back the ET output, unpacked and scaled while it streams in
+            var envConfig = new EnvelopeConfig { scale = scaleFactor, decimation = 1, histogramBins = 0 };
+            var envStats = new EnvelopeStats();
+            double[] envData_Double = new double[numOfSamples * osr];
+            FpgaOp.EnvelopeProcess(envOutAddr, (UInt32)(numOfSamples * osr / 2), ref envConfig, envData_Double, null, ref envStats);
+            Console.WriteLine("Envelope: min {0}, max {1}, rms {2}", envStats.min, envStats.max, envStats.rms);
+
+            //TestEtModel(dataToDdr, shapingTable, envOutAddr, numOfSamples, osr);
             #endregion
 
             //label:
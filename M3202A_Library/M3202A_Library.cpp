@@ -3,11 +3,33 @@
 
 #include "stdafx.h"
 
+#include <algorithm>
 #include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <vector>
 #include <string>
+#include <thread>
 
 #include "M3202A_Library.h"  
+#include "cmdlist.h"
+#include "crc.h"
+#include "dma_status.h"
+#include "envelope.h"
+#include "et.h"
+#include "et_model.h"
+#include "lut.h"
+#include "mirror.h"
+#include "peer.h"
+#include "reader.h"
+#include "sample_format.h"
+#include "scheduler.h"
+#include "stream.h"
+#include "telemetry.h"
+#include "trace.h"
+#include "transfer.h"
+#include "waveform.h"
 
 
 
@@ -305,16 +327,41 @@ void testStreaming(rsp_kernel_instance kernelInst)
 }
 // ============ END OF HELPER FUNCTIONS ==================//
 
-// These variables contain the RSP objects used in this example
-rsp_device_id device = nullptr;
-rsp_context context = nullptr;
-rsp_program program = nullptr;
-rsp_kernel kernel = nullptr;
-rsp_kernel_instance kernelInst = nullptr;
-rsp_streamer rspStreamer;
-
+// The RSP objects of one opened module
+struct rsp_session
+{
+	rsp_device_id device = nullptr;
+	rsp_context context = nullptr;
+	rsp_program program = nullptr;
+	rsp_kernel kernel = nullptr;
+	rsp_kernel_instance kernelInst = nullptr;
+	rsp_streamer streamer = rsp_streamer();
+};
 
-void SessionOpen()
+// Session 0 is the module opened by SessionOpen, which every other export
+// works on. SessionOpenDevice adds further modules for DdrPeerCopy.
+rsp_session mainSession;
+rsp_kernel_instance &kernelInst = mainSession.kernelInst;
+rsp_streamer &rspStreamer = mainSession.streamer;
+std::map<uint32_t, rsp_session*> sessions;
+std::map<size_t, rsp_stream*> streams;
+std::map<uint32_t, rsp_lut*> luts;
+std::map<uint32_t, rsp_mirror*> maps;
+std::map<uint32_t, rsp_reader*> readers;
+// TransferCancel may be called from a transfer callback, i.e. another thread.
+// Shared so a TransferWait in progress keeps its transfer alive past a
+// TransferClose; the last owner frees it.
+std::map<uint32_t, std::shared_ptr<rsp_transfer>> transfers;
+std::mutex transfersLock;
+// keyed by session; IoSubmit comes from many client threads, each keeping
+// the scheduler alive until its request has returned
+std::map<uint32_t, std::shared_ptr<rsp_scheduler>> schedulers;
+std::mutex schedulersLock;
+
+
+// Loads the envelope tracker program on the given device. Errors are
+// reported on stderr; whatever was created is left in session for closeSession.
+bool openSession(const std::string &targetDeviceId, rsp_session *session)
 {
 	// These strings identify the platform, device, program archive, and kernel used in the tests
 	const std::string targetBinPath = "PWFPGA_EnvelopeTracker.k7z";
@@ -326,7 +373,6 @@ void SessionOpen()
 	// Then compare the fields in the manifest with these strings.
 	//
 	const std::string targetPlatformName = "M31xx_M32xx_M33xx";
-	const std::string targetDeviceId = "80090200-0a2f-62f7-a2bb-edab00034900";
 	const std::string targetKernelname = "PWFPGA_EnvelopeTracker";
 
 	// These are the names of the registers used in Test B
@@ -348,47 +394,108 @@ void SessionOpen()
 		////////////////////////////////////
 		// Step 2: Find the target device //
 		////////////////////////////////////
-		device = findDevice(platform, targetDeviceId);
+		session->device = findDevice(platform, targetDeviceId);
 
 
 		////////////////////////////////////////////////
 		// Step 3: Create the context from the device //
 		////////////////////////////////////////////////
-		context = createContext(device);
+		session->context = createContext(session->device);
 
 
 		//////////////////////////////////////////////////
 		// Step 4: Create the program from the k7z file //
 		//////////////////////////////////////////////////
-		program = loadProgram(context, device, targetBinPath);
+		session->program = loadProgram(session->context, session->device, targetBinPath);
 
 
 		////////////////////////////////////////////////
 		// Step 5: Create the kernel from the program //
 		////////////////////////////////////////////////
-		kernel = createKernel(program, targetKernelname);
+		session->kernel = createKernel(session->program, targetKernelname);
 
 
 		//////////////////////////////////////////////
 		// Step 6: Create an instance of the kernel //
 		//////////////////////////////////////////////
-		kernelInst = createKernelInstance(kernel);
+		session->kernelInst = createKernelInstance(session->kernel);
 
 
 		//////////////////////////////////////////////
 		// Step 7: Setup DDR Streamer32             //
 		//////////////////////////////////////////////
 		rsp_int error;
-		rspStreamer = rspSetupStreamer(kernelInst, NULL, NULL, "Host_axilite_Inst", "Host_aximm_Inst", &error);
+		session->streamer = rspSetupStreamer(session->kernelInst, NULL, NULL, "Host_axilite_Inst", "Host_aximm_Inst", &error);
+		checkError("Setting up the streamer", error);
 
 		/////////////////////////////////////////////////////////////
 		// Setup complete. Now the binary is loaded in the device. //
 		/////////////////////////////////////////////////////////////
-		std::cout << "Session Open complete." << std::endl << std::endl;
+		return true;
 	}
 	catch (const std::runtime_error& err)
 	{
 		std::cerr << err.what() << std::endl;
+		return false;
+	}
+}
+
+// Releases the resources in the opposite order they were acquired
+void closeSession(rsp_session *session)
+{
+	if (session->kernelInst != nullptr)
+	{
+		rspReleaseKernelInstance(session->kernelInst);
+	}
+
+	if (session->kernel != nullptr)
+	{
+		rspReleaseKernel(session->kernel);
+	}
+
+	if (session->program != nullptr)
+	{
+		rspReleaseProgram(session->program);
+	}
+
+	if (session->context != nullptr)
+	{
+		rspReleaseContext(session->context);
+	}
+
+	if (session->device != nullptr)
+	{
+		rspReleaseDevice(session->device);
+	}
+
+	*session = rsp_session();
+}
+
+// Whether length words at the DDR byte address lie within the 4 GB that the
+// 32-bit DMA and host window addresses reach
+static bool inDdrWindow(uint64_t address, size_t length)
+{
+	return address <= 0xFFFFFFFF && length <= 0xFFFFFFFF / 4 && address + length * 4 <= 0x100000000ULL;
+}
+
+// The streamer of session 0 or of a module opened with SessionOpenDevice
+const rsp_streamer *sessionStreamer(uint32_t sessionIdx)
+{
+	if (sessionIdx == 0) return mainSession.kernelInst ? &mainSession.streamer : nullptr;
+
+	auto it = sessions.find(sessionIdx);
+	return it == sessions.end() ? nullptr : &it->second->streamer;
+}
+
+void SessionOpen()
+{
+	const std::string targetDeviceId = "80090200-0a2f-62f7-a2bb-edab00034900";
+
+	if (openSession(targetDeviceId, &mainSession))
+	{
+		rspTelemetryAddSession(0, mainSession.kernelInst);
+
+		std::cout << "Session Open complete." << std::endl << std::endl;
 	}
 }
 
@@ -397,30 +504,64 @@ void SessionClose()
 	/////////////////////////////////////////////////////////////////////////////
 	// Cleanup: release the resources in the opposite order they were acquired //
 	/////////////////////////////////////////////////////////////////////////////
-	if (kernelInst != nullptr)
+	rspTelemetryStop();
+
+	std::map<uint32_t, std::shared_ptr<rsp_scheduler>> stopping;
+	{
+		std::lock_guard<std::mutex> guard(schedulersLock);
+		stopping.swap(schedulers);
+	}
+	for (auto &scheduler : stopping)
+	{
+		rspSchedulerStop(scheduler.second.get());
+	}
+	stopping.clear();
+
+	std::map<uint32_t, std::shared_ptr<rsp_transfer>> running;
+	{
+		std::lock_guard<std::mutex> guard(transfersLock);
+		running.swap(transfers);
+	}
+	for (auto &transfer : running)
 	{
-		rspReleaseKernelInstance(kernelInst);
+		rspTransferStop(transfer.second.get());
 	}
+	running.clear();
 
-	if (kernel != nullptr)
+	for (auto &stream : streams)
 	{
-		rspReleaseKernel(kernel);
+		rspStreamClose(stream.second);
 	}
+	streams.clear();
 
-	if (program != nullptr)
+	for (auto &lut : luts)
 	{
-		rspReleaseProgram(program);
+		rspLutDestroy(lut.second);
 	}
+	luts.clear();
 
-	if (context != nullptr)
+	for (auto &map : maps)
 	{
-		rspReleaseContext(context);
+		rspMirrorClose(map.second);
 	}
+	maps.clear();
 
-	if (device != nullptr)
+	for (auto &reader : readers)
 	{
-		rspReleaseDevice(device);
+		rspReaderClose(reader.second);
 	}
+	readers.clear();
+
+	for (auto &session : sessions)
+	{
+		rspTelemetryRemoveSession(session.first);
+		closeSession(session.second);
+		delete session.second;
+	}
+	sessions.clear();
+
+	rspTelemetryRemoveSession(0);
+	closeSession(&mainSession);
 
 	std::cout << "Session Closed complete." << std::endl << std::endl;
 }
@@ -432,43 +573,637 @@ void ShowAddressMap()
 
 int RegRead(uint32_t *data, uint64_t address)
 {
+	rsp_trace_time start = rspTraceNow();
 	rsp_int ret;
 	ret = rspKernelInstanceRegisterRead(kernelInst, data, (const uint64_t)address);
+	if (rspTraceActive) rspTraceRecord(TRACE_REG_READ, start, ret, address, 0, 4, data);
 	return ret;
 }
 
 int RegWrite(uint64_t address, uint32_t value)
 {
+	rsp_trace_time start = rspTraceNow();
 	rsp_int ret;
 	ret = rspKernelInstanceRegisterWrite(kernelInst, value, (const uint64_t)address);
+	if (rspTraceActive) rspTraceRecord(TRACE_REG_WRITE, start, ret, address, 0, 4, &value);
 	return ret;
 }
 
 int RegArrayRead(uint32_t *data, uint64_t address, size_t length)
 {
-	rsp_int ret;
-	ret = rspKernelInstanceArrayRead(kernelInst, data, address, length*4);
+	rsp_trace_time start = rspTraceNow();
+	rsp_int ret = RSP_INVALID_VALUE;
+	// a DdrMap view faulting inside the driver call cannot be fetched
+	if (!rspMirrorOverlaps(data, length*4)) ret = rspKernelInstanceArrayRead(kernelInst, data, address, length*4);
+	if (rspTraceActive) rspTraceRecord(TRACE_REG_ARRAY_READ, start, ret, address, 0, length*4, data);
 	return ret;
 }
 
 int RegArrayWrite(uint32_t *data, uint64_t address, size_t length)
 {
-	rsp_int ret;
-	ret = rspKernelInstanceArrayWrite(kernelInst, (const uint32_t*)data, address, length*4);
+	rsp_trace_time start = rspTraceNow();
+	rsp_int ret = RSP_INVALID_VALUE;
+	// a DdrMap view faulting inside the driver call cannot be fetched
+	if (!rspMirrorOverlaps(data, length*4)) ret = rspKernelInstanceArrayWrite(kernelInst, (const uint32_t*)data, address, length*4);
+	if (rspTraceActive) rspTraceRecord(TRACE_REG_ARRAY_WRITE, start, ret, address, 0, length*4, data);
 	return ret;
 }
 
 int DdrRead(uint32_t *data, uint64_t address, size_t length)
 {
-	return rspStreamerReadHost(&rspStreamer, address, data, length*4);
+	rsp_trace_time start = rspTraceNow();
+	rsp_int ret = data ? rspStreamerReadHost(&rspStreamer, address, data, length*4) : RSP_INVALID_VALUE;
+	if (rspTraceActive) rspTraceRecord(TRACE_DDR_READ, start, ret, address, 0, length*4, data);
+	return ret;
 }
 
 int DdrWrite(uint32_t *data, uint64_t address, size_t length)
 {
-	return rspStreamerWriteHost(&rspStreamer, address, data, length*4);
+	rsp_trace_time start = rspTraceNow();
+	rsp_int ret = data ? rspStreamerWriteHost(&rspStreamer, address, data, length*4) : RSP_INVALID_VALUE;
+	if (rspTraceActive) rspTraceRecord(TRACE_DDR_WRITE, start, ret, address, 0, length*4, data);
+	return ret;
 }
 
 int DdrCopy(uint64_t startAddress, uint64_t endAddress, size_t length)
 {
-	return rspStreamerCopyDMA(&rspStreamer, RSP_STREAMER_DMA_1, startAddress, endAddress, length * 4);
+	rsp_trace_time start = rspTraceNow();
+	rsp_int ret = rspStreamerCopyDMA(&rspStreamer, RSP_STREAMER_DMA_1, startAddress, endAddress, length * 4);
+	if (rspTraceActive) rspTraceRecord(TRACE_DDR_COPY, start, ret, startAddress, endAddress, length*4, nullptr);
+	return ret;
+}
+
+int StreamOpen(size_t streamIdx, size_t chunkBytes, size_t ringBytes)
+{
+	if (streams.count(streamIdx)) return RSP_INVALID_VALUE;
+
+	rsp_int ret;
+	rsp_stream *stream = rspStreamOpen(kernelInst, streamIdx, chunkBytes, ringBytes, &ret);
+	if (stream) streams[streamIdx] = stream;
+	return ret;
+}
+
+int StreamWrite(size_t streamIdx, uint32_t *data, size_t length)
+{
+	auto it = streams.find(streamIdx);
+	if (it == streams.end()) return RSP_INVALID_VALUE;
+	return rspStreamWrite(it->second, data, length*4);
+}
+
+int StreamRead(size_t streamIdx, uint32_t *data, size_t length)
+{
+	auto it = streams.find(streamIdx);
+	if (it == streams.end()) return RSP_INVALID_VALUE;
+	return rspStreamRead(it->second, data, length*4);
+}
+
+int StreamFlush(size_t streamIdx)
+{
+	auto it = streams.find(streamIdx);
+	if (it == streams.end()) return RSP_INVALID_VALUE;
+	return rspStreamFlush(it->second);
+}
+
+int StreamGetStats(size_t streamIdx, StreamStats *stats)
+{
+	auto it = streams.find(streamIdx);
+	if (it == streams.end()) return RSP_INVALID_VALUE;
+	return rspStreamGetStats(it->second, stats);
+}
+
+int StreamClose(size_t streamIdx)
+{
+	auto it = streams.find(streamIdx);
+	if (it == streams.end()) return RSP_INVALID_VALUE;
+
+	rsp_int ret = rspStreamClose(it->second);
+	streams.erase(it);
+	return ret;
+}
+
+int EtRun(const EtConfig *config, uint32_t *iqIn, uint32_t *envOut, size_t numBlocks, EtStats *stats)
+{
+	return rspEtRun(&rspStreamer, config, iqIn, envOut, numBlocks, stats);
+}
+
+int CommandListSubmit(uint32_t *commands, size_t length, uint32_t *failedCommand)
+{
+	return rspCommandListExecute(&rspStreamer, commands, length, failedCommand);
+}
+
+int DmaGetStatus(uint64_t dmaBaseAddr, DmaStatus *status)
+{
+	return rspDMAReadStatus(kernelInst, dmaBaseAddr, status);
+}
+
+int DmaGetStatusAll(DmaStatus *status)
+{
+	return rspStreamerReadStatusAll(&rspStreamer, status);
+}
+
+int DmaGetErrorCounters(DmaErrorCounters *counters)
+{
+	if (!counters) return RSP_INVALID_VALUE;
+	rspDMAGetErrorCounters(counters);
+	return RSP_SUCCESS;
+}
+
+void DmaResetErrorCounters()
+{
+	rspDMAResetErrorCounters();
+}
+
+uint32_t Crc32c(uint32_t crc, uint32_t *data, size_t length)
+{
+	return rspCrc32c(crc, data, length*4);
+}
+
+int DdrWriteCrc(uint32_t *data, uint64_t address, size_t length, uint32_t *crc)
+{
+	rsp_trace_time start = rspTraceNow();
+	rsp_int ret = rspStreamerWriteHostCrc(&rspStreamer, address, data, length*4, crc);
+	if (rspTraceActive) rspTraceRecord(TRACE_DDR_WRITE, start, ret, address, 0, length*4, data);
+	return ret;
+}
+
+int DdrReadCrc(uint32_t *data, uint64_t address, size_t length, uint32_t *crc)
+{
+	rsp_trace_time start = rspTraceNow();
+	rsp_int ret = rspStreamerReadHostCrc(&rspStreamer, address, data, length*4, crc);
+	if (rspTraceActive) rspTraceRecord(TRACE_DDR_READ, start, ret, address, 0, length*4, data);
+	return ret;
+}
+
+// The copy runs entirely on the module, so the checksum is taken from the
+// destination afterwards. Compare it with the CRC returned by DdrWriteCrc.
+int DdrCopyCrc(uint64_t startAddress, uint64_t endAddress, size_t length, uint32_t *crc)
+{
+	int ret = DdrCopy(startAddress, endAddress, length);
+	if (ret != RSP_SUCCESS) return ret;
+	return DdrChecksum(endAddress, length, crc);
+}
+
+int DdrChecksum(uint64_t address, size_t length, uint32_t *crc)
+{
+	rsp_trace_time start = rspTraceNow();
+	rsp_int ret = rspStreamerChecksum(&rspStreamer, address, length * 4, crc);
+	if (rspTraceActive) rspTraceRecord(TRACE_DDR_CHECKSUM, start, ret, address, 0, length*4, crc);
+	return ret;
+}
+
+// Pass ~0 as bank1Address and selectAddress for a table with a single bank
+int LutOpen(uint32_t lutIdx, uint64_t bank0Address, uint64_t bank1Address, uint64_t selectAddress, size_t length)
+{
+	if (luts.count(lutIdx)) return RSP_INVALID_VALUE;
+
+	rsp_int ret;
+	rsp_lut *lut = rspLutCreate(kernelInst, bank0Address, bank1Address, selectAddress,
+        static_cast<uint32_t>(length), &ret);
+	if (lut) luts[lutIdx] = lut;
+	return ret;
+}
+
+int LutLoad(uint32_t lutIdx, uint32_t *table, uint32_t *entriesWritten)
+{
+	auto it = luts.find(lutIdx);
+	if (it == luts.end()) return RSP_INVALID_VALUE;
+	return rspLutLoad(it->second, table, entriesWritten);
+}
+
+int LutSwap(uint32_t lutIdx)
+{
+	auto it = luts.find(lutIdx);
+	if (it == luts.end()) return RSP_INVALID_VALUE;
+	return rspLutSwap(it->second);
+}
+
+int LutInvalidate(uint32_t lutIdx)
+{
+	auto it = luts.find(lutIdx);
+	if (it == luts.end()) return RSP_INVALID_VALUE;
+	rspLutInvalidate(it->second);
+	return RSP_SUCCESS;
+}
+
+int LutGetStats(uint32_t lutIdx, LutStats *stats)
+{
+	auto it = luts.find(lutIdx);
+	if (it == luts.end() || !stats) return RSP_INVALID_VALUE;
+	*stats = it->second->stats;
+	return RSP_SUCCESS;
+}
+
+int LutClose(uint32_t lutIdx)
+{
+	auto it = luts.find(lutIdx);
+	if (it == luts.end()) return RSP_INVALID_VALUE;
+
+	rspLutDestroy(it->second);
+	luts.erase(it);
+	return RSP_SUCCESS;
+}
+
+// Opens another module under sessionIdx (0 is SessionOpen's) with the same
+// program as SessionOpen
+int SessionOpenDevice(uint32_t sessionIdx, const char *deviceId)
+{
+	if (sessionIdx == 0 || !deviceId || sessions.count(sessionIdx)) return RSP_INVALID_VALUE;
+
+	rsp_session *session = new rsp_session();
+	if (!openSession(deviceId, session))
+	{
+		closeSession(session);
+		delete session;
+		return RSP_DEVICE_NOT_FOUND;
+	}
+
+	sessions[sessionIdx] = session;
+	rspTelemetryAddSession(sessionIdx, session->kernelInst);
+	return RSP_SUCCESS;
+}
+
+int SessionCloseDevice(uint32_t sessionIdx)
+{
+	auto it = sessions.find(sessionIdx);
+	if (it == sessions.end()) return RSP_INVALID_VALUE;
+
+	IoSchedulerClose(sessionIdx);
+	rspTelemetryRemoveSession(sessionIdx);
+	closeSession(it->second);
+	delete it->second;
+	sessions.erase(it);
+	return RSP_SUCCESS;
+}
+
+int DdrPeerCopy(uint32_t srcSession, uint64_t srcAddress, uint32_t dstSession, uint64_t dstAddress, size_t length)
+{
+	const rsp_streamer *src = sessionStreamer(srcSession);
+	const rsp_streamer *dst = sessionStreamer(dstSession);
+	if (!src || !dst) return RSP_INVALID_VALUE;
+	if (!inDdrWindow(srcAddress, length) || !inDdrWindow(dstAddress, length)) return RSP_INVALID_VALUE;
+
+	return rspPeerCopy(src, static_cast<uint32_t>(srcAddress), dst, static_cast<uint32_t>(dstAddress),
+        static_cast<uint32_t>(length * 4));
+}
+
+// Maps length words of DDR into host memory at *view. Pages are read on first
+// access; writes reach DDR on DdrMapSync or DdrMapClose.
+int DdrMapOpen(uint32_t mapIdx, uint64_t address, size_t length, uint32_t **view)
+{
+	if (maps.count(mapIdx) || !view || !inDdrWindow(address, length)) return RSP_INVALID_VALUE;
+
+	rsp_int ret;
+	rsp_mirror *mirror = rspMirrorOpen(&rspStreamer, static_cast<uint32_t>(address),
+        static_cast<uint32_t>(length * 4), &ret);
+	if (!mirror) return ret;
+
+	maps[mapIdx] = mirror;
+	*view = reinterpret_cast<uint32_t*>(mirror->view);
+	return RSP_SUCCESS;
+}
+
+int DdrMapSync(uint32_t mapIdx)
+{
+	auto it = maps.find(mapIdx);
+	if (it == maps.end()) return RSP_INVALID_VALUE;
+	return rspMirrorSync(it->second);
+}
+
+int DdrMapInvalidate(uint32_t mapIdx)
+{
+	auto it = maps.find(mapIdx);
+	if (it == maps.end()) return RSP_INVALID_VALUE;
+	rspMirrorInvalidate(it->second);
+	return RSP_SUCCESS;
+}
+
+int DdrMapGetStats(uint32_t mapIdx, DdrMapStats *stats)
+{
+	auto it = maps.find(mapIdx);
+	if (it == maps.end() || !stats) return RSP_INVALID_VALUE;
+
+	std::lock_guard<std::mutex> guard(it->second->lock);
+	*stats = it->second->stats;
+	return RSP_SUCCESS;
+}
+
+int DdrMapClose(uint32_t mapIdx)
+{
+	auto it = maps.find(mapIdx);
+	if (it == maps.end()) return RSP_INVALID_VALUE;
+
+	rsp_int ret = rspMirrorClose(it->second);
+	maps.erase(it);
+	return ret;
+}
+
+// Write errors on the trace file are reported by TraceStop
+int TraceStart(const char *path, uint32_t flags)
+{
+	return rspTraceStart(path, flags);
+}
+
+int TraceStop()
+{
+	return rspTraceStop();
+}
+
+int TraceReplay(const char *path, uint32_t flags, TraceReplayStats *stats)
+{
+	return rspTraceReplay(&rspStreamer, path, flags, stats);
+}
+
+void EnvelopeUnpack(uint32_t *data, size_t length, double scale, double *out)
+{
+	rspEnvelopeUnpack(data, length, scale, out);
+}
+
+int EnvelopeProcess(uint64_t address, size_t length, const EnvelopeConfig *config, double *out, uint64_t *histogram, EnvelopeStats *stats)
+{
+	if (!inDdrWindow(address, length)) return RSP_INVALID_VALUE;
+	return rspEnvelopeProcess(&rspStreamer, static_cast<uint32_t>(address), static_cast<uint32_t>(length * 4),
+        config, out, histogram, stats);
+}
+
+// Host reference of the ET kernel; envOut is packed like the envelope in DDR,
+// two samples per word
+int EtModelRun(uint32_t resamplerRate, uint32_t *shapingTable, uint32_t *iqIn, size_t inSamples, uint32_t *envOut, size_t outSamples)
+{
+	if (!envOut) return RSP_INVALID_VALUE;
+
+	rsp_et_model model;
+	model.rate = resamplerRate;
+	model.table = shapingTable;
+	model.iq = iqIn;
+	model.in_samples = inSamples;
+
+	if (outSamples % 2 != 0) envOut[outSamples / 2] = 0;
+	return rspEtModelRun(&model, reinterpret_cast<uint16_t*>(envOut), outSamples);
+}
+
+int DdrReaderOpen(uint32_t readerIdx, uint64_t address, size_t length, uint32_t depth)
+{
+	if (readers.count(readerIdx) || !inDdrWindow(address, length)) return RSP_INVALID_VALUE;
+
+	rsp_int ret;
+	rsp_reader *reader = rspReaderOpen(&rspStreamer, static_cast<uint32_t>(address),
+        static_cast<uint32_t>(length * 4), depth, &ret);
+	if (reader) readers[readerIdx] = reader;
+	return ret;
+}
+
+int DdrReaderRead(uint32_t readerIdx, uint32_t *data, uint64_t address, size_t length)
+{
+	auto it = readers.find(readerIdx);
+	if (it == readers.end() || !inDdrWindow(address, length)) return RSP_INVALID_VALUE;
+	return rspReaderRead(it->second, data, static_cast<uint32_t>(address), static_cast<uint32_t>(length * 4));
+}
+
+int DdrReaderGetStats(uint32_t readerIdx, DdrReaderStats *stats)
+{
+	auto it = readers.find(readerIdx);
+	if (it == readers.end() || !stats) return RSP_INVALID_VALUE;
+
+	std::lock_guard<std::mutex> guard(it->second->lock);
+	*stats = it->second->stats;
+	return RSP_SUCCESS;
+}
+
+int DdrReaderClose(uint32_t readerIdx)
+{
+	auto it = readers.find(readerIdx);
+	if (it == readers.end()) return RSP_INVALID_VALUE;
+
+	rspReaderClose(it->second);
+	readers.erase(it);
+	return RSP_SUCCESS;
+}
+
+// Limit on every wait for a DMA to go idle; 0 waits forever
+int DmaSetWaitTimeout(uint32_t milliseconds)
+{
+	rspDMASetWaitTimeout(milliseconds);
+	return RSP_SUCCESS;
+}
+
+// copyAddress is the destination of TRANSFER_COPY; data must stay valid
+// until TransferClose
+int TransferStart(uint32_t transferIdx, uint32_t op, uint32_t *data, uint64_t address, uint64_t copyAddress, size_t length, uint32_t deadlineMs, TransferCallback callback, void *user)
+{
+	std::lock_guard<std::mutex> guard(transfersLock);
+	if (transfers.count(transferIdx) || !inDdrWindow(address, length)) return RSP_INVALID_VALUE;
+	if (op == TRANSFER_COPY && !inDdrWindow(copyAddress, length)) return RSP_INVALID_VALUE;
+
+	rsp_int ret;
+	rsp_transfer *transfer = rspTransferStart(&rspStreamer, transferIdx, static_cast<TransferOp>(op), data,
+        static_cast<uint32_t>(address), static_cast<uint32_t>(copyAddress), static_cast<uint32_t>(length * 4),
+        deadlineMs, callback, user, &ret);
+	if (transfer) transfers[transferIdx] = std::shared_ptr<rsp_transfer>(transfer, rspTransferClose);
+	return ret;
+}
+
+static std::shared_ptr<rsp_transfer> findTransfer(uint32_t transferIdx)
+{
+	std::lock_guard<std::mutex> guard(transfersLock);
+	auto it = transfers.find(transferIdx);
+	return it == transfers.end() ? nullptr : it->second;
+}
+
+int TransferGetProgress(uint32_t transferIdx, TransferProgress *progress)
+{
+	std::shared_ptr<rsp_transfer> transfer = findTransfer(transferIdx);
+	if (!transfer || !progress) return RSP_INVALID_VALUE;
+
+	rspTransferGetProgress(transfer.get(), progress);
+	return RSP_SUCCESS;
+}
+
+int TransferCancel(uint32_t transferIdx)
+{
+	std::shared_ptr<rsp_transfer> transfer = findTransfer(transferIdx);
+	if (!transfer) return RSP_INVALID_VALUE;
+
+	rspTransferCancel(transfer.get());
+	return RSP_SUCCESS;
+}
+
+int TransferWait(uint32_t transferIdx, uint32_t timeoutMs)
+{
+	std::shared_ptr<rsp_transfer> transfer = findTransfer(transferIdx);
+	if (!transfer) return RSP_INVALID_VALUE;
+	return rspTransferWait(transfer.get(), timeoutMs);
+}
+
+int TransferClose(uint32_t transferIdx)
+{
+	std::shared_ptr<rsp_transfer> transfer;
+	{
+		std::lock_guard<std::mutex> guard(transfersLock);
+		auto it = transfers.find(transferIdx);
+		if (it == transfers.end()) return RSP_INVALID_VALUE;
+		transfer = it->second;
+		transfers.erase(it);
+	}
+
+	// joined outside the lock, the callback may still look up transfers;
+	// freed once the last TransferWait on it has returned
+	rspTransferStop(transfer.get());
+	return RSP_SUCCESS;
+}
+
+// Starts the I/O thread of the module; IoSubmit is served in priority order
+// from then on. Other exports keep going to the module directly.
+int IoSchedulerOpen(uint32_t sessionIdx)
+{
+	const rsp_streamer *streamer = sessionStreamer(sessionIdx);
+	if (!streamer) return RSP_INVALID_VALUE;
+
+	std::lock_guard<std::mutex> guard(schedulersLock);
+	if (schedulers.count(sessionIdx)) return RSP_INVALID_VALUE;
+
+	rsp_int ret;
+	rsp_scheduler *scheduler = rspSchedulerOpen(streamer, &ret);
+	if (scheduler) schedulers[sessionIdx] = std::shared_ptr<rsp_scheduler>(scheduler, rspSchedulerClose);
+	return ret;
+}
+
+static std::shared_ptr<rsp_scheduler> findScheduler(uint32_t sessionIdx)
+{
+	std::lock_guard<std::mutex> guard(schedulersLock);
+	auto it = schedulers.find(sessionIdx);
+	return it == schedulers.end() ? nullptr : it->second;
+}
+
+// Blocks until the request is done; length is in words
+int IoSubmit(uint32_t sessionIdx, uint32_t priority, uint32_t op, uint32_t *data, uint64_t address, size_t length)
+{
+	std::shared_ptr<rsp_scheduler> scheduler = findScheduler(sessionIdx);
+	if (!scheduler || length > 0xFFFFFFFF / 4) return RSP_INVALID_VALUE;
+
+	return rspSchedulerSubmit(scheduler.get(), static_cast<IoPriority>(priority), static_cast<IoOp>(op), data,
+        address, static_cast<uint32_t>(length * 4));
+}
+
+int IoSchedulerGetStats(uint32_t sessionIdx, IoSchedulerStats *stats)
+{
+	std::shared_ptr<rsp_scheduler> scheduler = findScheduler(sessionIdx);
+	if (!scheduler || !stats) return RSP_INVALID_VALUE;
+
+	rspSchedulerGetStats(scheduler.get(), stats);
+	return RSP_SUCCESS;
+}
+
+int IoSchedulerResetStats(uint32_t sessionIdx)
+{
+	std::shared_ptr<rsp_scheduler> scheduler = findScheduler(sessionIdx);
+	if (!scheduler) return RSP_INVALID_VALUE;
+
+	rspSchedulerResetStats(scheduler.get());
+	return RSP_SUCCESS;
+}
+
+// Completes the queued requests first; IoSubmit calls that come later are
+// refused
+int IoSchedulerClose(uint32_t sessionIdx)
+{
+	std::shared_ptr<rsp_scheduler> scheduler;
+	{
+		std::lock_guard<std::mutex> guard(schedulersLock);
+		auto it = schedulers.find(sessionIdx);
+		if (it == schedulers.end()) return RSP_INVALID_VALUE;
+		scheduler = it->second;
+		schedulers.erase(it);
+	}
+
+	// freed once the last IoSubmit still waking up has returned
+	rspSchedulerStop(scheduler.get());
+	return RSP_SUCCESS;
+}
+
+// Stores length packed IQ words (I in the low half) as a waveform file;
+// scale is kept with the codes for the host side
+int WaveformWrite(const char *path, uint32_t *iq, size_t length, double scale, uint32_t flags)
+{
+	rsp_int ret;
+	rsp_waveform_writer *writer = rspWaveformWriterOpen(path, scale, flags, &ret);
+	if (!writer) return ret;
+
+	ret = rspWaveformWriterAppend(writer, iq, length);
+	rsp_int closeRet = rspWaveformWriterClose(writer);
+	return ret != RSP_SUCCESS ? ret : closeRet;
+}
+
+// *scale 0 picks the scale that fits the peak magnitude and returns it
+int WaveformConvertCsv(const char *csvPath, const char *path, uint32_t flags, double *scale)
+{
+	return rspWaveformConvertCsv(csvPath, path, flags, scale);
+}
+
+int WaveformGetInfo(const char *path, WaveformInfo *info)
+{
+	return rspWaveformGetInfo(path, info);
+}
+
+// first and length count samples, i.e. words; length 0 uploads the rest of the file
+int WaveformUpload(const char *path, uint64_t address, size_t first, size_t length, WaveformUploadStats *stats)
+{
+	if (address > 0xFFFFFFFF) return RSP_INVALID_VALUE;
+	return rspWaveformUpload(&rspStreamer, path, static_cast<uint32_t>(address), first, length, stats);
+}
+
+// periodMs and slots 0 take the defaults. Every open session is published
+// once a period until TelemetryStop or SessionClose.
+int TelemetryStart(uint32_t periodMs, uint32_t slots)
+{
+	return rspTelemetryStart(periodMs, slots);
+}
+
+int TelemetryStop()
+{
+	return rspTelemetryStop();
+}
+
+// For a monitor process: reads the ring of processId (0 for the calling
+// process) without opening a session
+int TelemetryRead(uint32_t processId, TelemetrySample *samples, size_t maxSamples, size_t *count)
+{
+	return rspTelemetryRead(processId, samples, maxSamples, count);
+}
+
+// pairs counts IQ pairs, iq holds them interleaved I,Q
+int SampleFormatWords(uint32_t format, size_t pairs, size_t *words)
+{
+	if (!words) return RSP_INVALID_VALUE;
+	if (format >= SAMPLE_FORMAT_COUNT) return RSP_INVALID_ENUM;
+	*words = rspSampleWords(static_cast<SampleFormat>(format), pairs);
+	return RSP_SUCCESS;
+}
+
+// *scale 0 picks the scale that fits the peak magnitude and returns it;
+// markers may be null
+int SamplePack(uint32_t format, double *iq, size_t pairs, double *scale, uint8_t *markers, uint32_t *words, size_t *clipped)
+{
+	if (!scale) return RSP_INVALID_VALUE;
+	if (format >= SAMPLE_FORMAT_COUNT) return RSP_INVALID_ENUM;
+	if (!(*scale > 0)) *scale = rspSampleAutoScale(static_cast<SampleFormat>(format), iq, pairs);
+	return rspSamplePack(static_cast<SampleFormat>(format), iq, pairs, *scale, markers, words, clipped);
+}
+
+int SampleUnpack(uint32_t format, uint32_t *words, size_t pairs, double scale, double *iq, uint8_t *markers)
+{
+	return rspSampleUnpack(static_cast<SampleFormat>(format), words, pairs, scale, iq, markers);
+}
+
+int DdrWriteSamples(uint32_t format, double *iq, uint64_t address, size_t pairs, double *scale, uint8_t *markers, size_t *clipped)
+{
+	if (address > 0xFFFFFFFF) return RSP_INVALID_VALUE;
+	return rspDdrWriteSamples(&rspStreamer, static_cast<SampleFormat>(format), iq, static_cast<uint32_t>(address),
+        pairs, scale, markers, clipped);
+}
+
+int DdrReadSamples(uint32_t format, double *iq, uint64_t address, size_t pairs, double scale, uint8_t *markers)
+{
+	if (address > 0xFFFFFFFF) return RSP_INVALID_VALUE;
+	return rspDdrReadSamples(&rspStreamer, static_cast<SampleFormat>(format), iq, static_cast<uint32_t>(address),
+        pairs, scale, markers);
 }
\ No newline at end of file
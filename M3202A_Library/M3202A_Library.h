@@ -1,10 +1,378 @@
 #pragma once
 
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32)
 #ifdef M3202A_LIBRARY_EXPORTS  
 #define M3202A_LIBRARY_EXPORTS_API __declspec(dllexport)   
 #else  
 #define M3202A_LIBRARY_EXPORTS_API __declspec(dllimport)   
 #endif  
+#else
+// the shared object is built with hidden visibility, only the API is exported
+#define M3202A_LIBRARY_EXPORTS_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Counters reported by StreamGetStats
+typedef struct StreamStats
+{
+	uint64_t bytesWritten;       // bytes handed to rspKernelInstanceStreamWrite
+	uint64_t bytesRead;          // bytes returned by rspKernelInstanceStreamRead
+	uint64_t chunksWritten;
+	uint64_t chunksRead;
+	uint64_t producerStalls;     // StreamWrite calls that waited for ring space
+	uint64_t consumerStalls;     // StreamRead calls that waited for data
+	uint64_t writeQueued;        // bytes waiting in the host-to-kernel ring
+	uint64_t readQueued;         // bytes waiting in the kernel-to-host ring
+	double writeBytesPerSecond;  // averaged since StreamOpen
+	double readBytesPerSecond;
+} StreamStats;
+
+// Envelope tracker pipeline set up for EtRun. Blocks alternate between the
+// two paInAddr/envOutAddr pairs.
+typedef struct EtConfig
+{
+	uint64_t etRegBase;          // envelope tracker register base
+	uint64_t dmaRegBase;         // streamer DMA feeding the tracker
+	uint64_t paInAddr[2];        // DDR regions holding packed IQ input
+	uint64_t envOutAddr[2];      // DDR regions receiving the 16-bit envelope
+	uint32_t samplesPerBlock;    // IQ samples per block
+	uint32_t osr;                // oversampling ratio of the resampler
+} EtConfig;
+
+// Results reported by EtRun
+typedef struct EtStats
+{
+	uint64_t blocks;
+	uint64_t inputSamples;
+	uint64_t outputSamples;
+	double seconds;
+	double samplesPerSecond;     // input samples per second over the whole run
+	double uploadSeconds;        // host time spent writing waveform blocks
+	double readbackSeconds;      // host time spent reading envelope blocks
+	double waitSeconds;          // host time spent waiting on the FPGA
+} EtStats;
+
+// Opcodes of the command list executed by CommandListSubmit. Every command
+// starts with its opcode word, 64-bit fields are stored low word first:
+//   COMMAND_REG_WRITE        address, value
+//   COMMAND_REG_ARRAY_WRITE  address, length, data[length]
+//   COMMAND_DDR_WRITE        address, length, data[length]
+//   COMMAND_DDR_COPY         startAddress, endAddress, length
+//   COMMAND_WAIT_IDLE        DMA register base, channels (DmaChannel)
+// Lengths are in 32-bit words.
+enum CommandOp
+{
+	COMMAND_REG_WRITE = 1,
+	COMMAND_REG_ARRAY_WRITE = 2,
+	COMMAND_DDR_WRITE = 3,
+	COMMAND_DDR_COPY = 4,
+	COMMAND_WAIT_IDLE = 5
+};
+
+// DMA channels, combined as a bit mask where a direction is expected
+enum DmaChannel
+{
+	DMA_MM2S = 1,
+	DMA_S2MM = 2,
+	DMA_BOTH = 3
+};
+
+// Decoded DMASR of one DMA channel
+typedef struct DmaChannelStatus
+{
+	uint32_t raw;                // DMASR as read
+	uint32_t halted;             // run/stop cleared or reset
+	uint32_t idle;               // transfer finished
+	uint32_t error;              // DMAIntErr, DMASlvErr or DMADecErr
+	uint32_t ioc;                // interrupt on complete pending
+} DmaChannelStatus;
+
+typedef struct DmaStatus
+{
+	DmaChannelStatus mm2s;
+	DmaChannelStatus s2mm;
+} DmaStatus;
+
+// Fault handling of the DMA transfer paths (DdrCopy and the PC memory
+// transfers), counted since load or the last DmaResetErrorCounters
+typedef struct DmaErrorCounters
+{
+	uint64_t chunks;             // chunks completed or abandoned
+	uint64_t faults;             // attempts that ended in a DMA error
+	uint64_t retries;            // chunks re-issued after a fault
+	uint64_t failures;           // chunks abandoned at the retry limit
+} DmaErrorCounters;
+
+// Upload accounting of a table opened with LutOpen
+typedef struct LutStats
+{
+	uint64_t loads;              // LutLoad calls
+	uint64_t swaps;              // bank switches
+	uint64_t writes;             // register/array writes issued
+	uint64_t entriesWritten;     // entries sent to the module
+	uint64_t entriesSkipped;     // entries already holding the requested value
+} LutStats;
+
+// Page traffic of a region opened with DdrMapOpen
+typedef struct DdrMapStats
+{
+	uint64_t readFaults;         // first reads of a page
+	uint64_t writeFaults;        // first writes to a page since the last sync
+	uint64_t pagesFetched;
+	uint64_t bytesFetched;
+	uint64_t pagesWrittenBack;
+	uint64_t bytesWrittenBack;
+	uint64_t writeBacks;         // transfers issued by DdrMapSync, one per run of dirty pages
+	uint64_t fetchErrors;        // pages that could not be read; the access faults as usual
+} DdrMapStats;
+
+// Counters of a reader opened with DdrReaderOpen
+typedef struct DdrReaderStats
+{
+	uint64_t reads;              // DdrReaderRead calls
+	uint64_t hits;               // reads served entirely from prefetched blocks
+	uint64_t misses;             // reads that went to DDR for some of their data
+	uint64_t waits;              // hits that waited for a prefetch still in progress
+	uint64_t resets;             // non-sequential reads that dropped the read-ahead
+	uint64_t bytesFromRing;
+	uint64_t bytesDirect;
+	uint64_t bytesPrefetched;
+} DdrReaderStats;
+
+// Calls recorded by TraceStart, in TraceReplayStats::ops order. Only the Reg*,
+// Ddr* transfer, DdrChecksum, Ddr*Samples and TransferStart calls are
+// recorded. Traffic of DdrPeerCopy, CommandListSubmit, EtRun, IoSubmit,
+// streams, LUTs, readers, waveform and envelope helpers and DdrMap page
+// fetches and syncs is not: it spans two modules or comes from library
+// threads, and a trace is replayed against one module from one thread.
+enum TraceOp
+{
+	TRACE_REG_READ = 0,
+	TRACE_REG_WRITE = 1,
+	TRACE_REG_ARRAY_READ = 2,
+	TRACE_REG_ARRAY_WRITE = 3,
+	TRACE_DDR_READ = 4,
+	TRACE_DDR_WRITE = 5,
+	TRACE_DDR_COPY = 6,
+	TRACE_DDR_CHECKSUM = 7,
+	TRACE_OP_COUNT = 8
+};
+
+// TraceStart flags
+enum TraceFlags
+{
+	TRACE_CAPTURE_DATA = 1       // store written data, not only its CRC32C
+};
+
+// TraceReplay flags
+enum TraceReplayFlags
+{
+	TRACE_REPLAY_TIMED = 1       // keep the recorded gaps between calls
+};
+
+typedef struct TraceOpStats
+{
+	uint64_t calls;
+	uint64_t bytes;
+	double recordedSeconds;      // time inside the call when captured
+	double replaySeconds;        // time inside the call on replay
+	double maxReplaySeconds;     // slowest single call on replay
+} TraceOpStats;
+
+// Where the time of a trace went, as reported by TraceReplay
+typedef struct TraceReplayStats
+{
+	uint64_t records;
+	uint64_t errors;             // calls that failed on replay
+	uint64_t mismatches;         // reads returning other data than captured
+	double recordedSeconds;      // first call to last return in the capture
+	double recordedIdleSeconds;  // part of it spent outside traced calls
+	double replaySeconds;
+	TraceOpStats ops[TRACE_OP_COUNT];
+} TraceReplayStats;
+
+// Post-processing of an envelope capture by EnvelopeProcess. Each 32-bit word
+// holds two int16 samples, the first in the low half.
+typedef struct EnvelopeConfig
+{
+	double scale;                // applied to every sample, e.g. the scaleFactor of the waveform
+	uint32_t decimation;         // samples averaged into one output value, 0 or 1 keeps them all
+	uint32_t histogramBins;      // bins spread evenly over the int16 range, 0 for none
+} EnvelopeConfig;
+
+// Statistics of the samples seen by EnvelopeProcess, in scaled units
+typedef struct EnvelopeStats
+{
+	uint64_t samples;
+	uint64_t outputSamples;
+	double min;
+	double max;
+	double mean;
+	double rms;
+	double readSeconds;          // host time spent reading DDR
+	double processSeconds;       // time spent in the kernels not hidden behind the reads
+} EnvelopeStats;
+
+// Returned on top of the rsp error codes
+enum LibraryError
+{
+	LIBRARY_TIMEOUT = -1000,     // a DMA did not go idle, a transfer passed its deadline or a
+	                             // stream did not stop
+	LIBRARY_CANCELLED = -1001,   // the transfer was stopped by TransferCancel
+	LIBRARY_DMA_FAULT = -1002    // a DMA chunk still reported an internal, slave or decode
+	                             // error after its last retry
+};
+
+// Operations run in the background by TransferStart
+enum TransferOp
+{
+	TRANSFER_READ = 0,           // DDR to data
+	TRANSFER_WRITE = 1,          // data to DDR
+	TRANSFER_COPY = 2            // DDR to DDR through DMA_1, data is unused
+};
+
+// Called from the transfer thread after every chunk and once more when the
+// transfer ends; user is the pointer given to TransferStart. It must not wait
+// for or close its own transfer.
+typedef void (*TransferCallback)(uint32_t transferIdx, uint64_t bytesDone, uint64_t bytesTotal, void *user);
+
+// Snapshot reported by TransferGetProgress
+typedef struct TransferProgress
+{
+	uint64_t bytesDone;
+	uint64_t bytesTotal;
+	uint32_t finished;           // nonzero once the transfer thread is done
+	int32_t result;              // return code of the transfer once finished
+	double seconds;              // since TransferStart, up to the end of the transfer
+} TransferProgress;
+
+// Classes of IoSubmit, served strictly in this order
+enum IoPriority
+{
+	IO_PRIORITY_CONTROL = 0,     // register traffic whose latency matters
+	IO_PRIORITY_NORMAL = 1,
+	IO_PRIORITY_BULK = 2,        // large uploads and captures
+	IO_PRIORITY_COUNT = 3
+};
+
+// Operations of IoSubmit. IO_REG_WRITE takes its value from data[0].
+enum IoOp
+{
+	IO_REG_READ = 0,
+	IO_REG_WRITE = 1,
+	IO_REG_ARRAY_READ = 2,
+	IO_REG_ARRAY_WRITE = 3,
+	IO_DDR_READ = 4,
+	IO_DDR_WRITE = 5
+};
+
+// Latency of one priority class, from IoSubmit to its return. Percentiles
+// come from a log histogram and are upper bounds within 25%.
+typedef struct IoClassStats
+{
+	uint64_t requests;
+	uint64_t bytes;
+	double meanSeconds;
+	double p50Seconds;
+	double p99Seconds;
+	double p999Seconds;
+	double maxSeconds;
+} IoClassStats;
+
+// Reported by IoSchedulerGetStats, in IoPriority order
+typedef struct IoSchedulerStats
+{
+	uint64_t pieces;             // page-sized pieces issued for DDR requests
+	uint64_t queued;             // requests waiting at the time of the call
+	IoClassStats classes[IO_PRIORITY_COUNT];
+} IoSchedulerStats;
+
+// WaveformWrite / WaveformConvertCsv flags
+enum WaveformFlags
+{
+	WAVEFORM_DELTA = 1           // delta code the blocks that get smaller by it
+};
+
+// Header of a waveform file, as reported by WaveformGetInfo
+typedef struct WaveformInfo
+{
+	uint64_t samples;            // IQ samples, one 32-bit word each
+	uint64_t fileBytes;
+	uint32_t blockSamples;
+	uint32_t blocks;
+	double scale;                // full scale of the int16 codes, as from ScaleToFixedPoint
+} WaveformInfo;
+
+// Where the time of WaveformUpload went
+typedef struct WaveformUploadStats
+{
+	uint64_t samples;
+	uint64_t fileBytes;          // compressed bytes read from disk
+	double readSeconds;          // disk reads
+	double decodeSeconds;        // decoding, overlapped with the DDR writes
+	double writeSeconds;         // DDR writes not hidden behind decoding
+	double seconds;
+} WaveformUploadStats;
+
+// Layouts of IQ pairs in DDR for SamplePack and DdrWriteSamples. Codes are
+// two's complement, pairs follow each other from the lowest address up.
+enum SampleFormat
+{
+	SAMPLE_IQ16 = 0,             // a word per pair, I in bits 15..0 and Q in 31..16, as PackToUInt32
+	SAMPLE_IQ24_MARKERS = 1,     // two words per pair, I then Q, each code in bits 31..8; bits 3..0
+	                             // of the I word hold the four marker bits of the pair
+	SAMPLE_FLOAT32 = 2,          // two IEEE single words per pair, I then Q, full scale 1.0
+	SAMPLE_IQ12_PACKED = 3,      // 24 bits per pair, I in the low 12; four pairs in three words
+	SAMPLE_FORMAT_COUNT = 4
+};
+
+// Shared memory written by TelemetryStart, named M3202A_Telemetry_<process id>
+// (Local\ prefixed on Windows, / prefixed POSIX shared memory elsewhere). It
+// holds a TelemetryRingHeader followed by its slots.
+enum TelemetryRing
+{
+	TELEMETRY_MAGIC = 0x4D4C4554,   // "TELM"
+	TELEMETRY_VERSION = 1
+};
+
+// One session at the end of a telemetry period
+typedef struct TelemetrySample
+{
+	uint64_t timeNs;             // steady clock of the publishing process
+	uint32_t sessionIdx;
+	uint32_t queueDepth;         // IoSubmit requests and transfers not finished
+	uint64_t bytesToDdr;         // totals since the process first used the module
+	uint64_t bytesFromDdr;
+	uint64_t bytesCopied;        // DDR to DDR by DMA
+	uint64_t pagerSwitches;      // host window page selections
+	double toDdrBytesPerSecond;  // over the period
+	double fromDdrBytesPerSecond;
+	double dmaBusy[2];           // fraction of the period DMA_1 and DMA_2 had a chunk running
+} TelemetrySample;
+
+typedef struct TelemetryRingHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t slots;
+	uint32_t periodMs;
+	uint64_t published;          // samples written so far; sample n is in slot n % slots
+} TelemetryRingHeader;
+
+// sequence is odd while the sample is being written and 2 * (n / slots + 1)
+// once sample n is complete. A reader copies the sample and keeps it only if
+// sequence read the same value, the one expected for n, before and after.
+typedef struct TelemetrySlot
+{
+	uint64_t sequence;
+	TelemetrySample sample;
+} TelemetrySlot;
 
 M3202A_LIBRARY_EXPORTS_API void SessionOpen();
 M3202A_LIBRARY_EXPORTS_API void SessionClose();
@@ -15,4 +383,74 @@ M3202A_LIBRARY_EXPORTS_API int RegArrayRead(uint32_t *data, uint64_t address, si
 M3202A_LIBRARY_EXPORTS_API int RegArrayWrite(uint32_t *data, uint64_t address, size_t length);
 M3202A_LIBRARY_EXPORTS_API int DdrRead(uint32_t *data, uint64_t address, size_t length);
 M3202A_LIBRARY_EXPORTS_API int DdrWrite(uint32_t *data, uint64_t address, size_t length);
-M3202A_LIBRARY_EXPORTS_API int DdrCopy(uint64_t startAddress, uint64_t endAddress, size_t length);
\ No newline at end of file
+M3202A_LIBRARY_EXPORTS_API int DdrCopy(uint64_t startAddress, uint64_t endAddress, size_t length);
+// Stream lengths count 32-bit words, but kernel streams move 64-bit words:
+// StreamWrite and StreamRead reject an odd length with RSP_INVALID_VALUE
+M3202A_LIBRARY_EXPORTS_API int StreamOpen(size_t streamIdx, size_t chunkBytes, size_t ringBytes);
+M3202A_LIBRARY_EXPORTS_API int StreamWrite(size_t streamIdx, uint32_t *data, size_t length);
+M3202A_LIBRARY_EXPORTS_API int StreamRead(size_t streamIdx, uint32_t *data, size_t length);
+M3202A_LIBRARY_EXPORTS_API int StreamFlush(size_t streamIdx);
+M3202A_LIBRARY_EXPORTS_API int StreamGetStats(size_t streamIdx, StreamStats *stats);
+M3202A_LIBRARY_EXPORTS_API int StreamClose(size_t streamIdx);
+M3202A_LIBRARY_EXPORTS_API int EtRun(const EtConfig *config, uint32_t *iqIn, uint32_t *envOut, size_t numBlocks, EtStats *stats);
+M3202A_LIBRARY_EXPORTS_API int CommandListSubmit(uint32_t *commands, size_t length, uint32_t *failedCommand);
+M3202A_LIBRARY_EXPORTS_API int DmaGetStatus(uint64_t dmaBaseAddr, DmaStatus *status);
+M3202A_LIBRARY_EXPORTS_API int DmaGetStatusAll(DmaStatus *status);
+M3202A_LIBRARY_EXPORTS_API int DmaGetErrorCounters(DmaErrorCounters *counters);
+M3202A_LIBRARY_EXPORTS_API void DmaResetErrorCounters();
+M3202A_LIBRARY_EXPORTS_API uint32_t Crc32c(uint32_t crc, uint32_t *data, size_t length);
+M3202A_LIBRARY_EXPORTS_API int DdrWriteCrc(uint32_t *data, uint64_t address, size_t length, uint32_t *crc);
+M3202A_LIBRARY_EXPORTS_API int DdrReadCrc(uint32_t *data, uint64_t address, size_t length, uint32_t *crc);
+M3202A_LIBRARY_EXPORTS_API int DdrCopyCrc(uint64_t startAddress, uint64_t endAddress, size_t length, uint32_t *crc);
+M3202A_LIBRARY_EXPORTS_API int DdrChecksum(uint64_t address, size_t length, uint32_t *crc);
+M3202A_LIBRARY_EXPORTS_API int LutOpen(uint32_t lutIdx, uint64_t bank0Address, uint64_t bank1Address, uint64_t selectAddress, size_t length);
+M3202A_LIBRARY_EXPORTS_API int LutLoad(uint32_t lutIdx, uint32_t *table, uint32_t *entriesWritten);
+M3202A_LIBRARY_EXPORTS_API int LutSwap(uint32_t lutIdx);
+M3202A_LIBRARY_EXPORTS_API int LutInvalidate(uint32_t lutIdx);
+M3202A_LIBRARY_EXPORTS_API int LutGetStats(uint32_t lutIdx, LutStats *stats);
+M3202A_LIBRARY_EXPORTS_API int LutClose(uint32_t lutIdx);
+M3202A_LIBRARY_EXPORTS_API int SessionOpenDevice(uint32_t sessionIdx, const char *deviceId);
+M3202A_LIBRARY_EXPORTS_API int SessionCloseDevice(uint32_t sessionIdx);
+M3202A_LIBRARY_EXPORTS_API int DdrPeerCopy(uint32_t srcSession, uint64_t srcAddress, uint32_t dstSession, uint64_t dstAddress, size_t length);
+M3202A_LIBRARY_EXPORTS_API int DdrMapOpen(uint32_t mapIdx, uint64_t address, size_t length, uint32_t **view);
+M3202A_LIBRARY_EXPORTS_API int DdrMapSync(uint32_t mapIdx);
+M3202A_LIBRARY_EXPORTS_API int DdrMapInvalidate(uint32_t mapIdx);
+M3202A_LIBRARY_EXPORTS_API int DdrMapGetStats(uint32_t mapIdx, DdrMapStats *stats);
+M3202A_LIBRARY_EXPORTS_API int DdrMapClose(uint32_t mapIdx);
+M3202A_LIBRARY_EXPORTS_API int TraceStart(const char *path, uint32_t flags);
+M3202A_LIBRARY_EXPORTS_API int TraceStop();
+M3202A_LIBRARY_EXPORTS_API int TraceReplay(const char *path, uint32_t flags, TraceReplayStats *stats);
+M3202A_LIBRARY_EXPORTS_API void EnvelopeUnpack(uint32_t *data, size_t length, double scale, double *out);
+M3202A_LIBRARY_EXPORTS_API int EnvelopeProcess(uint64_t address, size_t length, const EnvelopeConfig *config, double *out, uint64_t *histogram, EnvelopeStats *stats);
+M3202A_LIBRARY_EXPORTS_API int EtModelRun(uint32_t resamplerRate, uint32_t *shapingTable, uint32_t *iqIn, size_t inSamples, uint32_t *envOut, size_t outSamples);
+M3202A_LIBRARY_EXPORTS_API int DdrReaderOpen(uint32_t readerIdx, uint64_t address, size_t length, uint32_t depth);
+M3202A_LIBRARY_EXPORTS_API int DdrReaderRead(uint32_t readerIdx, uint32_t *data, uint64_t address, size_t length);
+M3202A_LIBRARY_EXPORTS_API int DdrReaderGetStats(uint32_t readerIdx, DdrReaderStats *stats);
+M3202A_LIBRARY_EXPORTS_API int DdrReaderClose(uint32_t readerIdx);
+M3202A_LIBRARY_EXPORTS_API int DmaSetWaitTimeout(uint32_t milliseconds);
+M3202A_LIBRARY_EXPORTS_API int TransferStart(uint32_t transferIdx, uint32_t op, uint32_t *data, uint64_t address, uint64_t copyAddress, size_t length, uint32_t deadlineMs, TransferCallback callback, void *user);
+M3202A_LIBRARY_EXPORTS_API int TransferGetProgress(uint32_t transferIdx, TransferProgress *progress);
+M3202A_LIBRARY_EXPORTS_API int TransferCancel(uint32_t transferIdx);
+M3202A_LIBRARY_EXPORTS_API int TransferWait(uint32_t transferIdx, uint32_t timeoutMs);
+M3202A_LIBRARY_EXPORTS_API int TransferClose(uint32_t transferIdx);
+M3202A_LIBRARY_EXPORTS_API int IoSchedulerOpen(uint32_t sessionIdx);
+M3202A_LIBRARY_EXPORTS_API int IoSubmit(uint32_t sessionIdx, uint32_t priority, uint32_t op, uint32_t *data, uint64_t address, size_t length);
+M3202A_LIBRARY_EXPORTS_API int IoSchedulerGetStats(uint32_t sessionIdx, IoSchedulerStats *stats);
+M3202A_LIBRARY_EXPORTS_API int IoSchedulerResetStats(uint32_t sessionIdx);
+M3202A_LIBRARY_EXPORTS_API int IoSchedulerClose(uint32_t sessionIdx);
+M3202A_LIBRARY_EXPORTS_API int WaveformWrite(const char *path, uint32_t *iq, size_t length, double scale, uint32_t flags);
+M3202A_LIBRARY_EXPORTS_API int WaveformConvertCsv(const char *csvPath, const char *path, uint32_t flags, double *scale);
+M3202A_LIBRARY_EXPORTS_API int WaveformGetInfo(const char *path, WaveformInfo *info);
+M3202A_LIBRARY_EXPORTS_API int WaveformUpload(const char *path, uint64_t address, size_t first, size_t length, WaveformUploadStats *stats);
+M3202A_LIBRARY_EXPORTS_API int TelemetryStart(uint32_t periodMs, uint32_t slots);
+M3202A_LIBRARY_EXPORTS_API int TelemetryStop();
+M3202A_LIBRARY_EXPORTS_API int TelemetryRead(uint32_t processId, TelemetrySample *samples, size_t maxSamples, size_t *count);
+M3202A_LIBRARY_EXPORTS_API int SampleFormatWords(uint32_t format, size_t pairs, size_t *words);
+M3202A_LIBRARY_EXPORTS_API int SamplePack(uint32_t format, double *iq, size_t pairs, double *scale, uint8_t *markers, uint32_t *words, size_t *clipped);
+M3202A_LIBRARY_EXPORTS_API int SampleUnpack(uint32_t format, uint32_t *words, size_t pairs, double scale, double *iq, uint8_t *markers);
+M3202A_LIBRARY_EXPORTS_API int DdrWriteSamples(uint32_t format, double *iq, uint64_t address, size_t pairs, double *scale, uint8_t *markers, size_t *clipped);
+M3202A_LIBRARY_EXPORTS_API int DdrReadSamples(uint32_t format, double *iq, uint64_t address, size_t pairs, double scale, uint8_t *markers);
+
+#ifdef __cplusplus
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,193 @@
+#include "stdafx.h"
+
+#include "cmdlist.h"
+#include "dma_status.h"
+
+#include <vector>
+
+// A decoded command. data points into the caller's list, nothing is copied.
+struct rsp_command
+{
+	uint32_t op;
+	uint32_t index;
+	uint64_t address;
+	uint64_t address2;
+	uint32_t length;
+	uint32_t value;
+	const uint32_t *data;
+};
+
+static uint64_t readAddress(const uint32_t *words)
+{
+	return static_cast<uint64_t>(words[0]) | (static_cast<uint64_t>(words[1]) << 32);
+}
+
+// Decodes the whole list up front so a malformed list is rejected before
+// anything reaches the hardware
+static rsp_int parseCommands(const uint32_t *commands,
+                             size_t length,
+                             std::vector<rsp_command> &parsed,
+                             uint32_t *failed_command)
+{
+	size_t pos = 0;
+	uint32_t index = 0;
+	while (pos < length)
+	{
+		rsp_command command = rsp_command();
+		command.op = commands[pos];
+		command.index = index;
+
+		const uint32_t *args = commands + pos + 1;
+		size_t available = length - pos - 1;
+		size_t size;
+
+		switch (command.op)
+		{
+		case COMMAND_REG_WRITE:
+			size = 3;
+			if (available < size) break;
+			command.address = readAddress(args);
+			command.value = args[2];
+			break;
+
+		case COMMAND_REG_ARRAY_WRITE:
+		case COMMAND_DDR_WRITE:
+			size = 3;
+			if (available < size) break;
+			command.address = readAddress(args);
+			command.length = args[2];
+			command.data = args + 3;
+			size += command.length;
+			break;
+
+		case COMMAND_DDR_COPY:
+			size = 5;
+			if (available < size) break;
+			command.address = readAddress(args);
+			command.address2 = readAddress(args + 2);
+			command.length = args[4];
+			break;
+
+		case COMMAND_WAIT_IDLE:
+			size = 3;
+			if (available < size) break;
+			command.address = readAddress(args);
+			command.value = args[2];
+			if (command.value < DMA_MM2S || command.value > DMA_BOTH)
+			{
+				if (failed_command) *failed_command = index;
+				return RSP_INVALID_ENUM;
+			}
+			break;
+
+		default:
+			if (failed_command) *failed_command = index;
+			return RSP_INVALID_ENUM;
+		}
+
+		if (available < size)
+		{
+			if (failed_command) *failed_command = index;
+			return RSP_INVALID_VALUE;
+		}
+
+		parsed.push_back(command);
+		pos += 1 + size;
+		index++;
+	}
+	return RSP_SUCCESS;
+}
+
+static bool isRegisterWrite(const rsp_command &command)
+{
+	return command.op == COMMAND_REG_WRITE || command.op == COMMAND_REG_ARRAY_WRITE;
+}
+
+static void appendRegisterWrite(const rsp_command &command, std::vector<uint32_t> &run)
+{
+	if (command.op == COMMAND_REG_WRITE)
+	{
+		run.push_back(command.value);
+	}
+	else
+	{
+		run.insert(run.end(), command.data, command.data + command.length);
+	}
+}
+
+rsp_int rspCommandListExecute(const rsp_streamer *streamer,
+                              const uint32_t *commands,
+                              size_t length,
+                              uint32_t *failed_command)
+{
+	if (!streamer || (!commands && length > 0)) return RSP_INVALID_VALUE;
+
+	std::vector<rsp_command> parsed;
+	rsp_int returnCode = parseCommands(commands, length, parsed, failed_command);
+	if (returnCode != RSP_SUCCESS) return returnCode;
+
+	rsp_kernel_instance kernel_inst = streamer->kernel_inst;
+	std::vector<uint32_t> run;
+
+	for (size_t i = 0; i < parsed.size();)
+	{
+		const rsp_command &command = parsed[i];
+
+		switch (command.op)
+		{
+		case COMMAND_REG_WRITE:
+		case COMMAND_REG_ARRAY_WRITE:
+		{
+			// merge the following register writes as long as they continue
+			// exactly where the previous one ended
+			run.clear();
+			appendRegisterWrite(command, run);
+
+			size_t next = i + 1;
+			while (next < parsed.size() && isRegisterWrite(parsed[next])
+				&& parsed[next].address == command.address + run.size() * 4)
+			{
+				appendRegisterWrite(parsed[next], run);
+				next++;
+			}
+
+			if (command.op == COMMAND_REG_WRITE && next == i + 1)
+			{
+				returnCode = rspKernelInstanceRegisterWrite(kernel_inst, command.value, command.address);
+			}
+			else if (!run.empty())
+			{
+				returnCode = rspKernelInstanceArrayWrite(kernel_inst, run.data(), command.address,
+                    run.size() * 4);
+			}
+			i = next;
+			break;
+		}
+
+		case COMMAND_DDR_WRITE:
+			returnCode = rspStreamerWriteHost(streamer, static_cast<uint32_t>(command.address),
+                const_cast<uint32_t*>(command.data), command.length * 4);
+			i++;
+			break;
+
+		case COMMAND_DDR_COPY:
+			returnCode = rspStreamerCopyDMA(streamer, RSP_STREAMER_DMA_1, static_cast<uint32_t>(command.address),
+                static_cast<uint32_t>(command.address2), command.length * 4);
+			i++;
+			break;
+
+		case COMMAND_WAIT_IDLE:
+			returnCode = rspDMAWaitIdle(kernel_inst, command.address, command.value, nullptr);
+			i++;
+			break;
+		}
+
+		if (returnCode != RSP_SUCCESS)
+		{
+			// a merged run reports its first command
+			if (failed_command) *failed_command = command.index;
+			return returnCode;
+		}
+	}
+	return RSP_SUCCESS;
+}
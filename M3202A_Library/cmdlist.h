@@ -0,0 +1,11 @@
+#pragma once
+
+#include "M3202A_Library.h"
+
+// Executes a command list recorded as described for CommandOp. Register
+// writes to consecutive addresses are merged into a single array write.
+// On failure failed_command receives the index of the offending command.
+rsp_int rspCommandListExecute(const rsp_streamer *streamer,
+                              const uint32_t *commands,
+                              size_t length,
+                              uint32_t *failed_command);
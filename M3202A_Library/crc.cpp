@@ -0,0 +1,220 @@
+#include "stdafx.h"
+
+#include "crc.h"
+#include "pipeline.h"
+
+#include <algorithm>
+#include <vector>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#include <nmmintrin.h>
+
+// GCC and Clang only emit SSE4.2 instructions in functions that ask for them;
+// the CPU is checked before crc32cHardware is used
+#ifdef __GNUC__
+#define CRC_TARGET_SSE42 __attribute__((target("sse4.2")))
+#else
+#define CRC_TARGET_SSE42
+#endif
+
+// CRC32C polynomial, reflected
+const uint32_t CRC32C_POLYNOMIAL = 0x82F63B78;
+
+// Read-back granularity of rspStreamerChecksum
+const uint32_t CHECKSUM_CHUNK_BYTES = 1024 * 1024;
+
+// slicing-by-8 tables for CPUs without SSE4.2
+struct crc_tables
+{
+	uint32_t table[8][256];
+
+	crc_tables()
+	{
+		for (uint32_t i = 0; i < 256; i++)
+		{
+			uint32_t crc = i;
+			for (int bit = 0; bit < 8; bit++)
+			{
+				crc = (crc >> 1) ^ (CRC32C_POLYNOMIAL & (0 - (crc & 1)));
+			}
+			table[0][i] = crc;
+		}
+		for (uint32_t i = 0; i < 256; i++)
+		{
+			for (int slice = 1; slice < 8; slice++)
+			{
+				uint32_t previous = table[slice - 1][i];
+				table[slice][i] = (previous >> 8) ^ table[0][previous & 0xFF];
+			}
+		}
+	}
+};
+
+static bool hasSse42()
+{
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 1);
+	return (info[2] & (1 << 20)) != 0;
+#else
+	unsigned int eax, ebx, ecx, edx;
+	return __get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx & (1 << 20)) != 0;
+#endif
+}
+
+static uint32_t crc32cSoftware(uint32_t crc, const uint8_t *p, size_t length)
+{
+	static const crc_tables tables;
+	const uint32_t (*t)[256] = tables.table;
+
+	while (length >= 8)
+	{
+		uint32_t low = crc ^ (p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24));
+		crc = t[7][low & 0xFF] ^ t[6][(low >> 8) & 0xFF] ^ t[5][(low >> 16) & 0xFF] ^ t[4][low >> 24]
+			^ t[3][p[4]] ^ t[2][p[5]] ^ t[1][p[6]] ^ t[0][p[7]];
+		p += 8;
+		length -= 8;
+	}
+	while (length-- > 0)
+	{
+		crc = (crc >> 8) ^ t[0][(crc ^ *p++) & 0xFF];
+	}
+	return crc;
+}
+
+CRC_TARGET_SSE42 static uint32_t crc32cHardware(uint32_t crc, const uint8_t *p, size_t length)
+{
+	while (length > 0 && (reinterpret_cast<uintptr_t>(p) & 7) != 0)
+	{
+		crc = _mm_crc32_u8(crc, *p++);
+		length--;
+	}
+#if defined(_M_X64) || defined(__x86_64__)
+	uint64_t crc64 = crc;
+	for (; length >= 8; p += 8, length -= 8)
+	{
+		crc64 = _mm_crc32_u64(crc64, *reinterpret_cast<const uint64_t*>(p));
+	}
+	crc = static_cast<uint32_t>(crc64);
+#endif
+	for (; length >= 4; p += 4, length -= 4)
+	{
+		crc = _mm_crc32_u32(crc, *reinterpret_cast<const uint32_t*>(p));
+	}
+	while (length-- > 0)
+	{
+		crc = _mm_crc32_u8(crc, *p++);
+	}
+	return crc;
+}
+
+uint32_t rspCrc32c(uint32_t crc, const void *data, size_t length)
+{
+	static const bool hardware = hasSse42();
+
+	const uint8_t *p = static_cast<const uint8_t*>(data);
+	crc = ~crc;
+	crc = hardware ? crc32cHardware(crc, p, length) : crc32cSoftware(crc, p, length);
+	return ~crc;
+}
+
+rsp_int rspStreamerWriteHostCrc(const rsp_streamer *streamer,
+                                uint32_t address,
+                                uint32_t *data,
+                                uint32_t length,
+                                uint32_t *crc)
+{
+	if (!streamer || !data) return RSP_INVALID_VALUE;
+
+	uint32_t checksum = 0;
+	uint32_t idx = 0;
+	while (length > 0)
+	{
+		uint32_t page_length = std::min(length, streamer->page_size - address % streamer->page_size);
+
+		checksum = rspCrc32c(checksum, data + idx, page_length);
+
+		rsp_int returnCode = rspStreamerWriteHost(streamer, address, data + idx, page_length);
+		if (returnCode != RSP_SUCCESS) return returnCode;
+
+		address += page_length;
+		idx += page_length / 4;
+		length -= page_length;
+	}
+
+	if (crc) *crc = checksum;
+	return RSP_SUCCESS;
+}
+
+rsp_int rspStreamerReadHostCrc(const rsp_streamer *streamer,
+                               uint32_t address,
+                               uint32_t *data,
+                               uint32_t length,
+                               uint32_t *crc)
+{
+	if (!streamer || !data) return RSP_INVALID_VALUE;
+
+	uint32_t checksum = 0;
+	uint32_t idx = 0;
+	while (length > 0)
+	{
+		uint32_t page_length = std::min(length, streamer->page_size - address % streamer->page_size);
+
+		rsp_int returnCode = rspStreamerReadHost(streamer, address, data + idx, page_length);
+		if (returnCode != RSP_SUCCESS) return returnCode;
+
+		checksum = rspCrc32c(checksum, data + idx, page_length);
+
+		address += page_length;
+		idx += page_length / 4;
+		length -= page_length;
+	}
+
+	if (crc) *crc = checksum;
+	return RSP_SUCCESS;
+}
+
+rsp_int rspStreamerChecksum(const rsp_streamer *streamer,
+                            uint32_t address,
+                            uint32_t length,
+                            uint32_t *crc)
+{
+	if (!streamer || !crc) return RSP_INVALID_VALUE;
+
+	std::vector<uint32_t> buffers[2];
+	buffers[0].resize(CHECKSUM_CHUNK_BYTES / 4);
+	buffers[1].resize(CHECKSUM_CHUNK_BYTES / 4);
+
+	// only touched by the hashing job once the first chunk is in
+	uint32_t checksum = 0;
+	rsp_pipeline hashing;
+	int current = 0;
+
+	while (length > 0)
+	{
+		uint32_t part = std::min(length, CHECKSUM_CHUNK_BYTES);
+
+		// reading chunk k overlaps with hashing chunk k-1 from the other buffer
+		rsp_int returnCode = rspStreamerReadHost(streamer, address, buffers[current].data(), part);
+		if (returnCode != RSP_SUCCESS) return returnCode;
+
+		rspPipelineWait(&hashing);
+		const uint32_t *chunk = buffers[current].data();
+		rspPipelineSubmit(&hashing, [&checksum, chunk, part] {
+			checksum = rspCrc32c(checksum, chunk, part);
+			return RSP_SUCCESS;
+		});
+
+		address += part;
+		length -= part;
+		current ^= 1;
+	}
+
+	rspPipelineWait(&hashing);
+	*crc = checksum;
+	return RSP_SUCCESS;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "M3202A_Library.h"
+
+// CRC32C (Castagnoli) of length bytes, continuing from crc. Start a new
+// checksum with crc = 0; chunks can be chained by passing the previous result.
+// Uses the SSE4.2 CRC32 instruction when the CPU has it.
+uint32_t rspCrc32c(uint32_t crc, const void *data, size_t length);
+
+// rspStreamerWriteHost / rspStreamerReadHost that also return the CRC32C of
+// the transferred data, computed page by page while it is still in cache
+rsp_int rspStreamerWriteHostCrc(const rsp_streamer *streamer,
+                                uint32_t address,
+                                uint32_t *data,
+                                uint32_t length,
+                                uint32_t *crc);
+
+rsp_int rspStreamerReadHostCrc(const rsp_streamer *streamer,
+                               uint32_t address,
+                               uint32_t *data,
+                               uint32_t length,
+                               uint32_t *crc);
+
+// CRC32C of a DDR region. Reads it back in chunks through two staging
+// buffers, hashing one while the next is being read.
+rsp_int rspStreamerChecksum(const rsp_streamer *streamer,
+                            uint32_t address,
+                            uint32_t length,
+                            uint32_t *crc);
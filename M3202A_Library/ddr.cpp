@@ -1,26 +1,93 @@
 #include "stdafx.h"
 
 #include "ddr.h"
+#include "dma_status.h"
+#include "mirror.h"
 
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <string>
 
-// MemoryMapped to Stream DMA Control Register
-const uint64_t MM2S_DMACR = 0x00;
-// MemoryMapped to Stream DMA Status Register
-const uint64_t MM2S_DMASR = 0x04;
-// MemoryMapped to Stream Source Address
-const uint64_t MM2S_SA = 0x18;
-// MemoryMapped to Stream Length (bytes)
-const uint64_t MM2S_LENGTH = 0x28;
-
-// Stream to MemoryMapped DMA Control Register
-const uint64_t S2MM_DMACR = 0x30;
-// Stream to MemoryMapped DMA Status Register
-const uint64_t S2MM_DMASR = 0x34;
-// Stream to MemoryMapped Destination Address
-const uint64_t S2MM_DA = 0x48;
-// Stream to MemoryMapped Length (bytes)
-const uint64_t S2MM_LENGTH = 0x58;
+typedef std::chrono::steady_clock Clock;
+
+// What the threads using one kernel instance share
+struct rsp_streamer_shared
+{
+	std::mutex pager;
+	rsp_streamer_counters counters;
+};
+
+static rsp_streamer_shared &sharedState(rsp_kernel_instance kernel_inst)
+{
+	static std::mutex registryLock;
+	static std::map<rsp_kernel_instance, std::unique_ptr<rsp_streamer_shared>> states;
+
+	std::lock_guard<std::mutex> guard(registryLock);
+	std::unique_ptr<rsp_streamer_shared> &state = states[kernel_inst];
+	if (!state) state.reset(new rsp_streamer_shared());
+	return *state;
+}
+
+// The state resolved by rspSetupStreamer; looked up for a streamer set up
+// by hand
+static rsp_streamer_shared &sharedState(const rsp_streamer *streamer)
+{
+	return streamer->shared ? *streamer->shared : sharedState(streamer->kernel_inst);
+}
+
+// The host window of a kernel instance is shared by every thread using it,
+// so selecting a page and accessing it must not interleave with another thread
+std::mutex &rspStreamerPagerLock(rsp_kernel_instance kernel_inst)
+{
+	return sharedState(kernel_inst).pager;
+}
+
+rsp_streamer_counters &rspStreamerCounters(rsp_kernel_instance kernel_inst)
+{
+	return sharedState(kernel_inst).counters;
+}
+
+// Set while this thread holds a pager lock. Read by the mirror fault handler,
+// so on Linux it must not be allocated lazily on first access.
+#if defined(__GNUC__) && !defined(_WIN32)
+static thread_local bool pagerHeld __attribute__((tls_model("initial-exec"))) = false;
+#else
+static thread_local bool pagerHeld = false;
+#endif
+
+bool rspStreamerPagerHeld()
+{
+	return pagerHeld;
+}
+
+// Locks the pager and records it for rspStreamerPagerHeld
+struct pager_guard
+{
+	std::mutex &pager;
+
+	explicit pager_guard(std::mutex &pager) : pager(pager)
+	{
+		pager.lock();
+		pagerHeld = true;
+	}
+
+	~pager_guard()
+	{
+		pagerHeld = false;
+		pager.unlock();
+	}
+
+	pager_guard(const pager_guard&) = delete;
+	pager_guard &operator=(const pager_guard&) = delete;
+};
+
+static void addBusy(rsp_streamer_counters &counters, RSP_STREAMER_DMA DMA_option, Clock::time_point since)
+{
+	const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - since).count();
+	counters.dma_busy_ns[DMA_option].fetch_add(static_cast<uint64_t>(ns), std::memory_order_relaxed);
+}
 
 // helper function to reduce boilerplate
 uint64_t get_DMA_from_option(const rsp_streamer *streamer, RSP_STREAMER_DMA DMA_option)
@@ -92,6 +159,24 @@ unsigned int Minimum(unsigned int a, unsigned int b) {
     return !(b<a) ? a : b;
 }
 
+// Waits for the chunk just issued on the DMA. A DMA fault (internal, slave or
+// decode error) is reported through faulted so the caller can reset and
+// retry the chunk. A DMA that never goes idle is reset before
+// LIBRARY_TIMEOUT is returned, so the next transfer starts from a clean
+// state; any other failure is a register access and is returned.
+static rsp_int waitChunk(const rsp_streamer *streamer, RSP_STREAMER_DMA DMA_option, uint32_t channels, bool *faulted)
+{
+	DmaStatus status = DmaStatus();
+	rsp_int returnCode = rspDMAWaitIdle(streamer->kernel_inst, get_DMA_from_option(streamer, DMA_option),
+        channels, &status);
+
+	// a stale error on a channel the chunk does not use is not its fault
+	*faulted = returnCode != RSP_SUCCESS &&
+        (((channels & DMA_MM2S) && status.mm2s.error) || ((channels & DMA_S2MM) && status.s2mm.error));
+	if (returnCode == LIBRARY_TIMEOUT && !*faulted) rspStreamerResetDMA(streamer, DMA_option);
+	return *faulted ? RSP_SUCCESS : returnCode;
+}
+
 
 rsp_streamer rspSetupStreamer(rsp_kernel_instance kernel_inst,
                               const char *pc_mem_1,
@@ -208,6 +293,8 @@ rsp_streamer rspSetupStreamer(rsp_kernel_instance kernel_inst,
 		streamer.axi_host = static_cast<uint64_t>(-1);
 	}
 
+	streamer.shared = &sharedState(kernel_inst);
+
 	if (error) *error = RSP_SUCCESS;
 	return streamer;
 }
@@ -300,16 +387,12 @@ rsp_int rspStreamerDMAIsIdle(const rsp_streamer *streamer,
 		return RSP_INVALID_ENUM;
 	}
 
-	uint32_t buffer;
-	rsp_int returnCode;
-
-	auto DMASR = (io == RSP_STREAMER_WRITE ? S2MM_DMASR : MM2S_DMASR);
-
-	returnCode = rspKernelInstanceRegisterRead(streamer->kernel_inst, &buffer, DMA + DMASR);
+	DmaChannelStatus channel;
+	rsp_int returnCode = rspDMAReadChannel(streamer->kernel_inst, DMA,
+        io == RSP_STREAMER_WRITE ? DMA_S2MM : DMA_MM2S, &channel);
 	if (returnCode != RSP_SUCCESS) return returnCode;
 
-	// counts as idle if the DMA is either "idle" or "halted"
-	*idle = (buffer & 0x3) != 0;
+	*idle = rspDMAChannelDone(channel);
 
 	return RSP_SUCCESS;
 }
@@ -329,16 +412,12 @@ rsp_int rspStreamerDMAHasError(const rsp_streamer *streamer,
 		return RSP_INVALID_ENUM;
 	}
 
-	uint32_t buffer;
-	rsp_int returnCode;
-
-	auto DMASR = (io == RSP_STREAMER_WRITE ? S2MM_DMASR : MM2S_DMASR);
-
-	returnCode = rspKernelInstanceRegisterRead(streamer->kernel_inst, &buffer, DMA + DMASR);
+	DmaChannelStatus channel;
+	rsp_int returnCode = rspDMAReadChannel(streamer->kernel_inst, DMA,
+        io == RSP_STREAMER_WRITE ? DMA_S2MM : DMA_MM2S, &channel);
 	if (returnCode != RSP_SUCCESS) return returnCode;
 
-	// covers DMAIntErr, DMASlvErr, DMADecErr
-	*error = (buffer & 0x70) != 0;
+	*error = channel.error;
 
 	return RSP_SUCCESS;
 }
@@ -357,20 +436,9 @@ rsp_int rspStreamerWait(const rsp_streamer *streamer,
 		return RSP_INVALID_ENUM;
 	}
 
-	rsp_int returnCode;
-
 	// check the resource isn't being used elsewhere
-	while (true)
-	{
-		bool idle;
-		returnCode = rspStreamerDMAIsIdle(streamer, DMA_option, RSP_STREAMER_READ, &idle);
-		if (returnCode != RSP_SUCCESS) return returnCode;
-
-		if (idle) break;
-	}
-
-
-	return RSP_SUCCESS;
+	return rspDMAWaitIdle(streamer->kernel_inst, DMA,
+        io == RSP_STREAMER_WRITE ? DMA_S2MM : DMA_MM2S, nullptr);
 }
 
 rsp_int rspStreamerWriteDMA(const rsp_streamer *streamer,
@@ -388,35 +456,54 @@ rsp_int rspStreamerWriteDMA(const rsp_streamer *streamer,
 	if (!streamer) return RSP_INVALID_VALUE;
 
 	rsp_int returnCode;
-
+	rsp_streamer_counters &counters = sharedState(streamer).counters;
 
 	int offset = 0;
 	while (length > 0)
 	{
         unsigned int lengthInPage = Minimum(length, static_cast<unsigned int>(streamer->max_dma_length));
 
-		returnCode = rspStreamerResetDMA(streamer, DMA_option);
-		if (returnCode != RSP_SUCCESS) return returnCode;
+		for (unsigned int attempt = 1;; attempt++)
+		{
+			returnCode = rspStreamerResetDMA(streamer, DMA_option);
+			if (returnCode != RSP_SUCCESS) return returnCode;
 
-		returnCode = rspStreamerConfigureDMA(streamer, DMA_option, address,
-            lengthInPage, RSP_STREAMER_WRITE);
-		if (returnCode != RSP_SUCCESS) return returnCode;
+			const Clock::time_point issued = Clock::now();
+			returnCode = rspStreamerConfigureDMA(streamer, DMA_option, address,
+                lengthInPage, RSP_STREAMER_WRITE);
+			if (returnCode != RSP_SUCCESS) return returnCode;
 
 
-		// Write test values
-		int i = 0;
-		for (unsigned int remaining = lengthInPage; remaining > 0;)
-		{
-            unsigned int LengthInSubPage = Minimum(remaining, static_cast<unsigned int>(pc_mem_size));
+			// Write test values
+			int i = 0;
+			for (unsigned int remaining = lengthInPage; remaining > 0;)
+			{
+                unsigned int LengthInSubPage = Minimum(remaining, static_cast<unsigned int>(pc_mem_size));
+
+				returnCode = rspKernelInstanceArrayWrite(streamer->kernel_inst, &data[i + offset],
+                    pc_mem, LengthInSubPage);
+				if (returnCode != RSP_SUCCESS) return returnCode;
+
+				i += LengthInSubPage / 4;
+				remaining -= LengthInSubPage;
+			}
 
-			returnCode = rspKernelInstanceArrayWrite(streamer->kernel_inst, &data[i + offset],
-                pc_mem, LengthInSubPage);
+			bool faulted;
+			returnCode = waitChunk(streamer, DMA_option, DMA_S2MM, &faulted);
+			addBusy(counters, DMA_option, issued);
 			if (returnCode != RSP_SUCCESS) return returnCode;
 
-			i += LengthInSubPage / 4;
-			remaining -= LengthInSubPage;
+			if (!faulted || attempt == DMA_MAX_ATTEMPTS)
+			{
+				rspDMARecordChunk(attempt, faulted);
+				if (!faulted) break;
+
+				rspStreamerResetDMA(streamer, DMA_option);
+				return LIBRARY_DMA_FAULT;
+			}
 		}
 
+		counters.bytes_to_ddr.fetch_add(lengthInPage, std::memory_order_relaxed);
 		length -= lengthInPage;
 		address += lengthInPage;
 		offset += lengthInPage / 4;
@@ -440,34 +527,53 @@ rsp_int rspStreamerReadDMA(const rsp_streamer *streamer,
 	if (!streamer) return RSP_INVALID_VALUE;
 
 	rsp_int returnCode;
-
+	rsp_streamer_counters &counters = sharedState(streamer).counters;
 
 	int offset = 0;
 	while (length > 0)
 	{
         unsigned int lengthInPage = Minimum(length, static_cast<unsigned int>(streamer->max_dma_length));
 
-		returnCode = rspStreamerResetDMA(streamer, DMA_option);
-		if (returnCode != RSP_SUCCESS) return returnCode;
+		for (unsigned int attempt = 1;; attempt++)
+		{
+			returnCode = rspStreamerResetDMA(streamer, DMA_option);
+			if (returnCode != RSP_SUCCESS) return returnCode;
 
-		returnCode = rspStreamerConfigureDMA(streamer, DMA_option, address,
-            lengthInPage, RSP_STREAMER_READ);
-		if (returnCode != RSP_SUCCESS) return returnCode;
+			const Clock::time_point issued = Clock::now();
+			returnCode = rspStreamerConfigureDMA(streamer, DMA_option, address,
+                lengthInPage, RSP_STREAMER_READ);
+			if (returnCode != RSP_SUCCESS) return returnCode;
 
-		// Write test values
-		int i = 0;
-		for (unsigned int remaining = lengthInPage; remaining > 0;)
-		{
-            unsigned int LengthInSubPage = Minimum(remaining, static_cast<unsigned int>(pc_mem_size));
+			// Write test values
+			int i = 0;
+			for (unsigned int remaining = lengthInPage; remaining > 0;)
+			{
+                unsigned int LengthInSubPage = Minimum(remaining, static_cast<unsigned int>(pc_mem_size));
+
+				returnCode = rspKernelInstanceArrayRead(streamer->kernel_inst, &data[i + offset],
+                    pc_mem, LengthInSubPage);
+				if (returnCode != RSP_SUCCESS) return returnCode;
+
+				i += LengthInSubPage / 4;
+				remaining -= LengthInSubPage;
+			}
 
-			returnCode = rspKernelInstanceArrayRead(streamer->kernel_inst, &data[i + offset],
-                pc_mem, LengthInSubPage);
+			bool faulted;
+			returnCode = waitChunk(streamer, DMA_option, DMA_MM2S, &faulted);
+			addBusy(counters, DMA_option, issued);
 			if (returnCode != RSP_SUCCESS) return returnCode;
 
-			i += LengthInSubPage / 4;
-			remaining -= LengthInSubPage;
+			if (!faulted || attempt == DMA_MAX_ATTEMPTS)
+			{
+				rspDMARecordChunk(attempt, faulted);
+				if (!faulted) break;
+
+				rspStreamerResetDMA(streamer, DMA_option);
+				return LIBRARY_DMA_FAULT;
+			}
 		}
 
+		counters.bytes_from_ddr.fetch_add(lengthInPage, std::memory_order_relaxed);
 		length -= lengthInPage;
 		address += lengthInPage;
 		offset += lengthInPage / 4;
@@ -487,27 +593,49 @@ rsp_int rspStreamerCopyDMA(const rsp_streamer *streamer,
 	if (!streamer) return RSP_INVALID_VALUE;
 
 	rsp_int returnCode;
+	bool faulted;
+	rsp_streamer_counters &counters = sharedState(streamer).counters;
 
+	// check the resource isn't being used elsewhere. A fault left behind by a
+	// previous transfer is cleared by the reset below.
+	returnCode = waitChunk(streamer, DMA_option, DMA_BOTH, &faulted);
+	if (returnCode != RSP_SUCCESS) return returnCode;
 
 	while (length > 0)
 	{
-		// the streamer will need to wait for the previous page to finish or it will get clobbered
-		rspStreamerWait(streamer, DMA_option, RSP_STREAMER_READ);
-		rspStreamerWait(streamer, DMA_option, RSP_STREAMER_WRITE);
-
         int lengthInPage = Minimum(length, static_cast<unsigned int>(streamer->max_dma_length));
 
-		returnCode = rspStreamerResetDMA(streamer, DMA_option);
-		if (returnCode != RSP_SUCCESS) return returnCode;
+		// only the failed page is repeated, the pages before it are already in place
+		for (unsigned int attempt = 1;; attempt++)
+		{
+			returnCode = rspStreamerResetDMA(streamer, DMA_option);
+			if (returnCode != RSP_SUCCESS) return returnCode;
 
-		returnCode = rspStreamerConfigureDMA(streamer, DMA_option, startAddress,
-            lengthInPage, RSP_STREAMER_READ);
-		if (returnCode != RSP_SUCCESS) return returnCode;
+			const Clock::time_point issued = Clock::now();
+			returnCode = rspStreamerConfigureDMA(streamer, DMA_option, startAddress,
+                lengthInPage, RSP_STREAMER_READ);
+			if (returnCode != RSP_SUCCESS) return returnCode;
 
-		returnCode = rspStreamerConfigureDMA(streamer, DMA_option, endAddress,
-            lengthInPage, RSP_STREAMER_WRITE);
-		if (returnCode != RSP_SUCCESS) return returnCode;
+			returnCode = rspStreamerConfigureDMA(streamer, DMA_option, endAddress,
+                lengthInPage, RSP_STREAMER_WRITE);
+			if (returnCode != RSP_SUCCESS) return returnCode;
+
+			// the streamer will need to wait for the page to finish or the next one will clobber it
+			returnCode = waitChunk(streamer, DMA_option, DMA_BOTH, &faulted);
+			addBusy(counters, DMA_option, issued);
+			if (returnCode != RSP_SUCCESS) return returnCode;
+
+			if (!faulted || attempt == DMA_MAX_ATTEMPTS)
+			{
+				rspDMARecordChunk(attempt, faulted);
+				if (!faulted) break;
 
+				rspStreamerResetDMA(streamer, DMA_option);
+				return LIBRARY_DMA_FAULT;
+			}
+		}
+
+		counters.bytes_copied.fetch_add(lengthInPage, std::memory_order_relaxed);
 		length -= lengthInPage;
 		startAddress += lengthInPage;
 		endAddress += lengthInPage;
@@ -527,9 +655,13 @@ rsp_int rspStreamerWriteHost(const rsp_streamer *streamer,
 	{
 		return RSP_INVALID_VALUE;
 	}
+	// a fault on a DdrMap view would be fetched under the pager lock held below
+	if (rspMirrorOverlaps(data, length)) return RSP_INVALID_VALUE;
 
 	const uint32_t max_page_length = streamer->page_size;
 
+	rsp_streamer_shared &shared = sharedState(streamer);
+
 	uint32_t page_number = address / max_page_length;
 	uint32_t page_offset = address % max_page_length;
 	int idx = 0;
@@ -538,13 +670,19 @@ rsp_int rspStreamerWriteHost(const rsp_streamer *streamer,
 		uint32_t page_length = max_page_length - page_offset;
 		if (page_length > length) page_length = length;
 
-		auto returnCode = rspKernelInstanceRegisterWrite(streamer->kernel_inst,
-            page_number, streamer->pager);
-		if (returnCode != RSP_SUCCESS) return returnCode;
+		{
+			pager_guard guard(shared.pager);
 
-		returnCode = rspKernelInstanceArrayWrite(streamer->kernel_inst, data + idx,
-            page_offset + streamer->axi_host, page_length);
-		if (returnCode != RSP_SUCCESS) return returnCode;
+			auto returnCode = rspKernelInstanceRegisterWrite(streamer->kernel_inst,
+                page_number, streamer->pager);
+			if (returnCode != RSP_SUCCESS) return returnCode;
+			shared.counters.pager_switches.fetch_add(1, std::memory_order_relaxed);
+
+			returnCode = rspKernelInstanceArrayWrite(streamer->kernel_inst, data + idx,
+                page_offset + streamer->axi_host, page_length);
+			if (returnCode != RSP_SUCCESS) return returnCode;
+		}
+		shared.counters.bytes_to_ddr.fetch_add(page_length, std::memory_order_relaxed);
 
 		page_number++;
 		page_offset = 0;
@@ -565,9 +703,13 @@ rsp_int rspStreamerReadHost(const rsp_streamer *streamer,
 	{
 		return RSP_INVALID_VALUE;
 	}
+	// a fault on a DdrMap view would be fetched under the pager lock held below
+	if (rspMirrorOverlaps(data, length)) return RSP_INVALID_VALUE;
 
 	const uint32_t max_page_length = streamer->page_size;
 
+	rsp_streamer_shared &shared = sharedState(streamer);
+
 	uint32_t page_number = address / max_page_length;
 	uint32_t page_offset = address % max_page_length;
 	int idx = 0;
@@ -576,13 +718,19 @@ rsp_int rspStreamerReadHost(const rsp_streamer *streamer,
 		uint32_t page_length = max_page_length - page_offset;
 		if (page_length > length) page_length = length;
 
-		auto returnCode = rspKernelInstanceRegisterWrite(streamer->kernel_inst,
-            page_number, streamer->pager);
-		if (returnCode != RSP_SUCCESS) return returnCode;
+		{
+			pager_guard guard(shared.pager);
 
-		returnCode = rspKernelInstanceArrayRead(streamer->kernel_inst, data + idx,
-            page_offset + streamer->axi_host, page_length);
-		if (returnCode != RSP_SUCCESS) return returnCode;
+			auto returnCode = rspKernelInstanceRegisterWrite(streamer->kernel_inst,
+                page_number, streamer->pager);
+			if (returnCode != RSP_SUCCESS) return returnCode;
+			shared.counters.pager_switches.fetch_add(1, std::memory_order_relaxed);
+
+			returnCode = rspKernelInstanceArrayRead(streamer->kernel_inst, data + idx,
+                page_offset + streamer->axi_host, page_length);
+			if (returnCode != RSP_SUCCESS) return returnCode;
+		}
+		shared.counters.bytes_from_ddr.fetch_add(page_length, std::memory_order_relaxed);
 
 		page_number++;
 		page_offset = 0;
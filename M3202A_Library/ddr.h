@@ -0,0 +1,122 @@
+#pragma once
+
+// DDR access through the Streamer32 block: two AXI DMA engines, optional PC
+// memory ports and a paged host window into DDR. Implemented in ddr.cpp.
+
+#include <stdint.h>
+
+#include <atomic>
+#include <mutex>
+
+enum RSP_STREAMER_DMA
+{
+	RSP_STREAMER_DMA_1,
+	RSP_STREAMER_DMA_2
+};
+
+enum RSP_STREAMER_IO
+{
+	RSP_STREAMER_READ,
+	RSP_STREAMER_WRITE
+};
+
+struct rsp_streamer_shared;
+
+typedef struct rsp_streamer
+{
+	rsp_kernel_instance kernel_inst;
+
+	// register bases of the two DMA engines and the host window page register
+	uint64_t DMA_1;
+	uint64_t DMA_2;
+	uint64_t pager;
+	uint64_t max_dma_length;
+
+	// PC memory ports, ~0 if not set up
+	uint64_t pc_mem_1;
+	uint64_t pc_mem_2;
+	rsp_ulong pc_mem_1_size;
+	rsp_ulong pc_mem_2_size;
+
+	uint32_t bit_width;
+
+	// host window, ~0 if not set up
+	uint32_t page_size;
+	uint64_t axi_host;
+
+	// pager lock and counters of kernel_inst, resolved by rspSetupStreamer
+	rsp_streamer_shared *shared;
+} rsp_streamer;
+
+// Running totals of a kernel instance since it was first used, sampled by
+// the telemetry thread. Updated with relaxed atomics only.
+struct rsp_streamer_counters
+{
+	std::atomic<uint64_t> bytes_to_ddr{ 0 };
+	std::atomic<uint64_t> bytes_from_ddr{ 0 };
+	std::atomic<uint64_t> bytes_copied{ 0 };
+	std::atomic<uint64_t> pager_switches{ 0 };
+	std::atomic<uint64_t> dma_busy_ns[2] = {};  // per RSP_STREAMER_DMA, configure to idle
+	std::atomic<uint32_t> queue_depth{ 0 };     // scheduler requests and transfers not finished
+};
+
+// Held while a thread has the host window paged to its address. Taken by
+// rspStreamerWriteHost / rspStreamerReadHost for every page.
+std::mutex &rspStreamerPagerLock(rsp_kernel_instance kernel_inst);
+
+// Whether the calling thread is inside rspStreamerWriteHost /
+// rspStreamerReadHost with a pager lock taken. Safe to call from a signal
+// handler.
+bool rspStreamerPagerHeld();
+
+// Lives as long as the process, so the reference may be kept
+rsp_streamer_counters &rspStreamerCounters(rsp_kernel_instance kernel_inst);
+
+rsp_streamer rspSetupStreamer(rsp_kernel_instance kernel_inst,
+                              const char *pc_mem_1,
+                              const char *pc_mem_2,
+                              const char *axi_control,
+                              const char *axi_host,
+                              rsp_int *error);
+
+rsp_int rspStreamerResetDMA(const rsp_streamer *streamer, RSP_STREAMER_DMA DMA_option);
+
+rsp_int rspStreamerConfigureDMA(const rsp_streamer *streamer,
+                                RSP_STREAMER_DMA DMA_option,
+                                uint32_t address,
+                                uint32_t length,
+                                RSP_STREAMER_IO io);
+
+rsp_int rspStreamerDMAIsIdle(const rsp_streamer *streamer, RSP_STREAMER_DMA DMA_option, RSP_STREAMER_IO io, bool *idle);
+
+rsp_int rspStreamerDMAHasError(const rsp_streamer *streamer, RSP_STREAMER_DMA DMA_option, RSP_STREAMER_IO io, bool *error);
+
+rsp_int rspStreamerWait(const rsp_streamer *streamer, RSP_STREAMER_DMA DMA_option, RSP_STREAMER_IO io);
+
+rsp_int rspStreamerWriteDMA(const rsp_streamer *streamer,
+                            RSP_STREAMER_DMA DMA_option,
+                            uint32_t address,
+                            uint32_t *data,
+                            uint32_t length);
+
+rsp_int rspStreamerReadDMA(const rsp_streamer *streamer,
+                           RSP_STREAMER_DMA DMA_option,
+                           uint32_t address,
+                           uint32_t *data,
+                           uint32_t length);
+
+rsp_int rspStreamerCopyDMA(const rsp_streamer *streamer,
+                           RSP_STREAMER_DMA DMA_option,
+                           uint32_t startAddress,
+                           uint32_t endAddress,
+                           uint32_t length);
+
+rsp_int rspStreamerWriteHost(const rsp_streamer *streamer,
+                             uint32_t address,
+                             uint32_t *data,
+                             uint32_t length);
+
+rsp_int rspStreamerReadHost(const rsp_streamer *streamer,
+                            uint32_t address,
+                            uint32_t *data,
+                            uint32_t length);
@@ -0,0 +1,148 @@
+#include "stdafx.h"
+
+#include "dma_status.h"
+
+#include <atomic>
+#include <chrono>
+
+// words from MM2S_DMASR up to and including S2MM_DMASR
+const size_t STATUS_WORDS = (S2MM_DMASR - MM2S_DMASR) / 4 + 1;
+
+// shared by every transfer path, updated once per chunk
+static std::atomic<uint64_t> chunkCount(0);
+static std::atomic<uint64_t> faultCount(0);
+static std::atomic<uint64_t> retryCount(0);
+static std::atomic<uint64_t> failureCount(0);
+
+static std::atomic<uint32_t> waitTimeout(DMA_WAIT_TIMEOUT_MS);
+
+static void decodeChannel(uint32_t buffer, DmaChannelStatus *channel)
+{
+	channel->raw = buffer;
+	channel->halted = (buffer & 0x1) != 0;
+	channel->idle = (buffer & 0x2) != 0;
+	// covers DMAIntErr, DMASlvErr, DMADecErr
+	channel->error = (buffer & 0x70) != 0;
+	channel->ioc = (buffer & 0x1000) != 0;
+}
+
+// words points at MM2S_DMASR of one DMA engine
+static void decodeStatus(const uint32_t *words, DmaStatus *status)
+{
+	decodeChannel(words[0], &status->mm2s);
+	decodeChannel(words[(S2MM_DMASR - MM2S_DMASR) / 4], &status->s2mm);
+}
+
+bool rspDMAChannelDone(const DmaChannelStatus &channel)
+{
+	// counts as idle if the DMA is either "idle" or "halted"
+	return channel.idle || channel.halted;
+}
+
+rsp_int rspDMAReadStatus(rsp_kernel_instance kernel_inst, uint64_t DMA, DmaStatus *status)
+{
+	if (!status) return RSP_INVALID_VALUE;
+
+	uint32_t buffer[STATUS_WORDS];
+	rsp_int returnCode = rspKernelInstanceArrayRead(kernel_inst, buffer, DMA + MM2S_DMASR,
+        sizeof(buffer));
+	if (returnCode != RSP_SUCCESS) return returnCode;
+
+	decodeStatus(buffer, status);
+	return RSP_SUCCESS;
+}
+
+rsp_int rspDMAReadChannel(rsp_kernel_instance kernel_inst, uint64_t DMA, uint32_t channel, DmaChannelStatus *status)
+{
+	if (!status) return RSP_INVALID_VALUE;
+	if (channel != DMA_MM2S && channel != DMA_S2MM) return RSP_INVALID_ENUM;
+
+	uint32_t buffer;
+	rsp_int returnCode = rspKernelInstanceRegisterRead(kernel_inst, &buffer,
+        DMA + (channel == DMA_S2MM ? S2MM_DMASR : MM2S_DMASR));
+	if (returnCode != RSP_SUCCESS) return returnCode;
+
+	decodeChannel(buffer, status);
+	return RSP_SUCCESS;
+}
+
+rsp_int rspDMAWaitIdle(rsp_kernel_instance kernel_inst, uint64_t DMA, uint32_t channels, DmaStatus *status)
+{
+	if ((channels & DMA_BOTH) == 0 || (channels & ~DMA_BOTH) != 0) return RSP_INVALID_ENUM;
+
+	const uint32_t timeout = waitTimeout;
+	const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout);
+
+	DmaStatus snapshot;
+	while (true)
+	{
+		rsp_int returnCode = rspDMAReadStatus(kernel_inst, DMA, &snapshot);
+		if (returnCode != RSP_SUCCESS) return returnCode;
+
+		bool error = ((channels & DMA_MM2S) && snapshot.mm2s.error)
+			|| ((channels & DMA_S2MM) && snapshot.s2mm.error);
+		bool done = (!(channels & DMA_MM2S) || rspDMAChannelDone(snapshot.mm2s))
+			&& (!(channels & DMA_S2MM) || rspDMAChannelDone(snapshot.s2mm));
+
+		if (error || done)
+		{
+			if (status) *status = snapshot;
+			return error ? RSP_INVALID_VALUE : RSP_SUCCESS;
+		}
+
+		if (timeout != 0 && std::chrono::steady_clock::now() >= deadline)
+		{
+			if (status) *status = snapshot;
+			return LIBRARY_TIMEOUT;
+		}
+	}
+}
+
+void rspDMASetWaitTimeout(uint32_t milliseconds)
+{
+	waitTimeout = milliseconds;
+}
+
+rsp_int rspStreamerReadStatus(const rsp_streamer *streamer, RSP_STREAMER_DMA DMA_option, DmaStatus *status)
+{
+	if (!streamer) return RSP_INVALID_VALUE;
+	if (DMA_option != RSP_STREAMER_DMA_1 && DMA_option != RSP_STREAMER_DMA_2) return RSP_INVALID_ENUM;
+
+	return rspDMAReadStatus(streamer->kernel_inst,
+        DMA_option == RSP_STREAMER_DMA_1 ? streamer->DMA_1 : streamer->DMA_2, status);
+}
+
+rsp_int rspStreamerReadStatusAll(const rsp_streamer *streamer, DmaStatus status[2])
+{
+	if (!streamer || !status) return RSP_INVALID_VALUE;
+
+	rsp_int returnCode = rspStreamerReadStatus(streamer, RSP_STREAMER_DMA_1, &status[0]);
+	if (returnCode != RSP_SUCCESS) return returnCode;
+	return rspStreamerReadStatus(streamer, RSP_STREAMER_DMA_2, &status[1]);
+}
+
+void rspDMARecordChunk(unsigned int attempts, bool failed)
+{
+	chunkCount++;
+	if (attempts > 1) retryCount += attempts - 1;
+	faultCount += failed ? attempts : attempts - 1;
+	if (failed) failureCount++;
+}
+
+void rspDMAGetErrorCounters(DmaErrorCounters *counters)
+{
+	if (!counters) return;
+
+	counters->chunks = chunkCount;
+	counters->faults = faultCount;
+	counters->retries = retryCount;
+	counters->failures = failureCount;
+}
+
+void rspDMAResetErrorCounters()
+{
+	chunkCount = 0;
+	faultCount = 0;
+	retryCount = 0;
+	failureCount = 0;
+}
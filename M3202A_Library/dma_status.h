@@ -0,0 +1,64 @@
+#pragma once
+
+#include "M3202A_Library.h"
+
+// MemoryMapped to Stream DMA Control Register
+const uint64_t MM2S_DMACR = 0x00;
+// MemoryMapped to Stream DMA Status Register
+const uint64_t MM2S_DMASR = 0x04;
+// MemoryMapped to Stream Source Address, lower and upper 32 bits
+const uint64_t MM2S_SA = 0x18;
+const uint64_t MM2S_SA_MSB = 0x1C;
+// MemoryMapped to Stream Length (bytes)
+const uint64_t MM2S_LENGTH = 0x28;
+
+// Stream to MemoryMapped DMA Control Register
+const uint64_t S2MM_DMACR = 0x30;
+// Stream to MemoryMapped DMA Status Register
+const uint64_t S2MM_DMASR = 0x34;
+// Stream to MemoryMapped Destination Address, lower and upper 32 bits
+const uint64_t S2MM_DA = 0x48;
+const uint64_t S2MM_DA_MSB = 0x4C;
+// Stream to MemoryMapped Length (bytes)
+const uint64_t S2MM_LENGTH = 0x58;
+
+// Distance between the register blocks of DMA_1 and DMA_2
+const uint64_t DMA_REGISTER_SPAN = 1024;
+
+// Times a DMA chunk is issued before LIBRARY_DMA_FAULT is returned to the caller
+const unsigned int DMA_MAX_ATTEMPTS = 3;
+
+// Default of rspDMASetWaitTimeout, far longer than any single chunk takes
+const uint32_t DMA_WAIT_TIMEOUT_MS = 10000;
+
+// Reads MM2S_DMASR and S2MM_DMASR of the DMA at the given register base with
+// a single array read and decodes both.
+rsp_int rspDMAReadStatus(rsp_kernel_instance kernel_inst, uint64_t DMA, DmaStatus *status);
+
+// Reads and decodes the status register of one channel (DMA_MM2S or DMA_S2MM)
+rsp_int rspDMAReadChannel(rsp_kernel_instance kernel_inst, uint64_t DMA, uint32_t channel, DmaChannelStatus *status);
+
+// Whether a channel counts as finished: idle or halted
+bool rspDMAChannelDone(const DmaChannelStatus &channel);
+
+// Polls with rspDMAReadStatus until every channel in channels (DmaChannel
+// bits) is idle or halted. Stops early with RSP_INVALID_VALUE if one of them
+// reports an error, or with LIBRARY_TIMEOUT once the wait timeout passes; the
+// last snapshot is returned in status if given.
+rsp_int rspDMAWaitIdle(rsp_kernel_instance kernel_inst, uint64_t DMA, uint32_t channels, DmaStatus *status);
+
+// Limit on a single rspDMAWaitIdle, shared by every caller; 0 waits forever
+void rspDMASetWaitTimeout(uint32_t milliseconds);
+
+rsp_int rspStreamerReadStatus(const rsp_streamer *streamer, RSP_STREAMER_DMA DMA_option, DmaStatus *status);
+
+// Both DMA engines, one rspDMAReadStatus each
+rsp_int rspStreamerReadStatusAll(const rsp_streamer *streamer, DmaStatus status[2]);
+
+// Accounts for one chunk that needed the given number of attempts; failed
+// means the last attempt faulted as well and the transfer was abandoned.
+void rspDMARecordChunk(unsigned int attempts, bool failed);
+
+void rspDMAGetErrorCounters(DmaErrorCounters *counters);
+
+void rspDMAResetErrorCounters();
@@ -0,0 +1,270 @@
+#include "stdafx.h"
+
+#include "envelope.h"
+#include "pipeline.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <vector>
+
+#include <emmintrin.h>
+
+typedef std::chrono::steady_clock Clock;
+
+// The int32 lanes of a sum grow by at most 2 * 32768 per step, so they are
+// folded into 64 bits at least this often
+const size_t ENVELOPE_SUM_STEPS = 16384;
+
+static double secondsSince(Clock::time_point start)
+{
+	return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+static int64_t foldSum(__m128i sum)
+{
+	int32_t lanes[4];
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), sum);
+	return static_cast<int64_t>(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+}
+
+// Sum of count samples
+static int64_t sumSamples(const int16_t *samples, size_t count)
+{
+	const __m128i ones = _mm_set1_epi16(1);
+	int64_t total = 0;
+	size_t i = 0;
+	while (count - i >= 8)
+	{
+		const size_t end = i + std::min((count - i) / 8, ENVELOPE_SUM_STEPS) * 8;
+		__m128i sum = _mm_setzero_si128();
+		for (; i < end; i += 8)
+		{
+			__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(samples + i));
+			sum = _mm_add_epi32(sum, _mm_madd_epi16(v, ones));
+		}
+		total += foldSum(sum);
+	}
+	for (; i < count; i++) total += samples[i];
+	return total;
+}
+
+static void accumulateStatistics(rsp_envelope *envelope, const int16_t *samples, size_t count)
+{
+	const __m128i ones = _mm_set1_epi16(1);
+	const __m128i zero = _mm_setzero_si128();
+	__m128i low = _mm_set1_epi16(INT16_MAX);
+	__m128i high = _mm_set1_epi16(INT16_MIN);
+	__m128i squares = _mm_setzero_si128();
+
+	size_t i = 0;
+	while (count - i >= 8)
+	{
+		const size_t end = i + std::min((count - i) / 8, ENVELOPE_SUM_STEPS) * 8;
+		__m128i sum = _mm_setzero_si128();
+		for (; i < end; i += 8)
+		{
+			__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(samples + i));
+			low = _mm_min_epi16(low, v);
+			high = _mm_max_epi16(high, v);
+			sum = _mm_add_epi32(sum, _mm_madd_epi16(v, ones));
+
+			// a pair of squares reaches 2^31, which only fits unsigned
+			__m128i square = _mm_madd_epi16(v, v);
+			squares = _mm_add_epi64(squares, _mm_unpacklo_epi32(square, zero));
+			squares = _mm_add_epi64(squares, _mm_unpackhi_epi32(square, zero));
+		}
+		envelope->sum += foldSum(sum);
+	}
+
+	int16_t lows[8];
+	int16_t highs[8];
+	uint64_t square_lanes[2];
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(lows), low);
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(highs), high);
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(square_lanes), squares);
+
+	int32_t min = envelope->min;
+	int32_t max = envelope->max;
+	for (int lane = 0; lane < 8; lane++)
+	{
+		min = std::min<int32_t>(min, lows[lane]);
+		max = std::max<int32_t>(max, highs[lane]);
+	}
+	envelope->sum_squares += square_lanes[0] + square_lanes[1];
+
+	for (; i < count; i++)
+	{
+		const int32_t sample = samples[i];
+		min = std::min(min, sample);
+		max = std::max(max, sample);
+		envelope->sum += sample;
+		envelope->sum_squares += static_cast<uint64_t>(sample * sample);
+	}
+
+	envelope->min = min;
+	envelope->max = max;
+	envelope->samples += count;
+}
+
+// Averages of decimation consecutive samples; a group may span chunks
+static void accumulateDecimated(rsp_envelope *envelope, const int16_t *samples, size_t count)
+{
+	const uint32_t decimation = envelope->config.decimation;
+	const double factor = envelope->config.scale / decimation;
+
+	while (count > 0)
+	{
+		const size_t part = std::min<size_t>(count, decimation - envelope->group_count);
+		envelope->group_sum += sumSamples(samples, part);
+		envelope->group_count += static_cast<uint32_t>(part);
+		samples += part;
+		count -= part;
+
+		if (envelope->group_count == decimation)
+		{
+			*envelope->out++ = envelope->group_sum * factor;
+			envelope->output_samples++;
+			envelope->group_sum = 0;
+			envelope->group_count = 0;
+		}
+	}
+}
+
+static void accumulateHistogram(rsp_envelope *envelope, const int16_t *samples, size_t count)
+{
+	const uint64_t bins = envelope->config.histogramBins;
+	uint64_t *histogram = envelope->histogram;
+	for (size_t i = 0; i < count; i++)
+	{
+		histogram[((samples[i] + 32768) * bins) >> 16]++;
+	}
+}
+
+void rspEnvelopeUnpack(const uint32_t *data, size_t length, double scale, double *out)
+{
+	const __m128d factor = _mm_set1_pd(scale);
+
+	size_t i = 0;
+	for (; i + 4 <= length; i += 4, out += 8)
+	{
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+
+		// sign extends the eight samples to int32, low half of each word first
+		__m128i first = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+		__m128i second = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+
+		_mm_storeu_pd(out + 0, _mm_mul_pd(_mm_cvtepi32_pd(first), factor));
+		_mm_storeu_pd(out + 2, _mm_mul_pd(_mm_cvtepi32_pd(_mm_srli_si128(first, 8)), factor));
+		_mm_storeu_pd(out + 4, _mm_mul_pd(_mm_cvtepi32_pd(second), factor));
+		_mm_storeu_pd(out + 6, _mm_mul_pd(_mm_cvtepi32_pd(_mm_srli_si128(second, 8)), factor));
+	}
+	for (; i < length; i++, out += 2)
+	{
+		out[0] = static_cast<int16_t>(data[i] & 0xFFFF) * scale;
+		out[1] = static_cast<int16_t>(data[i] >> 16) * scale;
+	}
+}
+
+void rspEnvelopeAccumulate(rsp_envelope *envelope, const uint32_t *data, size_t length)
+{
+	const int16_t *samples = reinterpret_cast<const int16_t*>(data);
+	const size_t count = length * 2;
+
+	accumulateStatistics(envelope, samples, count);
+
+	if (envelope->out)
+	{
+		if (envelope->config.decimation > 1)
+		{
+			accumulateDecimated(envelope, samples, count);
+		}
+		else
+		{
+			rspEnvelopeUnpack(data, length, envelope->config.scale, envelope->out);
+			envelope->out += count;
+			envelope->output_samples += count;
+		}
+	}
+
+	if (envelope->histogram && envelope->config.histogramBins > 0)
+	{
+		accumulateHistogram(envelope, samples, count);
+	}
+}
+
+rsp_int rspEnvelopeProcess(const rsp_streamer *streamer,
+                           uint32_t address,
+                           uint32_t length,
+                           const EnvelopeConfig *config,
+                           double *out,
+                           uint64_t *histogram,
+                           EnvelopeStats *stats)
+{
+	if (!streamer || !config || length % 4 != 0 || address % 4 != 0) return RSP_INVALID_VALUE;
+	if (static_cast<uint64_t>(address) + length > 0x100000000ULL) return RSP_INVALID_VALUE;
+	if (config->histogramBins > 65536) return RSP_INVALID_VALUE;
+
+	rsp_envelope envelope;
+	envelope.config = *config;
+	envelope.out = out;
+	envelope.histogram = histogram;
+	if (histogram) std::fill(histogram, histogram + config->histogramBins, 0);
+
+	std::vector<uint32_t> buffers[2];
+	buffers[0].resize(ENVELOPE_CHUNK_BYTES / 4);
+	buffers[1].resize(ENVELOPE_CHUNK_BYTES / 4);
+
+	rsp_pipeline processing;
+	double readSeconds = 0;
+	double processSeconds = 0;
+	int current = 0;
+
+	while (length > 0)
+	{
+		uint32_t part = std::min(length, ENVELOPE_CHUNK_BYTES);
+
+		Clock::time_point start = Clock::now();
+		rsp_int returnCode = rspStreamerReadHost(streamer, address, buffers[current].data(), part);
+		readSeconds += secondsSince(start);
+		if (returnCode != RSP_SUCCESS) return returnCode;
+
+		// only the part of the kernels not hidden behind the read is counted
+		start = Clock::now();
+		rspPipelineWait(&processing);
+		processSeconds += secondsSince(start);
+
+		const uint32_t *chunk = buffers[current].data();
+		rspPipelineSubmit(&processing, [&envelope, chunk, part] {
+			rspEnvelopeAccumulate(&envelope, chunk, part / 4);
+			return RSP_SUCCESS;
+		});
+
+		address += part;
+		length -= part;
+		current ^= 1;
+	}
+
+	Clock::time_point start = Clock::now();
+	rspPipelineWait(&processing);
+	processSeconds += secondsSince(start);
+
+	if (stats)
+	{
+		*stats = EnvelopeStats();
+		stats->samples = envelope.samples;
+		stats->outputSamples = envelope.output_samples;
+		stats->readSeconds = readSeconds;
+		stats->processSeconds = processSeconds;
+		if (envelope.samples > 0)
+		{
+			const double scale = config->scale;
+			const double n = static_cast<double>(envelope.samples);
+			stats->min = std::min(envelope.min * scale, envelope.max * scale);
+			stats->max = std::max(envelope.min * scale, envelope.max * scale);
+			stats->mean = envelope.sum / n * scale;
+			stats->rms = std::sqrt(envelope.sum_squares / n) * std::fabs(scale);
+		}
+	}
+	return RSP_SUCCESS;
+}
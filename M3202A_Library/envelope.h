@@ -0,0 +1,43 @@
+#pragma once
+
+#include "M3202A_Library.h"
+
+// Read-back granularity of rspEnvelopeProcess
+const uint32_t ENVELOPE_CHUNK_BYTES = 1024 * 1024;
+
+// Running state of rspEnvelopeProcess, carried from one chunk to the next
+struct rsp_envelope
+{
+	EnvelopeConfig config = EnvelopeConfig();
+	double *out = nullptr;       // next output value
+	uint64_t *histogram = nullptr;
+
+	int64_t sum = 0;
+	uint64_t sum_squares = 0;
+	int32_t min = INT16_MAX;
+	int32_t max = INT16_MIN;
+	uint64_t samples = 0;
+	uint64_t output_samples = 0;
+
+	int64_t group_sum = 0;       // samples of the decimation group still open
+	uint32_t group_count = 0;
+};
+
+// Splits length words into 2 * length int16 samples and scales them to out
+void rspEnvelopeUnpack(const uint32_t *data, size_t length, double scale, double *out);
+
+// Runs statistics, decimation and histogram over the next length words of
+// an envelope stream
+void rspEnvelopeAccumulate(rsp_envelope *envelope, const uint32_t *data, size_t length);
+
+// Streams length bytes of DDR through the envelope kernels, processing each
+// chunk while the next one is being read. out receives samples / decimation
+// values and may be null, histogram holds config->histogramBins counters and
+// may be null as well.
+rsp_int rspEnvelopeProcess(const rsp_streamer *streamer,
+                           uint32_t address,
+                           uint32_t length,
+                           const EnvelopeConfig *config,
+                           double *out,
+                           uint64_t *histogram,
+                           EnvelopeStats *stats);
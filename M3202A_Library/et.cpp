@@ -0,0 +1,172 @@
+#include "stdafx.h"
+
+#include "dma_status.h"
+#include "et.h"
+
+#include <chrono>
+
+typedef std::chrono::steady_clock Clock;
+
+static double secondsSince(Clock::time_point start)
+{
+	return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Same sequence as ConfigS2MM / ConfigMM2S in Program.cs. Writing the length
+// register starts the transfer, so S2MM has to be armed before MM2S.
+static rsp_int etConfigureChannel(rsp_kernel_instance kernel_inst,
+                                  uint64_t DMACR,
+                                  uint64_t ADDRESS,
+                                  uint64_t ADDRESS_MSB,
+                                  uint64_t LENGTH,
+                                  uint64_t address,
+                                  uint32_t bytes)
+{
+	rsp_int returnCode = rspKernelInstanceRegisterWrite(kernel_inst, 0x1, DMACR);
+	if (returnCode != RSP_SUCCESS) return returnCode;
+
+	returnCode = rspKernelInstanceRegisterWrite(kernel_inst,
+        static_cast<uint32_t>(address >> 32), ADDRESS_MSB);
+	if (returnCode != RSP_SUCCESS) return returnCode;
+
+	returnCode = rspKernelInstanceRegisterWrite(kernel_inst,
+        static_cast<uint32_t>(address & 0xFFFFFFFF), ADDRESS);
+	if (returnCode != RSP_SUCCESS) return returnCode;
+
+	return rspKernelInstanceRegisterWrite(kernel_inst, bytes, LENGTH);
+}
+
+static rsp_int etStartBlock(rsp_kernel_instance kernel_inst,
+                            const EtConfig *config,
+                            uint64_t paInAddr,
+                            uint64_t envOutAddr)
+{
+	const uint64_t DMA = config->dmaRegBase;
+	const uint32_t outSamples = config->samplesPerBlock * config->osr;
+
+	rsp_int returnCode = rspKernelInstanceRegisterWrite(kernel_inst, 1, config->etRegBase + ET_CLR);
+	if (returnCode != RSP_SUCCESS) return returnCode;
+
+	// envOut each sample 2 bytes
+	returnCode = etConfigureChannel(kernel_inst, DMA + S2MM_DMACR, DMA + S2MM_DA, DMA + S2MM_DA_MSB,
+        DMA + S2MM_LENGTH, envOutAddr, outSamples * 2);
+	if (returnCode != RSP_SUCCESS) return returnCode;
+
+	// paIn each sample 4 bytes
+	return etConfigureChannel(kernel_inst, DMA + MM2S_DMACR, DMA + MM2S_SA, DMA + MM2S_SA_MSB,
+        DMA + MM2S_LENGTH, paInAddr, config->samplesPerBlock * 4);
+}
+
+// The block is done once the envelope has landed in DDR, i.e. S2MM is idle again
+static rsp_int etWaitBlock(rsp_kernel_instance kernel_inst, const EtConfig *config)
+{
+	return rspDMAWaitIdle(kernel_inst, config->dmaRegBase, DMA_S2MM, nullptr);
+}
+
+rsp_int rspEtRun(const rsp_streamer *streamer,
+                 const EtConfig *config,
+                 const uint32_t *iqIn,
+                 uint32_t *envOut,
+                 size_t numBlocks,
+                 EtStats *stats)
+{
+	if (!streamer || !config || !iqIn || !envOut) return RSP_INVALID_VALUE;
+	if (config->samplesPerBlock == 0 || config->osr == 0) return RSP_INVALID_VALUE;
+
+	// both block sizes go into 32-bit DMA length registers
+	const uint64_t inBytes = static_cast<uint64_t>(config->samplesPerBlock) * 4;
+	const uint64_t outBytes = static_cast<uint64_t>(config->samplesPerBlock) * config->osr * 2;
+	if (inBytes > 0xFFFFFFFF || outBytes > 0xFFFFFFFF) return RSP_INVALID_VALUE;
+
+	// the host window takes 32-bit DDR addresses
+	for (size_t region = 0; region < 2; region++)
+	{
+		if (config->paInAddr[region] > 0x100000000ULL - inBytes) return RSP_INVALID_VALUE;
+		if (config->envOutAddr[region] > 0x100000000ULL - outBytes) return RSP_INVALID_VALUE;
+	}
+
+	// two 16-bit envelope samples are packed per 32-bit word
+	const uint32_t inWords = config->samplesPerBlock;
+	const uint32_t outSamples = config->samplesPerBlock * config->osr;
+	if (outSamples % 2 != 0) return RSP_INVALID_VALUE;
+	const uint32_t outWords = outSamples / 2;
+
+	rsp_kernel_instance kernel_inst = streamer->kernel_inst;
+	rsp_int returnCode;
+
+	EtStats result = EtStats();
+	Clock::time_point start = Clock::now();
+
+	// the rate and block sizes are the same for every block
+	returnCode = rspKernelInstanceRegisterWrite(kernel_inst, 0x80000000 / config->osr,
+        config->etRegBase + ET_RESAMPLER_RATE);
+	if (returnCode != RSP_SUCCESS) return returnCode;
+
+	returnCode = rspKernelInstanceRegisterWrite(kernel_inst, inWords, config->etRegBase + ET_IN_SAMPLES);
+	if (returnCode != RSP_SUCCESS) return returnCode;
+
+	returnCode = rspKernelInstanceRegisterWrite(kernel_inst, outSamples, config->etRegBase + ET_OUT_SAMPLES);
+	if (returnCode != RSP_SUCCESS) return returnCode;
+
+	if (numBlocks > 0)
+	{
+		Clock::time_point t = Clock::now();
+		returnCode = rspStreamerWriteHost(streamer, static_cast<uint32_t>(config->paInAddr[0]),
+            const_cast<uint32_t*>(iqIn), inWords * 4);
+		if (returnCode != RSP_SUCCESS) return returnCode;
+		result.uploadSeconds += secondsSince(t);
+	}
+
+	for (size_t n = 0; n < numBlocks; n++)
+	{
+		const size_t current = n % 2;
+		const size_t other = 1 - current;
+
+		returnCode = etStartBlock(kernel_inst, config, config->paInAddr[current], config->envOutAddr[current]);
+		if (returnCode != RSP_SUCCESS) return returnCode;
+
+		// host work overlapped with the FPGA processing block n
+		Clock::time_point t = Clock::now();
+		if (n + 1 < numBlocks)
+		{
+			returnCode = rspStreamerWriteHost(streamer, static_cast<uint32_t>(config->paInAddr[other]),
+                const_cast<uint32_t*>(iqIn + (n + 1) * inWords), inWords * 4);
+			if (returnCode != RSP_SUCCESS) return returnCode;
+		}
+		result.uploadSeconds += secondsSince(t);
+
+		t = Clock::now();
+		if (n >= 1)
+		{
+			returnCode = rspStreamerReadHost(streamer, static_cast<uint32_t>(config->envOutAddr[other]),
+                envOut + (n - 1) * outWords, outWords * 4);
+			if (returnCode != RSP_SUCCESS) return returnCode;
+		}
+		result.readbackSeconds += secondsSince(t);
+
+		t = Clock::now();
+		returnCode = etWaitBlock(kernel_inst, config);
+		if (returnCode != RSP_SUCCESS) return returnCode;
+		result.waitSeconds += secondsSince(t);
+
+		result.blocks++;
+	}
+
+	if (numBlocks > 0)
+	{
+		Clock::time_point t = Clock::now();
+		const size_t last = numBlocks - 1;
+		returnCode = rspStreamerReadHost(streamer, static_cast<uint32_t>(config->envOutAddr[last % 2]),
+            envOut + last * outWords, outWords * 4);
+		if (returnCode != RSP_SUCCESS) return returnCode;
+		result.readbackSeconds += secondsSince(t);
+	}
+
+	result.inputSamples = static_cast<uint64_t>(numBlocks) * inWords;
+	result.outputSamples = static_cast<uint64_t>(numBlocks) * outSamples;
+	result.seconds = secondsSince(start);
+	if (result.seconds > 0) result.samplesPerSecond = result.inputSamples / result.seconds;
+
+	if (stats) *stats = result;
+	return RSP_SUCCESS;
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "M3202A_Library.h"
+
+// Envelope tracker register map, relative to EtConfig::etRegBase
+const uint64_t ET_CLR = 0x00;
+const uint64_t ET_RESAMPLER_RATE = 0x04;
+const uint64_t ET_IN_SAMPLES = 0x10;
+const uint64_t ET_OUT_SAMPLES = 0x14;
+const uint64_t ET_SHAPING_TABLE = 0x400;
+const size_t ET_SHAPING_TABLE_LENGTH = 256;
+
+// Runs numBlocks waveform blocks through the envelope tracker. While the FPGA
+// processes block N from one ping-pong region, block N+1 is uploaded into the
+// other region and the envelope of block N-1 is read back from it.
+rsp_int rspEtRun(const rsp_streamer *streamer,
+                 const EtConfig *config,
+                 const uint32_t *iqIn,
+                 uint32_t *envOut,
+                 size_t numBlocks,
+                 EtStats *stats);
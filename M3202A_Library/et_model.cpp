@@ -0,0 +1,113 @@
+#include "stdafx.h"
+
+#include "et.h"
+#include "et_model.h"
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+#include <vector>
+
+#include <emmintrin.h>
+
+// Outputs taken through the three stages at a time, small enough to stay in L1
+const size_t ET_MODEL_BLOCK = 256;
+
+static int32_t sampleI(uint32_t word)
+{
+	return static_cast<int16_t>(word & 0xFFFF);
+}
+
+static int32_t sampleQ(uint32_t word)
+{
+	return static_cast<int16_t>(word >> 16);
+}
+
+static void interpolate(const rsp_et_model *model, size_t first, size_t count, int32_t *i, int32_t *q)
+{
+	const uint64_t last = model->in_samples - 1;
+	uint64_t position = static_cast<uint64_t>(first) * model->rate;
+
+	for (size_t n = 0; n < count; n++, position += model->rate)
+	{
+		const uint64_t index = position >> 31;
+		const int64_t fraction = static_cast<int64_t>(position & 0x7FFFFFFF);
+		const uint32_t w0 = model->iq[std::min(index, last)];
+		const uint32_t w1 = model->iq[std::min(index + 1, last)];
+
+		const int32_t i0 = sampleI(w0);
+		const int32_t q0 = sampleQ(w0);
+		i[n] = i0 + static_cast<int32_t>(((sampleI(w1) - i0) * fraction) >> 31);
+		q[n] = q0 + static_cast<int32_t>(((sampleQ(w1) - q0) * fraction) >> 31);
+	}
+}
+
+// I^2 + Q^2 < 2^32, so the correctly rounded double square root truncates to
+// the exact integer square root
+static void magnitude(const int32_t *i, const int32_t *q, size_t count, uint32_t *mag)
+{
+	size_t n = 0;
+	for (; n + 2 <= count; n += 2)
+	{
+		__m128d vi = _mm_cvtepi32_pd(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(i + n)));
+		__m128d vq = _mm_cvtepi32_pd(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(q + n)));
+		__m128d root = _mm_sqrt_pd(_mm_add_pd(_mm_mul_pd(vi, vi), _mm_mul_pd(vq, vq)));
+		_mm_storel_epi64(reinterpret_cast<__m128i*>(mag + n), _mm_cvttpd_epi32(root));
+	}
+	for (; n < count; n++)
+	{
+		const double power = static_cast<double>(i[n]) * i[n] + static_cast<double>(q[n]) * q[n];
+		mag[n] = static_cast<uint32_t>(std::sqrt(power));
+	}
+}
+
+static void shape(const uint32_t *table, const uint32_t *mag, size_t count, uint16_t *out)
+{
+	for (size_t n = 0; n < count; n++)
+	{
+		const uint32_t entry = table[std::min<uint32_t>(mag[n] >> 8, ET_SHAPING_TABLE_LENGTH - 1)];
+		const uint32_t value = (entry & 0xFFFF) + (((entry >> 16) * (mag[n] & 0xFF)) >> 8);
+		out[n] = static_cast<uint16_t>(std::min<uint32_t>(value, 0xFFFF));
+	}
+}
+
+void rspEtModelProcess(const rsp_et_model *model, uint16_t *out, size_t first, size_t count)
+{
+	int32_t i[ET_MODEL_BLOCK];
+	int32_t q[ET_MODEL_BLOCK];
+	uint32_t mag[ET_MODEL_BLOCK];
+
+	while (count > 0)
+	{
+		const size_t part = std::min(count, ET_MODEL_BLOCK);
+		interpolate(model, first, part, i, q);
+		magnitude(i, q, part, mag);
+		shape(model->table, mag, part, out);
+
+		out += part;
+		first += part;
+		count -= part;
+	}
+}
+
+rsp_int rspEtModelRun(const rsp_et_model *model, uint16_t *out, size_t outSamples)
+{
+	if (!model || !model->table || !model->iq || model->in_samples == 0 || !out) return RSP_INVALID_VALUE;
+
+	const size_t cores = std::max(1u, std::thread::hardware_concurrency());
+	const size_t threads = std::max<size_t>(1, std::min(cores, outSamples / ET_MODEL_MIN_SAMPLES_PER_THREAD));
+	const size_t share = (outSamples + threads - 1) / threads;
+
+	// every output only depends on its own position, so the ranges are independent
+	std::vector<std::thread> workers;
+	for (size_t t = 1; t < threads; t++)
+	{
+		const size_t first = t * share;
+		if (first >= outSamples) break;
+		workers.emplace_back(rspEtModelProcess, model, out + first, first, std::min(share, outSamples - first));
+	}
+	rspEtModelProcess(model, out, 0, std::min(share, outSamples));
+
+	for (std::thread &worker : workers) worker.join();
+	return RSP_SUCCESS;
+}
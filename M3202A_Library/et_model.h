@@ -0,0 +1,31 @@
+#pragma once
+
+#include "M3202A_Library.h"
+
+// Position of an output sample in input samples is n * rate / 2^31, i.e.
+// ET_RESAMPLER_RATE = 0x80000000 / osr
+const uint32_t ET_MODEL_RATE_ONE = 0x80000000;
+
+// Outputs below this are not worth a thread of their own
+const size_t ET_MODEL_MIN_SAMPLES_PER_THREAD = 64 * 1024;
+
+// Envelope tracker as programmed through its registers
+struct rsp_et_model
+{
+	uint32_t rate = 0;                 // ET_RESAMPLER_RATE
+	const uint32_t *table = nullptr;   // ET_SHAPING_TABLE_LENGTH entries
+	const uint32_t *iq = nullptr;      // packed I (low half) / Q samples
+	size_t in_samples = 0;
+};
+
+// Bit-exact reference of the envelope tracker for outputs [first, first + count):
+//   1. linear interpolation of I and Q at position n * rate / 2^31, the
+//      fraction kept to 31 bits and the product rounded down; positions past
+//      the last input hold it
+//   2. magnitude floor(sqrt(I^2 + Q^2))
+//   3. shaping: entry = table[mag >> 8], out = (entry & 0xFFFF) +
+//      ((entry >> 16) * (mag & 0xFF) >> 8), saturated to 16 bits
+void rspEtModelProcess(const rsp_et_model *model, uint16_t *out, size_t first, size_t count);
+
+// rspEtModelProcess over outSamples outputs, split across the cores
+rsp_int rspEtModelRun(const rsp_et_model *model, uint16_t *out, size_t outSamples);
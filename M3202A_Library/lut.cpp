@@ -0,0 +1,151 @@
+#include "stdafx.h"
+
+#include "lut.h"
+
+#include <algorithm>
+
+static bool isDoubleBuffered(const rsp_lut *lut)
+{
+	return lut->bank_address[1] != LUT_NO_ADDRESS && lut->select_register != LUT_NO_ADDRESS;
+}
+
+// bank rspLutLoad writes into
+static int loadBank(const rsp_lut *lut)
+{
+	return isDoubleBuffered(lut) ? 1 - lut->active : lut->active;
+}
+
+rsp_lut *rspLutCreate(rsp_kernel_instance kernel_inst,
+                      uint64_t bank0_address,
+                      uint64_t bank1_address,
+                      uint64_t select_register,
+                      uint32_t length,
+                      rsp_int *error)
+{
+	if (!kernel_inst)
+	{
+		if (error) *error = RSP_INVALID_KERNEL_INSTANCE;
+		return nullptr;
+	}
+
+	if (length == 0 || bank0_address == LUT_NO_ADDRESS)
+	{
+		if (error) *error = RSP_INVALID_VALUE;
+		return nullptr;
+	}
+
+	rsp_lut *lut = new rsp_lut();
+	lut->kernel_inst = kernel_inst;
+	lut->bank_address[0] = bank0_address;
+	lut->bank_address[1] = bank1_address;
+	lut->select_register = select_register;
+	lut->length = length;
+	lut->shadow[0].resize(length);
+	lut->shadow[1].resize(length);
+	lut->valid[0] = false;
+	lut->valid[1] = false;
+
+	// start from a known bank so the shadows line up with the hardware
+	if (isDoubleBuffered(lut))
+	{
+		rsp_int returnCode = rspKernelInstanceRegisterWrite(kernel_inst, 0, select_register);
+		if (returnCode != RSP_SUCCESS)
+		{
+			delete lut;
+			if (error) *error = returnCode;
+			return nullptr;
+		}
+	}
+
+	if (error) *error = RSP_SUCCESS;
+	return lut;
+}
+
+rsp_int rspLutLoad(rsp_lut *lut, const uint32_t *table, uint32_t *entries_written)
+{
+	if (!lut || !table) return RSP_INVALID_VALUE;
+
+	const int bank = loadBank(lut);
+	std::vector<uint32_t> &shadow = lut->shadow[bank];
+	uint32_t written = 0;
+
+	uint32_t i = 0;
+	while (i < lut->length)
+	{
+		if (lut->valid[bank] && shadow[i] == table[i])
+		{
+			i++;
+			continue;
+		}
+
+		// extend the run while the next change is within LUT_MERGE_GAP entries
+		uint32_t end = i + 1;
+		uint32_t gap = 0;
+		for (uint32_t j = end; j < lut->length && gap < LUT_MERGE_GAP; j++)
+		{
+			if (!lut->valid[bank] || shadow[j] != table[j])
+			{
+				end = j + 1;
+				gap = 0;
+			}
+			else
+			{
+				gap++;
+			}
+		}
+
+		const uint32_t count = end - i;
+		const uint64_t address = lut->bank_address[bank] + i * 4;
+		rsp_int returnCode = count == 1
+			? rspKernelInstanceRegisterWrite(lut->kernel_inst, table[i], address)
+			: rspKernelInstanceArrayWrite(lut->kernel_inst, table + i, address, count * 4);
+		if (returnCode != RSP_SUCCESS)
+		{
+			// part of the bank may have been written
+			lut->valid[bank] = false;
+			return returnCode;
+		}
+
+		std::copy(table + i, table + end, shadow.begin() + i);
+		written += count;
+		lut->stats.writes++;
+		i = end;
+	}
+
+	lut->valid[bank] = true;
+	lut->stats.loads++;
+	lut->stats.entriesWritten += written;
+	lut->stats.entriesSkipped += lut->length - written;
+
+	if (entries_written) *entries_written = written;
+	return RSP_SUCCESS;
+}
+
+rsp_int rspLutSwap(rsp_lut *lut)
+{
+	if (!lut) return RSP_INVALID_VALUE;
+	if (!isDoubleBuffered(lut)) return RSP_SUCCESS;
+
+	const int next = 1 - lut->active;
+	if (!lut->valid[next]) return RSP_INVALID_VALUE;
+
+	rsp_int returnCode = rspKernelInstanceRegisterWrite(lut->kernel_inst, next, lut->select_register);
+	if (returnCode != RSP_SUCCESS) return returnCode;
+
+	lut->active = next;
+	lut->stats.swaps++;
+	return RSP_SUCCESS;
+}
+
+void rspLutInvalidate(rsp_lut *lut)
+{
+	if (!lut) return;
+
+	lut->valid[0] = false;
+	lut->valid[1] = false;
+}
+
+void rspLutDestroy(rsp_lut *lut)
+{
+	delete lut;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <vector>
+
+#include "M3202A_Library.h"
+
+// Marks bank1 / select register as absent for a single-bank table
+const uint64_t LUT_NO_ADDRESS = static_cast<uint64_t>(-1);
+
+// Changed entries closer together than this are written in one array write,
+// rewriting the unchanged entries in between
+const uint32_t LUT_MERGE_GAP = 8;
+
+// Host-side copy of a kernel lookup table. With two banks and a select
+// register the next table is loaded into the bank the kernel is not using and
+// activated by rspLutSwap; with one bank rspLutLoad writes the live table.
+struct rsp_lut
+{
+	rsp_kernel_instance kernel_inst = nullptr;
+	uint64_t bank_address[2];
+	uint64_t select_register = LUT_NO_ADDRESS;
+	uint32_t length = 0;
+
+	std::vector<uint32_t> shadow[2];  // what each bank holds in hardware
+	bool valid[2];                    // false until the shadow is known to match
+	int active = 0;                   // bank selected for the kernel
+
+	LutStats stats = LutStats();
+};
+
+rsp_lut *rspLutCreate(rsp_kernel_instance kernel_inst,
+                      uint64_t bank0_address,
+                      uint64_t bank1_address,
+                      uint64_t select_register,
+                      uint32_t length,
+                      rsp_int *error);
+
+// Uploads the entries of table that differ from the target bank
+rsp_int rspLutLoad(rsp_lut *lut, const uint32_t *table, uint32_t *entries_written);
+
+// Points the kernel at the bank loaded last, with a single register write
+rsp_int rspLutSwap(rsp_lut *lut);
+
+// Forgets the shadows, e.g. after the kernel was reloaded, so the next load
+// writes every entry
+void rspLutInvalidate(rsp_lut *lut);
+
+void rspLutDestroy(rsp_lut *lut);
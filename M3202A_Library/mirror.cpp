@@ -0,0 +1,470 @@
+#include "stdafx.h"
+
+#include "mirror.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <system_error>
+#include <thread>
+
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <ucontext.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+typedef DWORD mirror_protection;
+const DWORD MIRROR_NO_ACCESS = PAGE_NOACCESS;
+const DWORD MIRROR_READ_ONLY = PAGE_READONLY;
+const DWORD MIRROR_READ_WRITE = PAGE_READWRITE;
+#else
+typedef int mirror_protection;
+const int MIRROR_NO_ACCESS = PROT_NONE;
+const int MIRROR_READ_ONLY = PROT_READ;
+const int MIRROR_READ_WRITE = PROT_READ | PROT_WRITE;
+#endif
+
+// Mirrors searched by the fault handler, which is installed while any is open
+static std::mutex registryLock;
+static std::vector<rsp_mirror*> registry;
+static std::atomic<size_t> openMirrors(0);   // registry.size(), read without the lock
+#ifdef _WIN32
+static PVOID faultHandler = nullptr;
+#else
+static bool faultHandler = false;
+static struct sigaction previousAction;
+static int faultRequests[2] = { -1, -1 };   // signal handler to fault service thread
+#endif
+
+static uint32_t pageLength(const rsp_mirror *mirror, size_t page)
+{
+	return std::min(MIRROR_PAGE_BYTES, static_cast<uint32_t>(mirror->length - page * MIRROR_PAGE_BYTES));
+}
+
+static bool protect(rsp_mirror *mirror, size_t first, size_t count, mirror_protection protection)
+{
+#ifdef _WIN32
+	DWORD previous;
+	return VirtualProtect(mirror->view + first * MIRROR_PAGE_BYTES, count * MIRROR_PAGE_BYTES,
+        protection, &previous) != FALSE;
+#else
+	return mprotect(mirror->view + first * MIRROR_PAGE_BYTES, count * MIRROR_PAGE_BYTES, protection) == 0;
+#endif
+}
+
+// Brings the page in on first touch and tracks the first write to it.
+// Without writeKnown the access is taken as a read unless the page was
+// already readable, so a first write to an absent page faults twice and a
+// read that raced another thread's fetch costs an extra write-back.
+static bool mirrorFault(rsp_mirror *mirror, size_t page, bool write, bool writeKnown)
+{
+	std::lock_guard<std::mutex> guard(mirror->lock);
+
+	if (!writeKnown && mirror->state[page] == MIRROR_CLEAN) write = true;
+
+	if (mirror->state[page] == MIRROR_ABSENT)
+	{
+		uint8_t *target = mirror->backing + page * MIRROR_PAGE_BYTES;
+		uint32_t length = pageLength(mirror, page);
+		rsp_int returnCode = rspStreamerReadHost(mirror->streamer,
+            mirror->address + static_cast<uint32_t>(page * MIRROR_PAGE_BYTES),
+            reinterpret_cast<uint32_t*>(target), length);
+		if (returnCode != RSP_SUCCESS)
+		{
+			mirror->stats.fetchErrors++;
+			return false;
+		}
+
+		mirror->state[page] = MIRROR_CLEAN;
+		mirror->stats.pagesFetched++;
+		mirror->stats.bytesFetched += length;
+	}
+
+	if (write)
+	{
+		mirror->stats.writeFaults++;
+		if (!protect(mirror, page, 1, MIRROR_READ_WRITE)) return false;
+		mirror->state[page] = MIRROR_DIRTY;
+	}
+	else
+	{
+		// another thread may have brought the page in while this one waited
+		mirror->stats.readFaults++;
+		if (mirror->state[page] == MIRROR_CLEAN && !protect(mirror, page, 1, MIRROR_READ_ONLY)) return false;
+	}
+	return true;
+}
+
+enum mirror_fault
+{
+	MIRROR_FAULT_FOREIGN,        // not in a mirror view
+	MIRROR_FAULT_HANDLED,        // the page is accessible now
+	MIRROR_FAULT_FAILED,         // the fetch or the protection change failed
+	MIRROR_FAULT_REENTRANT       // raised under the pager lock, fetching would deadlock
+};
+
+// The mirror is looked up under registryLock and fetched under its own lock
+// only, so faults on different mirrors do not wait for each other.
+// reentrant is set when the faulting thread holds the pager lock.
+static mirror_fault handleFault(const uint8_t *address, bool write, bool writeKnown, bool reentrant)
+{
+	rsp_mirror *mirror = nullptr;
+	{
+		std::lock_guard<std::mutex> guard(registryLock);
+		for (rsp_mirror *candidate : registry)
+		{
+			if (address >= candidate->view && address < candidate->view + candidate->view_size)
+			{
+				mirror = candidate;
+				mirror->faulting++;
+				break;
+			}
+		}
+	}
+	if (!mirror) return MIRROR_FAULT_FOREIGN;
+
+	mirror_fault result = MIRROR_FAULT_REENTRANT;
+	if (!reentrant)
+	{
+		const size_t page = (address - mirror->view) / MIRROR_PAGE_BYTES;
+		result = mirrorFault(mirror, page, write, writeKnown) ? MIRROR_FAULT_HANDLED : MIRROR_FAULT_FAILED;
+	}
+	mirror->faulting--;
+	return result;
+}
+
+static const char REENTRANT_MESSAGE[] =
+    "M3202A_Library: a DdrMap view was touched by a DDR transfer; pass a plain buffer instead\n";
+
+#ifdef _WIN32
+static LONG CALLBACK mirrorFaultHandler(PEXCEPTION_POINTERS info)
+{
+	const EXCEPTION_RECORD *record = info->ExceptionRecord;
+	if (record->ExceptionCode != EXCEPTION_ACCESS_VIOLATION || record->NumberParameters < 2)
+	{
+		return EXCEPTION_CONTINUE_SEARCH;
+	}
+
+	// ExceptionInformation[0] is 0 for a read, 1 for a write, 8 for execute
+	const bool write = record->ExceptionInformation[0] == 1;
+	const uint8_t *address = reinterpret_cast<const uint8_t*>(record->ExceptionInformation[1]);
+
+	switch (handleFault(address, write, true, rspStreamerPagerHeld()))
+	{
+	case MIRROR_FAULT_HANDLED:
+		return EXCEPTION_CONTINUE_EXECUTION;
+	case MIRROR_FAULT_REENTRANT:
+		// let the access violation take the process down rather than hang it
+		std::fputs(REENTRANT_MESSAGE, stderr);
+		return EXCEPTION_CONTINUE_SEARCH;
+	default:
+		return EXCEPTION_CONTINUE_SEARCH;
+	}
+}
+
+static void installFaultHandler()
+{
+	faultHandler = AddVectoredExceptionHandler(1, mirrorFaultHandler);
+}
+
+static void removeFaultHandler()
+{
+	if (faultHandler) RemoveVectoredExceptionHandler(faultHandler);
+	faultHandler = nullptr;
+}
+
+static void unmap(rsp_mirror *mirror)
+{
+	if (mirror->view) UnmapViewOfFile(mirror->view);
+	if (mirror->backing) UnmapViewOfFile(mirror->backing);
+	if (mirror->section) CloseHandle(mirror->section);
+}
+#else
+// What the signal handler hands to the fault service thread. Smaller than
+// PIPE_BUF, so it is written to the request pipe in one piece.
+struct fault_request
+{
+	const uint8_t *address;
+	bool write;
+	bool writeKnown;
+	bool reentrant;
+	std::atomic<int> *result;    // on the handler's stack, FAULT_PENDING until answered
+};
+
+const int FAULT_PENDING = -1;
+static_assert(sizeof(std::atomic<int>) == sizeof(int), "a fault result must be usable as a futex word");
+
+static void answerFault(fault_request request)
+{
+	request.result->store(handleFault(request.address, request.write, request.writeKnown, request.reentrant),
+        std::memory_order_release);
+	syscall(SYS_futex, reinterpret_cast<int*>(request.result), FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+}
+
+// Locks, allocation and PCIe reads are not async-signal-safe, so the signal
+// handler only passes the fault to this thread. Each fault is answered on a
+// thread of its own, which keeps a slow fetch on one mirror from holding up
+// faults on the others.
+static void serveFaults()
+{
+	fault_request request;
+	while (true)
+	{
+		ssize_t got = read(faultRequests[0], &request, sizeof(request));
+		if (got < 0 && errno == EINTR) continue;
+		if (got != sizeof(request)) return;
+
+		try
+		{
+			std::thread(answerFault, request).detach();
+		}
+		catch (const std::system_error &)
+		{
+			answerFault(request);
+		}
+	}
+}
+
+// Hands the fault to serveFaults and sleeps on the result until it is
+// answered; write(2) and the futex call are async-signal-safe and need no
+// descriptor per fault. A fault that cannot be passed on is treated as foreign.
+static mirror_fault requestFault(fault_request &request)
+{
+	std::atomic<int> result(FAULT_PENDING);
+	request.result = &result;
+
+	ssize_t sent;
+	do sent = write(faultRequests[1], &request, sizeof(request));
+	while (sent < 0 && errno == EINTR);
+	if (sent != sizeof(request)) return MIRROR_FAULT_FOREIGN;
+
+	int answer;
+	while ((answer = result.load(std::memory_order_acquire)) == FAULT_PENDING)
+	{
+		syscall(SYS_futex, reinterpret_cast<int*>(&result), FUTEX_WAIT_PRIVATE, FAULT_PENDING, nullptr, nullptr, 0);
+	}
+	return static_cast<mirror_fault>(answer);
+}
+
+static void mirrorFaultHandler(int signal, siginfo_t *info, void *context)
+{
+	const int savedErrno = errno;
+
+	fault_request request = {};
+	request.address = static_cast<const uint8_t*>(info->si_addr);
+#ifdef M3202A_FAULT_ERROR_CODE
+	// bit 1 of the x86-64 page fault error code is set for a write
+	const ucontext_t *user = static_cast<const ucontext_t*>(context);
+	request.write = (user->uc_mcontext.gregs[REG_ERR] & 2) != 0;
+	request.writeKnown = true;
+#else
+	(void)context;
+#endif
+	request.reentrant = rspStreamerPagerHeld();
+
+	const mirror_fault result = requestFault(request);
+
+	errno = savedErrno;
+	if (result == MIRROR_FAULT_HANDLED) return;
+	if (result == MIRROR_FAULT_REENTRANT)
+	{
+		// terminate below instead of hanging; write(2) is async-signal-safe
+		ssize_t written = write(STDERR_FILENO, REENTRANT_MESSAGE, sizeof(REENTRANT_MESSAGE) - 1);
+		(void)written;
+	}
+
+	// not a mirror page: hand the fault to whoever had it before, returning
+	// with the default action restored lets it fault again and terminate
+	if (previousAction.sa_flags & SA_SIGINFO)
+	{
+		previousAction.sa_sigaction(signal, info, context);
+	}
+	else if (previousAction.sa_handler != SIG_DFL && previousAction.sa_handler != SIG_IGN)
+	{
+		previousAction.sa_handler(signal);
+	}
+	else
+	{
+		::signal(signal, SIG_DFL);
+	}
+}
+
+static void installFaultHandler()
+{
+	// the service thread outlives the handler and is reused by later mirrors
+	if (faultRequests[0] < 0)
+	{
+		if (pipe2(faultRequests, O_CLOEXEC) != 0) return;
+		std::thread(serveFaults).detach();
+	}
+
+	struct sigaction action = {};
+	action.sa_sigaction = mirrorFaultHandler;
+	action.sa_flags = SA_SIGINFO;
+	sigemptyset(&action.sa_mask);
+	faultHandler = sigaction(SIGSEGV, &action, &previousAction) == 0;
+}
+
+static void removeFaultHandler()
+{
+	if (faultHandler) sigaction(SIGSEGV, &previousAction, nullptr);
+	faultHandler = false;
+}
+
+static void unmap(rsp_mirror *mirror)
+{
+	if (mirror->view) munmap(mirror->view, mirror->view_size);
+	if (mirror->backing) munmap(mirror->backing, mirror->view_size);
+	if (mirror->section >= 0) close(mirror->section);
+}
+
+static uint8_t *mapView(int section, size_t size)
+{
+	void *view = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, section, 0);
+	return view == MAP_FAILED ? nullptr : static_cast<uint8_t*>(view);
+}
+#endif
+
+rsp_mirror *rspMirrorOpen(const rsp_streamer *streamer, uint32_t address, uint32_t length, rsp_int *error)
+{
+	if (!streamer || length == 0 || address % 4 != 0 || length % 4 != 0 ||
+        static_cast<uint64_t>(address) + length > 0x100000000ULL)
+	{
+		if (error) *error = RSP_INVALID_VALUE;
+		return nullptr;
+	}
+
+	rsp_mirror *mirror = new rsp_mirror();
+	mirror->streamer = streamer;
+	mirror->address = address;
+	mirror->length = length;
+	mirror->view_size = (static_cast<size_t>(length) + MIRROR_PAGE_BYTES - 1) / MIRROR_PAGE_BYTES * MIRROR_PAGE_BYTES;
+	mirror->state.assign(mirror->view_size / MIRROR_PAGE_BYTES, MIRROR_ABSENT);
+
+	// pagefile backed; physical memory is only used for pages that are touched
+	const uint64_t size = mirror->view_size;
+#ifdef _WIN32
+	mirror->section = CreateFileMapping(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+        static_cast<DWORD>(size >> 32), static_cast<DWORD>(size), nullptr);
+	if (mirror->section)
+	{
+		mirror->view = static_cast<uint8_t*>(MapViewOfFile(mirror->section, FILE_MAP_ALL_ACCESS, 0, 0, 0));
+		mirror->backing = static_cast<uint8_t*>(MapViewOfFile(mirror->section, FILE_MAP_ALL_ACCESS, 0, 0, 0));
+	}
+#else
+	mirror->section = memfd_create("m3202a_mirror", MFD_CLOEXEC);
+	if (mirror->section >= 0 && ftruncate(mirror->section, static_cast<off_t>(size)) == 0)
+	{
+		mirror->view = mapView(mirror->section, mirror->view_size);
+		mirror->backing = mapView(mirror->section, mirror->view_size);
+	}
+#endif
+	if (!mirror->view || !mirror->backing || !protect(mirror, 0, mirror->state.size(), MIRROR_NO_ACCESS))
+	{
+		unmap(mirror);
+		delete mirror;
+		if (error) *error = RSP_INVALID_VALUE;
+		return nullptr;
+	}
+
+	{
+		std::lock_guard<std::mutex> guard(registryLock);
+		if (registry.empty()) installFaultHandler();
+		registry.push_back(mirror);
+		openMirrors = registry.size();
+	}
+
+	if (error) *error = RSP_SUCCESS;
+	return mirror;
+}
+
+rsp_int rspMirrorSync(rsp_mirror *mirror)
+{
+	if (!mirror) return RSP_INVALID_VALUE;
+
+	std::lock_guard<std::mutex> guard(mirror->lock);
+
+	const size_t pages = mirror->state.size();
+	for (size_t first = 0; first < pages;)
+	{
+		if (mirror->state[first] != MIRROR_DIRTY)
+		{
+			first++;
+			continue;
+		}
+
+		size_t end = first + 1;
+		while (end < pages && mirror->state[end] == MIRROR_DIRTY) end++;
+
+		// write-protect first so a write racing with the transfer faults and
+		// marks the page dirty again once the sync is done
+		protect(mirror, first, end - first, MIRROR_READ_ONLY);
+
+		uint32_t offset = static_cast<uint32_t>(first * MIRROR_PAGE_BYTES);
+		uint32_t length = static_cast<uint32_t>(std::min<uint64_t>(mirror->length - offset,
+            (end - first) * static_cast<uint64_t>(MIRROR_PAGE_BYTES)));
+		rsp_int returnCode = rspStreamerWriteHost(mirror->streamer, mirror->address + offset,
+            reinterpret_cast<uint32_t*>(mirror->backing + offset), length);
+		if (returnCode != RSP_SUCCESS)
+		{
+			protect(mirror, first, end - first, MIRROR_READ_WRITE);
+			return returnCode;
+		}
+
+		std::fill(mirror->state.begin() + first, mirror->state.begin() + end, MIRROR_CLEAN);
+		mirror->stats.pagesWrittenBack += end - first;
+		mirror->stats.bytesWrittenBack += length;
+		mirror->stats.writeBacks++;
+		first = end;
+	}
+	return RSP_SUCCESS;
+}
+
+void rspMirrorInvalidate(rsp_mirror *mirror)
+{
+	if (!mirror) return;
+
+	std::lock_guard<std::mutex> guard(mirror->lock);
+	protect(mirror, 0, mirror->state.size(), MIRROR_NO_ACCESS);
+	std::fill(mirror->state.begin(), mirror->state.end(), MIRROR_ABSENT);
+}
+
+bool rspMirrorOverlaps(const void *data, size_t length)
+{
+	if (openMirrors == 0) return false;
+
+	const uint8_t *first = static_cast<const uint8_t*>(data);
+	std::lock_guard<std::mutex> guard(registryLock);
+	for (const rsp_mirror *mirror : registry)
+	{
+		if (first < mirror->view + mirror->view_size && mirror->view < first + length) return true;
+	}
+	return false;
+}
+
+rsp_int rspMirrorClose(rsp_mirror *mirror)
+{
+	if (!mirror) return RSP_INVALID_VALUE;
+
+	rsp_int returnCode = rspMirrorSync(mirror);
+
+	{
+		std::lock_guard<std::mutex> guard(registryLock);
+		registry.erase(std::remove(registry.begin(), registry.end(), mirror), registry.end());
+		openMirrors = registry.size();
+		if (registry.empty()) removeFaultHandler();
+	}
+
+	// a fault found the mirror just before it left the registry
+	while (mirror->faulting != 0) std::this_thread::yield();
+
+	unmap(mirror);
+	delete mirror;
+	return returnCode;
+}
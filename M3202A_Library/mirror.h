@@ -0,0 +1,64 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#include "M3202A_Library.h"
+
+// Granularity of fetch and write-back, a multiple of the system page and
+// allocation granularity
+const uint32_t MIRROR_PAGE_BYTES = 64 * 1024;
+
+enum MirrorPageState
+{
+	MIRROR_ABSENT,               // not fetched, view page inaccessible
+	MIRROR_CLEAN,                // fetched, view page read-only
+	MIRROR_DIRTY                 // written since the last sync, view page read-write
+};
+
+// Host mirror of a DDR region. The region is backed by a pagefile section
+// (an anonymous memfd on Linux) mapped twice: view is handed to the client and has its page protection
+// managed by the fault handler, backing stays writable so a page is filled
+// completely before it becomes accessible in view.
+struct rsp_mirror
+{
+	const rsp_streamer *streamer = nullptr;
+	uint32_t address = 0;        // DDR address of view[0]
+	uint32_t length = 0;         // bytes mirrored
+	size_t view_size = 0;        // length rounded up to MIRROR_PAGE_BYTES
+
+#ifdef _WIN32
+	HANDLE section = nullptr;
+#else
+	int section = -1;            // memfd mapped by both views
+#endif
+	uint8_t *view = nullptr;
+	uint8_t *backing = nullptr;
+
+	std::mutex lock;
+	std::atomic<int> faulting{ 0 };  // fault handlers past the registry lookup
+	std::vector<uint8_t> state;  // MirrorPageState per page
+	DdrMapStats stats = DdrMapStats();
+};
+
+// Maps length bytes of DDR at address into host memory. Nothing is read
+// until a page of the view is touched.
+rsp_mirror *rspMirrorOpen(const rsp_streamer *streamer, uint32_t address, uint32_t length, rsp_int *error);
+
+// Writes the dirty pages back to DDR, merging neighbouring pages into one
+// transfer. Pages written after the sync are tracked again.
+rsp_int rspMirrorSync(rsp_mirror *mirror);
+
+// Drops every page, including unsynced writes, so the next touch reads DDR
+// again. Use after the FPGA has changed the region.
+void rspMirrorInvalidate(rsp_mirror *mirror);
+
+// Whether [data, data + length) overlaps the view of an open mirror. Such
+// buffers are refused for DDR and register array transfers: their page
+// would be fetched from inside the transfer, which holds the locks the fetch
+// needs.
+bool rspMirrorOverlaps(const void *data, size_t length);
+
+// Syncs and unmaps. The view must not be used afterwards.
+rsp_int rspMirrorClose(rsp_mirror *mirror);
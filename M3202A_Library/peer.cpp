@@ -0,0 +1,178 @@
+#include "stdafx.h"
+
+#include "peer.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
+// A chunk buffer kept resident so the driver never waits on a page fault
+struct peer_buffer
+{
+	uint32_t *data = nullptr;
+	uint32_t address = 0;        // source address of the chunk it holds
+	uint32_t length = 0;
+	bool full = false;
+	bool locked = false;
+};
+
+static bool allocateBuffer(peer_buffer &buffer)
+{
+#ifdef _WIN32
+	buffer.data = static_cast<uint32_t*>(VirtualAlloc(nullptr, PEER_CHUNK_BYTES, MEM_COMMIT | MEM_RESERVE,
+        PAGE_READWRITE));
+	if (!buffer.data) return false;
+
+	// best effort: past the working set quota the copy still works, unlocked
+	buffer.locked = VirtualLock(buffer.data, PEER_CHUNK_BYTES) != FALSE;
+#else
+	void *data = mmap(nullptr, PEER_CHUNK_BYTES, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (data == MAP_FAILED) return false;
+	buffer.data = static_cast<uint32_t*>(data);
+
+	// best effort: past RLIMIT_MEMLOCK the copy still works, unlocked
+	buffer.locked = mlock(buffer.data, PEER_CHUNK_BYTES) == 0;
+#endif
+	return true;
+}
+
+static void releaseBuffer(peer_buffer &buffer)
+{
+	if (!buffer.data) return;
+#ifdef _WIN32
+	if (buffer.locked) VirtualUnlock(buffer.data, PEER_CHUNK_BYTES);
+	VirtualFree(buffer.data, 0, MEM_RELEASE);
+#else
+	if (buffer.locked) munlock(buffer.data, PEER_CHUNK_BYTES);
+	munmap(buffer.data, PEER_CHUNK_BYTES);
+#endif
+	buffer.data = nullptr;
+}
+
+// Bytes of the chunk starting at address. Chunks end on page boundaries of
+// the source so a chunk never switches the pager more often than needed.
+static uint32_t chunkLength(const rsp_streamer *src, uint32_t address, uint32_t remaining)
+{
+	uint32_t length = std::min(remaining, PEER_CHUNK_BYTES);
+	if (length == remaining || src->page_size >= PEER_CHUNK_BYTES) return length;
+
+	uint32_t end = address + length;
+	uint32_t aligned = end - end % src->page_size;
+	return aligned > address ? aligned - address : length;
+}
+
+static rsp_int hostBounceCopy(const rsp_streamer *src,
+                              uint32_t srcAddress,
+                              const rsp_streamer *dst,
+                              uint32_t dstAddress,
+                              uint32_t length)
+{
+	peer_buffer buffers[2];
+	if (!allocateBuffer(buffers[0]) || !allocateBuffer(buffers[1]))
+	{
+		releaseBuffer(buffers[0]);
+		releaseBuffer(buffers[1]);
+		return RSP_INVALID_VALUE;
+	}
+
+	std::mutex mutex;
+	std::condition_variable changed;
+	rsp_int readError = RSP_SUCCESS;
+	rsp_int writeError = RSP_SUCCESS;
+
+	std::thread reader([&] {
+		uint32_t address = srcAddress;
+		uint32_t remaining = length;
+		for (int current = 0; remaining > 0; current ^= 1)
+		{
+			peer_buffer &buffer = buffers[current];
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				changed.wait(lock, [&] { return !buffer.full || writeError != RSP_SUCCESS; });
+				if (writeError != RSP_SUCCESS) return;
+			}
+
+			uint32_t part = chunkLength(src, address, remaining);
+			rsp_int returnCode = rspStreamerReadHost(src, address, buffer.data, part);
+
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				if (returnCode != RSP_SUCCESS)
+				{
+					readError = returnCode;
+				}
+				else
+				{
+					buffer.address = address;
+					buffer.length = part;
+					buffer.full = true;
+				}
+			}
+			changed.notify_all();
+			if (returnCode != RSP_SUCCESS) return;
+
+			address += part;
+			remaining -= part;
+		}
+	});
+
+	uint32_t remaining = length;
+	for (int current = 0; remaining > 0; current ^= 1)
+	{
+		peer_buffer &buffer = buffers[current];
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			changed.wait(lock, [&] { return buffer.full || readError != RSP_SUCCESS; });
+			if (!buffer.full) break;
+		}
+
+		// the reader refills the buffer as soon as it is released
+		const uint32_t part = buffer.length;
+		rsp_int returnCode = rspStreamerWriteHost(dst, dstAddress + (buffer.address - srcAddress),
+            buffer.data, part);
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (returnCode != RSP_SUCCESS) writeError = returnCode;
+			buffer.full = false;
+		}
+		changed.notify_all();
+		if (returnCode != RSP_SUCCESS) break;
+
+		remaining -= part;
+	}
+
+	reader.join();
+	releaseBuffer(buffers[0]);
+	releaseBuffer(buffers[1]);
+
+	return readError != RSP_SUCCESS ? readError : writeError;
+}
+
+rsp_int rspPeerCopy(const rsp_streamer *src,
+                    uint32_t srcAddress,
+                    const rsp_streamer *dst,
+                    uint32_t dstAddress,
+                    uint32_t length)
+{
+	if (!src || !dst || !src->kernel_inst || !dst->kernel_inst) return RSP_INVALID_VALUE;
+	if (length % 4 != 0 || srcAddress % 4 != 0 || dstAddress % 4 != 0) return RSP_INVALID_VALUE;
+	if (static_cast<uint64_t>(srcAddress) + length > 0x100000000ULL ||
+        static_cast<uint64_t>(dstAddress) + length > 0x100000000ULL)
+	{
+		return RSP_INVALID_VALUE;
+	}
+	if (length == 0) return RSP_SUCCESS;
+
+	if (src->kernel_inst == dst->kernel_inst)
+	{
+		return rspStreamerCopyDMA(src, RSP_STREAMER_DMA_1, srcAddress, dstAddress, length);
+	}
+
+	return hostBounceCopy(src, srcAddress, dst, dstAddress, length);
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+// Host memory per chunk of a host-bounce copy. Two chunks are in flight, one
+// being read from the source module while the other is written to the target.
+const uint32_t PEER_CHUNK_BYTES = 1024 * 1024;
+
+// Copies length bytes of DDR from one module to another. Within one module
+// the copy runs on the module's DMA (see rspStreamerCopyDMA); between modules
+// a reader thread pulls chunks from src into page-locked buffers while the
+// calling thread pushes the previous chunk into dst.
+rsp_int rspPeerCopy(const rsp_streamer *src,
+                    uint32_t srcAddress,
+                    const rsp_streamer *dst,
+                    uint32_t dstAddress,
+                    uint32_t length);
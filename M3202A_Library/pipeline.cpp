@@ -0,0 +1,54 @@
+#include "stdafx.h"
+
+#include "pipeline.h"
+
+static void pipelineThread(rsp_pipeline *pipeline)
+{
+	std::unique_lock<std::mutex> guard(pipeline->lock);
+	while (true)
+	{
+		pipeline->changed.wait(guard, [pipeline] { return pipeline->stopping || pipeline->busy; });
+		if (!pipeline->busy) return;
+
+		std::function<rsp_int()> job = std::move(pipeline->job);
+		guard.unlock();
+		rsp_int returnCode = job();
+		guard.lock();
+
+		if (pipeline->result == RSP_SUCCESS) pipeline->result = returnCode;
+		pipeline->busy = false;
+		pipeline->changed.notify_all();
+	}
+}
+
+rsp_pipeline::~rsp_pipeline()
+{
+	{
+		std::unique_lock<std::mutex> guard(lock);
+		changed.wait(guard, [this] { return !busy; });
+		stopping = true;
+		changed.notify_all();
+	}
+	if (worker.joinable()) worker.join();
+}
+
+void rspPipelineSubmit(rsp_pipeline *pipeline, std::function<rsp_int()> job)
+{
+	std::unique_lock<std::mutex> guard(pipeline->lock);
+	pipeline->changed.wait(guard, [pipeline] { return !pipeline->busy; });
+
+	if (!pipeline->worker.joinable()) pipeline->worker = std::thread(pipelineThread, pipeline);
+	pipeline->job = std::move(job);
+	pipeline->busy = true;
+	pipeline->changed.notify_all();
+}
+
+rsp_int rspPipelineWait(rsp_pipeline *pipeline)
+{
+	std::unique_lock<std::mutex> guard(pipeline->lock);
+	pipeline->changed.wait(guard, [pipeline] { return !pipeline->busy; });
+
+	rsp_int returnCode = pipeline->result;
+	pipeline->result = RSP_SUCCESS;
+	return returnCode;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include "M3202A_Library.h"
+
+// Second stage of a double-buffered loop: while the caller reads or fills
+// buffer k, the job handed over for buffer k-1 runs on the worker. The one
+// worker serves the whole loop and is joined when the pipeline goes away.
+struct rsp_pipeline
+{
+	std::mutex lock;
+	std::condition_variable changed;
+	std::thread worker;
+	std::function<rsp_int()> job;
+	bool busy = false;               // a job is queued or running
+	bool stopping = false;
+	rsp_int result = RSP_SUCCESS;    // first failure since the last rspPipelineWait
+
+	~rsp_pipeline();
+};
+
+// Queues job behind the one in flight, starting the worker on first use
+void rspPipelineSubmit(rsp_pipeline *pipeline, std::function<rsp_int()> job);
+
+// Waits until no job is in flight; returns the first failure of the jobs
+// finished since the last call, or RSP_SUCCESS
+rsp_int rspPipelineWait(rsp_pipeline *pipeline);
@@ -0,0 +1,189 @@
+#include "stdafx.h"
+
+#include "reader.h"
+
+#include <algorithm>
+#include <cstring>
+
+static uint32_t blockOf(uint32_t address)
+{
+	return address - address % READER_BLOCK_BYTES;
+}
+
+static rsp_reader_block &slotOf(rsp_reader *reader, uint32_t block)
+{
+	return reader->ring[(block / READER_BLOCK_BYTES) % reader->ring.size()];
+}
+
+// Whether the slot for address holds it, possibly still loading
+static bool holds(const rsp_reader_block &slot, uint32_t address)
+{
+	return slot.valid && address >= slot.address && address - slot.address < slot.length;
+}
+
+// Drops the read-ahead, called with reader->lock held. A prefetch in
+// progress completes into its slot and is ignored.
+static void resetRing(rsp_reader *reader)
+{
+	reader->generation++;
+	reader->streaming = false;
+	for (rsp_reader_block &slot : reader->ring)
+	{
+		slot.valid = false;
+		slot.ready = false;
+	}
+}
+
+static void prefetch(rsp_reader *reader)
+{
+	const uint64_t end = static_cast<uint64_t>(reader->address) + reader->length;
+	const uint64_t ahead = static_cast<uint64_t>(reader->ring.size()) * READER_BLOCK_BYTES;
+
+	std::unique_lock<std::mutex> lock(reader->lock);
+	for (;;)
+	{
+		// a slot is reused only once the consumer has left the block it held
+		reader->changed.wait(lock, [&] {
+			return reader->stopping || (reader->streaming && reader->next < end &&
+                reader->next < reader->consumer + ahead);
+		});
+		if (reader->stopping) return;
+
+		const uint32_t block = static_cast<uint32_t>(reader->next);
+		const uint32_t generation = reader->generation;
+		rsp_reader_block &slot = slotOf(reader, block);
+		slot.address = std::max(block, reader->address);
+		slot.length = static_cast<uint32_t>(std::min(static_cast<uint64_t>(block) + READER_BLOCK_BYTES, end) - slot.address);
+		slot.valid = true;
+		slot.ready = false;
+		reader->next = static_cast<uint64_t>(block) + READER_BLOCK_BYTES;
+
+		lock.unlock();
+		rsp_int returnCode = rspStreamerReadHost(reader->streamer, slot.address, slot.data.data(), slot.length);
+		lock.lock();
+
+		if (generation != reader->generation) continue;
+
+		slot.ready = true;
+		slot.error = returnCode;
+		if (returnCode == RSP_SUCCESS) reader->stats.bytesPrefetched += slot.length;
+		reader->changed.notify_all();
+	}
+}
+
+rsp_reader *rspReaderOpen(const rsp_streamer *streamer, uint32_t address, uint32_t length, uint32_t depth, rsp_int *error)
+{
+	if (!streamer || length == 0 || address % 4 != 0 || length % 4 != 0 ||
+        static_cast<uint64_t>(address) + length > 0x100000000ULL)
+	{
+		if (error) *error = RSP_INVALID_VALUE;
+		return nullptr;
+	}
+
+	rsp_reader *reader = new rsp_reader();
+	reader->streamer = streamer;
+	reader->address = address;
+	reader->length = length;
+	reader->expected = address;
+
+	reader->ring.resize(depth ? depth : READER_DEFAULT_DEPTH);
+	for (rsp_reader_block &slot : reader->ring) slot.data.resize(READER_BLOCK_BYTES / 4);
+
+	reader->prefetcher = std::thread(prefetch, reader);
+
+	if (error) *error = RSP_SUCCESS;
+	return reader;
+}
+
+rsp_int rspReaderRead(rsp_reader *reader, uint32_t *data, uint32_t address, uint32_t length)
+{
+	if (!reader || !data || address % 4 != 0 || length % 4 != 0) return RSP_INVALID_VALUE;
+	if (static_cast<uint64_t>(address) + length > 0x100000000ULL) return RSP_INVALID_VALUE;
+
+	std::unique_lock<std::mutex> lock(reader->lock);
+	reader->stats.reads++;
+
+	if (address == reader->expected)
+	{
+		reader->sequential++;
+	}
+	else
+	{
+		if (reader->streaming) reader->stats.resets++;
+		resetRing(reader);
+		reader->sequential = 0;
+	}
+	reader->expected = address + length;
+
+	// serve what the read-ahead holds, in order
+	uint32_t done = 0;
+	bool waited = false;
+	while (done < length && reader->streaming)
+	{
+		const uint32_t at = address + done;
+		rsp_reader_block &slot = slotOf(reader, blockOf(at));
+		if (!holds(slot, at)) break;
+
+		if (!slot.ready)
+		{
+			waited = true;
+			reader->changed.wait(lock, [&] { return slot.ready || !slot.valid; });
+			if (!slot.ready) break;
+		}
+		if (slot.error != RSP_SUCCESS) break;
+
+		const uint32_t part = std::min(length - done, slot.address + slot.length - at);
+		std::memcpy(data + done / 4, slot.data.data() + (at - slot.address) / 4, part);
+		done += part;
+	}
+
+	reader->stats.bytesFromRing += done;
+	if (done == length)
+	{
+		reader->stats.hits++;
+		if (waited) reader->stats.waits++;
+	}
+	else
+	{
+		reader->stats.misses++;
+	}
+
+	rsp_int returnCode = RSP_SUCCESS;
+	if (done < length)
+	{
+		lock.unlock();
+		returnCode = rspStreamerReadHost(reader->streamer, address + done, data + done / 4, length - done);
+		lock.lock();
+		if (returnCode == RSP_SUCCESS) reader->stats.bytesDirect += length - done;
+	}
+
+	const uint64_t end = static_cast<uint64_t>(reader->address) + reader->length;
+	const bool inside = reader->expected >= reader->address && reader->expected < end;
+	if (!reader->streaming && reader->sequential >= READER_DETECT_READS && inside)
+	{
+		reader->streaming = true;
+		reader->next = blockOf(reader->expected);
+	}
+	if (reader->streaming)
+	{
+		// blocks the consumer skipped with direct reads are not fetched anymore
+		reader->consumer = blockOf(reader->expected);
+		reader->next = std::max<uint64_t>(reader->next, reader->consumer);
+	}
+	reader->changed.notify_all();
+
+	return returnCode;
+}
+
+void rspReaderClose(rsp_reader *reader)
+{
+	if (!reader) return;
+
+	{
+		std::lock_guard<std::mutex> guard(reader->lock);
+		reader->stopping = true;
+	}
+	reader->changed.notify_all();
+	reader->prefetcher.join();
+	delete reader;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "M3202A_Library.h"
+
+// Granularity of read-ahead; blocks start on multiples of it
+const uint32_t READER_BLOCK_BYTES = 256 * 1024;
+
+// Blocks kept ahead of the consumer when DdrReaderOpen is given depth 0
+const uint32_t READER_DEFAULT_DEPTH = 8;
+
+// Back-to-back reads needed before prefetching starts
+const uint32_t READER_DETECT_READS = 2;
+
+struct rsp_reader_block
+{
+	std::vector<uint32_t> data;
+	uint32_t address = 0;
+	uint32_t length = 0;
+	bool valid = false;          // assigned to address, possibly still loading
+	bool ready = false;          // data holds the block
+	rsp_int error = RSP_SUCCESS;
+};
+
+// Sequential reader over a DDR region. Once reads are found to follow each
+// other, a prefetch thread keeps up to depth blocks past the consumer in a
+// ring; block n lives in slot n % depth. The region is assumed not to change
+// while the reader is open, e.g. a finished capture.
+struct rsp_reader
+{
+	const rsp_streamer *streamer = nullptr;
+	uint32_t address = 0;        // region
+	uint32_t length = 0;
+
+	std::mutex lock;
+	std::condition_variable changed;
+	std::thread prefetcher;
+	bool stopping = false;
+
+	std::vector<rsp_reader_block> ring;
+	uint32_t expected = 0;       // address following the last read
+	uint32_t sequential = 0;     // reads in a row that started at expected
+	bool streaming = false;
+	uint32_t consumer = 0;       // block the consumer is in
+	uint64_t next = 0;           // next block to prefetch, may reach 4 GB
+	uint32_t generation = 0;     // bumped on reset so stale prefetches are dropped
+
+	DdrReaderStats stats = DdrReaderStats();
+};
+
+rsp_reader *rspReaderOpen(const rsp_streamer *streamer, uint32_t address, uint32_t length, uint32_t depth, rsp_int *error);
+
+// Reads length bytes at address. Data inside the region comes from the
+// read-ahead where it has been fetched, the rest directly from DDR.
+rsp_int rspReaderRead(rsp_reader *reader, uint32_t *data, uint32_t address, uint32_t length);
+
+// Stops the prefetch thread and frees the ring
+void rspReaderClose(rsp_reader *reader);
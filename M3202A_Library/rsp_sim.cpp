@@ -0,0 +1,745 @@
+#include "stdafx.h"
+
+#ifdef M3202A_SIMULATED_DEVICE
+
+#include "dma_status.h"
+#include "et.h"
+#include "et_model.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+const char *SIM_PLATFORM_NAME = "M31xx_M32xx_M33xx";
+const char *SIM_DEVICE_UUID_PREFIX = "80090200-0a2f-62f7-a2bb-edab000349";
+
+const uint64_t SIM_DMA_BASE = 0x20000;
+const uint64_t SIM_PAGER = SIM_DMA_BASE + 2 * DMA_REGISTER_SPAN;
+const uint64_t SIM_ET_BASE = 0x21000;
+const uint64_t SIM_HOST_WINDOW = 0x100000;
+const uint64_t SIM_HOST_WINDOW_SIZE = 0x100000;
+
+// DDR is allocated in blocks of this size on first touch
+const uint64_t SIM_DDR_BLOCK = 64 * 1024;
+const uint64_t SIM_DDR_SIZE = 0x100000000ULL;
+
+// DMACR bits
+const uint32_t DMACR_RS = 0x1;
+const uint32_t DMACR_RESET = 0x4;
+
+// DMASR bits
+const uint32_t DMASR_HALTED = 0x1;
+const uint32_t DMASR_IDLE = 0x2;
+const uint32_t DMASR_SLVERR = 0x20;
+const uint32_t DMASR_IOC = 0x1000;
+
+struct sim_address
+{
+	const char *name;
+	uint64_t address;
+	uint64_t length;
+};
+
+static const sim_address SIM_ADDRESS_MAP[] = {
+	{ "DDR_Inst", 0x0, 0x1000 },
+	{ "Host_axilite_Inst", SIM_DMA_BASE, 0x1000 },
+	{ "Et_Inst", SIM_ET_BASE, 0x1000 },
+	{ "Host_aximm_Inst", SIM_HOST_WINDOW, SIM_HOST_WINDOW_SIZE }
+};
+const size_t SIM_ADDRESS_COUNT = sizeof(SIM_ADDRESS_MAP) / sizeof(SIM_ADDRESS_MAP[0]);
+
+struct sim_channel
+{
+	uint32_t control;
+	uint32_t error;
+	bool busy;
+	uint64_t address;
+	uint32_t length;
+};
+
+// One AXI DMA engine. MM2S pushes into stream, S2MM drains it, so the two
+// channels of an engine form the loopback used by rspStreamerCopyDMA.
+struct sim_dma
+{
+	sim_channel mm2s;
+	sim_channel s2mm;
+	std::vector<uint8_t> stream;
+};
+
+struct sim_module
+{
+	std::string uuid;
+
+	std::mutex lock;
+	std::condition_variable streamed;
+
+	std::unordered_map<uint64_t, std::unique_ptr<uint8_t[]>> ddr;
+	std::map<uint64_t, uint32_t> registers;
+	sim_dma dma[2];
+	uint32_t page;
+	std::map<size_t, std::deque<uint8_t>> streams;
+	bool et_armed;               // ET_CLR written, the next DMA_1 MM2S block goes through the ET
+};
+
+struct _rsp_platform_id
+{
+	std::vector<std::unique_ptr<sim_module>> modules;
+	std::vector<std::unique_ptr<_rsp_device_id>> devices;
+	std::atomic<int> faults;
+};
+
+struct _rsp_device_id
+{
+	sim_module *module;
+};
+
+struct _rsp_context
+{
+	rsp_device_id device;
+};
+
+struct _rsp_program
+{
+	rsp_device_id device;
+	std::string kernel_name;
+};
+
+struct _rsp_kernel
+{
+	rsp_device_id device;
+};
+
+struct _rsp_kernel_instance
+{
+	sim_module *module;
+};
+
+static int envInt(const char *name, int fallback)
+{
+#ifdef _MSC_VER
+	char *value = nullptr;
+	size_t size = 0;
+	if (_dupenv_s(&value, &size, name) != 0 || !value) return fallback;
+	int result = std::atoi(value);
+	free(value);
+	return result;
+#else
+	const char *value = std::getenv(name);
+	return value ? std::atoi(value) : fallback;
+#endif
+}
+
+static _rsp_platform_id *simPlatform()
+{
+	static _rsp_platform_id *platform = [] {
+		_rsp_platform_id *p = new _rsp_platform_id();
+		p->faults = envInt("M3202A_SIM_DMA_FAULTS", 0);
+
+		int count = std::max(1, envInt("M3202A_SIM_DEVICES", 2));
+		for (int i = 0; i < count; i++)
+		{
+			char suffix[16];
+			snprintf(suffix, sizeof(suffix), "%02x", i);
+
+			p->modules.emplace_back(new sim_module());
+			p->modules.back()->uuid = std::string(SIM_DEVICE_UUID_PREFIX) + suffix;
+			p->devices.emplace_back(new _rsp_device_id());
+			p->devices.back()->module = p->modules.back().get();
+		}
+		return p;
+	}();
+	return platform;
+}
+
+// Common handling of the size query / copy convention of the info calls
+static rsp_int returnInfo(const void *value, size_t size,
+                          size_t param_value_size, void *param_value, size_t *param_value_size_ret)
+{
+	if (param_value_size_ret) *param_value_size_ret = size;
+	if (param_value)
+	{
+		if (param_value_size < size) return RSP_INVALID_VALUE;
+		std::memcpy(param_value, value, size);
+	}
+	return RSP_SUCCESS;
+}
+
+static rsp_int returnString(const std::string &value,
+                            size_t param_value_size, void *param_value, size_t *param_value_size_ret)
+{
+	return returnInfo(value.c_str(), value.size() + 1, param_value_size, param_value, param_value_size_ret);
+}
+
+// ---------------------------------------------------------------------------
+// module model, called with module->lock held
+
+static uint8_t *ddrBlock(sim_module *module, uint64_t address)
+{
+	std::unique_ptr<uint8_t[]> &block = module->ddr[address / SIM_DDR_BLOCK];
+	if (!block)
+	{
+		block.reset(new uint8_t[SIM_DDR_BLOCK]);
+		std::memset(block.get(), 0, SIM_DDR_BLOCK);
+	}
+	return block.get();
+}
+
+static void ddrWrite(sim_module *module, uint64_t address, const uint8_t *data, uint64_t length)
+{
+	while (length > 0)
+	{
+		uint64_t offset = address % SIM_DDR_BLOCK;
+		uint64_t part = std::min(length, SIM_DDR_BLOCK - offset);
+		std::memcpy(ddrBlock(module, address) + offset, data, part);
+		address += part;
+		data += part;
+		length -= part;
+	}
+}
+
+static void ddrRead(sim_module *module, uint64_t address, uint8_t *data, uint64_t length)
+{
+	while (length > 0)
+	{
+		uint64_t offset = address % SIM_DDR_BLOCK;
+		uint64_t part = std::min(length, SIM_DDR_BLOCK - offset);
+		auto it = module->ddr.find(address / SIM_DDR_BLOCK);
+		if (it == module->ddr.end())
+		{
+			std::memset(data, 0, part);
+		}
+		else
+		{
+			std::memcpy(data, it->second.get() + offset, part);
+		}
+		address += part;
+		data += part;
+		length -= part;
+	}
+}
+
+static uint32_t channelStatus(const sim_channel &channel)
+{
+	uint32_t status = channel.error;
+	if (!(channel.control & DMACR_RS) || channel.error) status |= DMASR_HALTED;
+	else if (!channel.busy) status |= DMASR_IDLE | DMASR_IOC;
+	return status;
+}
+
+// Completes S2MM once enough data has arrived from MM2S
+static void dmaDeliver(sim_module *module, sim_dma &dma)
+{
+	if (!dma.s2mm.busy || dma.stream.size() < dma.s2mm.length) return;
+
+	ddrWrite(module, dma.s2mm.address, dma.stream.data(), dma.s2mm.length);
+	dma.stream.erase(dma.stream.begin(), dma.stream.begin() + dma.s2mm.length);
+	dma.s2mm.busy = false;
+}
+
+static uint32_t storedRegister(sim_module *module, uint64_t address)
+{
+	auto it = module->registers.find(address);
+	return it == module->registers.end() ? 0 : it->second;
+}
+
+// Replaces the IQ block read by MM2S with the envelope the ET kernel makes of it
+static void etProcessBlock(sim_module *module, sim_dma &dma, size_t offset)
+{
+	const uint32_t inSamples = storedRegister(module, SIM_ET_BASE + ET_IN_SAMPLES);
+	const uint32_t outSamples = storedRegister(module, SIM_ET_BASE + ET_OUT_SAMPLES);
+	const size_t available = (dma.stream.size() - offset) / 4;
+
+	std::vector<uint32_t> iq(std::min<size_t>(inSamples, available));
+	std::memcpy(iq.data(), dma.stream.data() + offset, iq.size() * 4);
+	dma.stream.resize(offset);
+	if (iq.empty()) return;
+
+	std::vector<uint32_t> table(ET_SHAPING_TABLE_LENGTH);
+	for (size_t i = 0; i < table.size(); i++)
+	{
+		table[i] = storedRegister(module, SIM_ET_BASE + ET_SHAPING_TABLE + 4 * i);
+	}
+
+	rsp_et_model model;
+	model.rate = storedRegister(module, SIM_ET_BASE + ET_RESAMPLER_RATE);
+	model.table = table.data();
+	model.iq = iq.data();
+	model.in_samples = iq.size();
+
+	std::vector<uint16_t> envelope(outSamples);
+	rspEtModelRun(&model, envelope.data(), envelope.size());
+
+	dma.stream.resize(offset + envelope.size() * 2);
+	std::memcpy(dma.stream.data() + offset, envelope.data(), envelope.size() * 2);
+}
+
+static void dmaStartMM2S(sim_module *module, sim_dma &dma)
+{
+	sim_channel &channel = dma.mm2s;
+	if (!(channel.control & DMACR_RS) || channel.error) return;
+
+	std::atomic<int> &faults = simPlatform()->faults;
+	int remaining = faults;
+	while (remaining > 0 && !faults.compare_exchange_weak(remaining, remaining - 1)) {}
+
+	if (remaining > 0 || channel.address + channel.length > SIM_DDR_SIZE)
+	{
+		channel.error = DMASR_SLVERR;
+		return;
+	}
+
+	size_t offset = dma.stream.size();
+	dma.stream.resize(offset + channel.length);
+	ddrRead(module, channel.address, dma.stream.data() + offset, channel.length);
+
+	// the ET kernel sits between the channels of DMA_1
+	if (&dma == &module->dma[0] && module->et_armed)
+	{
+		module->et_armed = false;
+		etProcessBlock(module, dma, offset);
+	}
+	dmaDeliver(module, dma);
+}
+
+static void dmaStartS2MM(sim_module *module, sim_dma &dma)
+{
+	sim_channel &channel = dma.s2mm;
+	if (!(channel.control & DMACR_RS) || channel.error) return;
+
+	if (channel.address + channel.length > SIM_DDR_SIZE)
+	{
+		channel.error = DMASR_SLVERR;
+		return;
+	}
+
+	channel.busy = true;
+	dmaDeliver(module, dma);
+}
+
+static void dmaControl(sim_dma &dma, sim_channel &channel, uint32_t value)
+{
+	if (value & DMACR_RESET)
+	{
+		// a reset through either DMACR resets the whole engine
+		dma = sim_dma();
+		return;
+	}
+	channel.control = value;
+}
+
+static bool dmaRegister(uint64_t address, sim_dma **dma, uint64_t *offset, _rsp_kernel_instance *ki)
+{
+	if (address < SIM_DMA_BASE || address >= SIM_DMA_BASE + 2 * DMA_REGISTER_SPAN) return false;
+
+	*dma = &ki->module->dma[(address - SIM_DMA_BASE) / DMA_REGISTER_SPAN];
+	*offset = (address - SIM_DMA_BASE) % DMA_REGISTER_SPAN;
+	return true;
+}
+
+static void writeRegister(_rsp_kernel_instance *ki, uint64_t address, uint32_t value)
+{
+	sim_module *module = ki->module;
+	sim_dma *dma;
+	uint64_t offset;
+
+	if (address == SIM_PAGER)
+	{
+		module->page = value;
+		return;
+	}
+	if (address == SIM_ET_BASE + ET_CLR && (value & 1))
+	{
+		module->et_armed = true;
+	}
+	if (!dmaRegister(address, &dma, &offset, ki))
+	{
+		module->registers[address] = value;
+		return;
+	}
+
+	switch (offset)
+	{
+	case MM2S_DMACR: dmaControl(*dma, dma->mm2s, value); break;
+	case MM2S_SA: dma->mm2s.address = (dma->mm2s.address & ~0xFFFFFFFFULL) | value; break;
+	case MM2S_SA_MSB: dma->mm2s.address = (dma->mm2s.address & 0xFFFFFFFFULL) | (uint64_t(value) << 32); break;
+	case MM2S_LENGTH: dma->mm2s.length = value; dmaStartMM2S(module, *dma); break;
+	case S2MM_DMACR: dmaControl(*dma, dma->s2mm, value); break;
+	case S2MM_DA: dma->s2mm.address = (dma->s2mm.address & ~0xFFFFFFFFULL) | value; break;
+	case S2MM_DA_MSB: dma->s2mm.address = (dma->s2mm.address & 0xFFFFFFFFULL) | (uint64_t(value) << 32); break;
+	case S2MM_LENGTH: dma->s2mm.length = value; dmaStartS2MM(module, *dma); break;
+	default: module->registers[address] = value; break;
+	}
+}
+
+static uint32_t readRegister(_rsp_kernel_instance *ki, uint64_t address)
+{
+	sim_module *module = ki->module;
+	sim_dma *dma;
+	uint64_t offset;
+
+	if (address == SIM_PAGER) return module->page;
+	if (dmaRegister(address, &dma, &offset, ki))
+	{
+		switch (offset)
+		{
+		case MM2S_DMACR: return dma->mm2s.control;
+		case MM2S_DMASR: return channelStatus(dma->mm2s);
+		case MM2S_SA: return static_cast<uint32_t>(dma->mm2s.address);
+		case MM2S_SA_MSB: return static_cast<uint32_t>(dma->mm2s.address >> 32);
+		case MM2S_LENGTH: return dma->mm2s.length;
+		case S2MM_DMACR: return dma->s2mm.control;
+		case S2MM_DMASR: return channelStatus(dma->s2mm);
+		case S2MM_DA: return static_cast<uint32_t>(dma->s2mm.address);
+		case S2MM_DA_MSB: return static_cast<uint32_t>(dma->s2mm.address >> 32);
+		case S2MM_LENGTH: return dma->s2mm.length;
+		}
+	}
+
+	return storedRegister(module, address);
+}
+
+static bool inHostWindow(uint64_t address, size_t length)
+{
+	return address >= SIM_HOST_WINDOW && address + length <= SIM_HOST_WINDOW + SIM_HOST_WINDOW_SIZE;
+}
+
+static uint64_t hostWindowToDdr(sim_module *module, uint64_t address)
+{
+	return static_cast<uint64_t>(module->page) * SIM_HOST_WINDOW_SIZE + (address - SIM_HOST_WINDOW);
+}
+
+// ---------------------------------------------------------------------------
+// rsp API
+
+rsp_int rspGetPlatformIDs(rsp_uint num_entries, rsp_platform_id *platforms, rsp_uint *num_platforms)
+{
+	if (num_platforms) *num_platforms = 1;
+	if (platforms && num_entries > 0) platforms[0] = simPlatform();
+	return RSP_SUCCESS;
+}
+
+rsp_int rspGetPlatformInfo(rsp_platform_id platform, rsp_platform_info param_name,
+                           size_t param_value_size, void *param_value, size_t *param_value_size_ret)
+{
+	if (platform != simPlatform()) return RSP_INVALID_VALUE;
+	if (param_name != RSP_PLATFORM_NAME) return RSP_INVALID_ENUM;
+	return returnString(SIM_PLATFORM_NAME, param_value_size, param_value, param_value_size_ret);
+}
+
+rsp_int rspGetDeviceIDs(rsp_platform_id platform, rsp_device_type device_type, rsp_uint num_entries,
+                        rsp_device_id *devices, rsp_uint *num_devices)
+{
+	if (platform != simPlatform()) return RSP_INVALID_VALUE;
+	if (device_type != RSP_DEVICE_TYPE_FPGA) return RSP_DEVICE_NOT_FOUND;
+
+	rsp_uint count = static_cast<rsp_uint>(platform->devices.size());
+	if (num_devices) *num_devices = count;
+	for (rsp_uint i = 0; devices && i < std::min(num_entries, count); i++)
+	{
+		devices[i] = platform->devices[i].get();
+	}
+	return RSP_SUCCESS;
+}
+
+rsp_int rspGetDeviceInfo(rsp_device_id device, rsp_device_info param_name,
+                         size_t param_value_size, void *param_value, size_t *param_value_size_ret)
+{
+	if (!device) return RSP_INVALID_VALUE;
+	if (param_name != RSP_DEVICE_UUID_KS) return RSP_INVALID_ENUM;
+	return returnString(device->module->uuid, param_value_size, param_value, param_value_size_ret);
+}
+
+rsp_context rspCreateContext(const void *properties, rsp_uint num_devices, const rsp_device_id *devices,
+                             void *pfn_notify, void *user_data, rsp_int *errcode_ret)
+{
+	if (num_devices != 1 || !devices || !devices[0])
+	{
+		if (errcode_ret) *errcode_ret = RSP_INVALID_VALUE;
+		return nullptr;
+	}
+
+	rsp_context context = new _rsp_context();
+	context->device = devices[0];
+	if (errcode_ret) *errcode_ret = RSP_SUCCESS;
+	return context;
+}
+
+// The kernel of a simulated program is named after the k7z file, which is
+// how the bundled archives are named. The file itself is not read.
+rsp_program rspCreateProgramWithK7z(rsp_context context, rsp_uint num_devices, const rsp_device_id *device_list,
+                                    rsp_uint num_files, const char **files, rsp_int *errcode_ret)
+{
+	if (!context || num_devices != 1 || !device_list || num_files != 1 || !files || !files[0])
+	{
+		if (errcode_ret) *errcode_ret = RSP_INVALID_VALUE;
+		return nullptr;
+	}
+
+	std::string name = files[0];
+	size_t slash = name.find_last_of("/\\");
+	if (slash != std::string::npos) name = name.substr(slash + 1);
+	size_t dot = name.rfind(".k7z");
+	if (dot == std::string::npos || name.empty())
+	{
+		if (errcode_ret) *errcode_ret = RSP_INVALID_PATH;
+		return nullptr;
+	}
+
+	rsp_program program = new _rsp_program();
+	program->device = device_list[0];
+	program->kernel_name = name.substr(0, dot);
+	if (errcode_ret) *errcode_ret = RSP_SUCCESS;
+	return program;
+}
+
+rsp_int rspGetProgramInfo(rsp_program program, rsp_program_info param_name,
+                          size_t param_value_size, void *param_value, size_t *param_value_size_ret)
+{
+	if (!program) return RSP_INVALID_VALUE;
+	if (param_name != RSP_PROGRAM_KERNEL_NAMES) return RSP_INVALID_ENUM;
+	return returnString(program->kernel_name, param_value_size, param_value, param_value_size_ret);
+}
+
+rsp_kernel rspCreateKernel(rsp_program program, const char *kernel_name, rsp_int *errcode_ret)
+{
+	if (!program || !kernel_name || program->kernel_name != kernel_name)
+	{
+		if (errcode_ret) *errcode_ret = RSP_INVALID_KERNEL_NAME;
+		return nullptr;
+	}
+
+	rsp_kernel kernel = new _rsp_kernel();
+	kernel->device = program->device;
+	if (errcode_ret) *errcode_ret = RSP_SUCCESS;
+	return kernel;
+}
+
+// Loading the bitfile resets the registers and DMA engines; DDR keeps its contents
+rsp_kernel_instance rspCreateKernelInstance(rsp_kernel kernel, rsp_int *errcode_ret)
+{
+	if (!kernel)
+	{
+		if (errcode_ret) *errcode_ret = RSP_INVALID_VALUE;
+		return nullptr;
+	}
+
+	sim_module *module = kernel->device->module;
+	{
+		std::lock_guard<std::mutex> guard(module->lock);
+		module->registers.clear();
+		module->dma[0] = sim_dma();
+		module->dma[1] = sim_dma();
+		module->page = 0;
+		module->streams.clear();
+		module->et_armed = false;
+	}
+
+	rsp_kernel_instance ki = new _rsp_kernel_instance();
+	ki->module = module;
+	if (errcode_ret) *errcode_ret = RSP_SUCCESS;
+	return ki;
+}
+
+rsp_int rspGetAddressInfo(rsp_kernel_instance kernel_instance, rsp_uint index, rsp_address_info param_name,
+                          size_t param_value_size, void *param_value, size_t *param_value_size_ret)
+{
+	if (!kernel_instance) return RSP_INVALID_KERNEL_INSTANCE;
+
+	if (param_name == RSP_ADDRESS_COUNT)
+	{
+		uint32_t count = static_cast<uint32_t>(SIM_ADDRESS_COUNT);
+		return returnInfo(&count, sizeof(count), param_value_size, param_value, param_value_size_ret);
+	}
+	if (param_name == RSP_ADDRESS_MAP)
+	{
+		std::string map;
+		for (const sim_address &entry : SIM_ADDRESS_MAP)
+		{
+			char line[128];
+			snprintf(line, sizeof(line), "%-20s 0x%08llx 0x%08llx\n", entry.name,
+                static_cast<unsigned long long>(entry.address), static_cast<unsigned long long>(entry.length));
+			map += line;
+		}
+		return returnString(map, param_value_size, param_value, param_value_size_ret);
+	}
+
+	if (index >= SIM_ADDRESS_COUNT) return RSP_INVALID_VALUE;
+	const sim_address &entry = SIM_ADDRESS_MAP[index];
+
+	switch (param_name)
+	{
+	case RSP_ADDRESS_NAME:
+		return returnString(entry.name, param_value_size, param_value, param_value_size_ret);
+	case RSP_ADDRESS_LENGTH:
+	{
+		rsp_ulong length = entry.length;
+		return returnInfo(&length, sizeof(length), param_value_size, param_value, param_value_size_ret);
+	}
+	default:
+		return RSP_INVALID_ENUM;
+	}
+}
+
+rsp_int rspGetAddress(rsp_kernel_instance kernel_instance, const char *name, uint64_t *address)
+{
+	if (!kernel_instance) return RSP_INVALID_KERNEL_INSTANCE;
+	if (!name || !address) return RSP_INVALID_VALUE;
+
+	for (const sim_address &entry : SIM_ADDRESS_MAP)
+	{
+		if (std::strcmp(entry.name, name) == 0)
+		{
+			*address = entry.address;
+			return RSP_SUCCESS;
+		}
+	}
+	return RSP_INVALID_VALUE;
+}
+
+rsp_int rspKernelInstanceRegisterRead(rsp_kernel_instance kernel_instance, uint32_t *data, const uint64_t address)
+{
+	return rspKernelInstanceArrayRead(kernel_instance, data, address, 4);
+}
+
+rsp_int rspKernelInstanceRegisterWrite(rsp_kernel_instance kernel_instance, const uint32_t data, const uint64_t address)
+{
+	return rspKernelInstanceArrayWrite(kernel_instance, &data, address, 4);
+}
+
+rsp_int rspKernelInstanceArrayRead(rsp_kernel_instance kernel_instance, uint32_t *data, const uint64_t address,
+                                   size_t length)
+{
+	if (!kernel_instance) return RSP_INVALID_KERNEL_INSTANCE;
+	if (!data || address % 4 != 0 || length % 4 != 0) return RSP_INVALID_VALUE;
+
+	sim_module *module = kernel_instance->module;
+	std::lock_guard<std::mutex> guard(module->lock);
+
+	if (address >= SIM_HOST_WINDOW)
+	{
+		if (!inHostWindow(address, length)) return RSP_INVALID_VALUE;
+		ddrRead(module, hostWindowToDdr(module, address), reinterpret_cast<uint8_t*>(data), length);
+		return RSP_SUCCESS;
+	}
+
+	for (size_t i = 0; i < length / 4; i++)
+	{
+		data[i] = readRegister(kernel_instance, address + i * 4);
+	}
+	return RSP_SUCCESS;
+}
+
+rsp_int rspKernelInstanceArrayWrite(rsp_kernel_instance kernel_instance, const uint32_t *data, const uint64_t address,
+                                    size_t length)
+{
+	if (!kernel_instance) return RSP_INVALID_KERNEL_INSTANCE;
+	if (!data || address % 4 != 0 || length % 4 != 0) return RSP_INVALID_VALUE;
+
+	sim_module *module = kernel_instance->module;
+	std::lock_guard<std::mutex> guard(module->lock);
+
+	if (address >= SIM_HOST_WINDOW)
+	{
+		if (!inHostWindow(address, length)) return RSP_INVALID_VALUE;
+		ddrWrite(module, hostWindowToDdr(module, address), reinterpret_cast<const uint8_t*>(data), length);
+		return RSP_SUCCESS;
+	}
+
+	for (size_t i = 0; i < length / 4; i++)
+	{
+		writeRegister(kernel_instance, address + i * 4, data[i]);
+	}
+	return RSP_SUCCESS;
+}
+
+// Kernel streams loop back: what is written to stream n is read from stream n
+rsp_int rspKernelInstanceStreamRead(rsp_kernel_instance kernel_instance, size_t stream_index, void *data,
+                                    size_t length)
+{
+	if (!kernel_instance) return RSP_INVALID_KERNEL_INSTANCE;
+	if (!data && length > 0) return RSP_INVALID_VALUE;
+
+	sim_module *module = kernel_instance->module;
+	std::unique_lock<std::mutex> guard(module->lock);
+
+	std::deque<uint8_t> &stream = module->streams[stream_index];
+	module->streamed.wait(guard, [&] { return stream.size() >= length; });
+
+	std::copy(stream.begin(), stream.begin() + length, static_cast<uint8_t*>(data));
+	stream.erase(stream.begin(), stream.begin() + length);
+	return RSP_SUCCESS;
+}
+
+rsp_int rspKernelInstanceStreamWrite(rsp_kernel_instance kernel_instance, size_t stream_index, const void *data,
+                                     size_t length)
+{
+	if (!kernel_instance) return RSP_INVALID_KERNEL_INSTANCE;
+	if (!data && length > 0) return RSP_INVALID_VALUE;
+
+	sim_module *module = kernel_instance->module;
+	{
+		std::lock_guard<std::mutex> guard(module->lock);
+		const uint8_t *bytes = static_cast<const uint8_t*>(data);
+		module->streams[stream_index].insert(module->streams[stream_index].end(), bytes, bytes + length);
+	}
+	module->streamed.notify_all();
+	return RSP_SUCCESS;
+}
+
+rsp_int rspReleaseKernelInstance(rsp_kernel_instance kernel_instance)
+{
+	delete kernel_instance;
+	return RSP_SUCCESS;
+}
+
+rsp_int rspReleaseKernel(rsp_kernel kernel)
+{
+	delete kernel;
+	return RSP_SUCCESS;
+}
+
+rsp_int rspReleaseProgram(rsp_program program)
+{
+	delete program;
+	return RSP_SUCCESS;
+}
+
+rsp_int rspReleaseContext(rsp_context context)
+{
+	delete context;
+	return RSP_SUCCESS;
+}
+
+// Devices live as long as the process
+rsp_int rspReleaseDevice(rsp_device_id device)
+{
+	return RSP_SUCCESS;
+}
+
+const char *rspGetErrorCodeName(rsp_int error_code)
+{
+	switch (error_code)
+	{
+	case RSP_SUCCESS: return "RSP_SUCCESS";
+	case RSP_DEVICE_NOT_FOUND: return "RSP_DEVICE_NOT_FOUND";
+	case RSP_PLATFORM_NOT_FOUND: return "RSP_PLATFORM_NOT_FOUND";
+	case RSP_FAILED_DOWNLOAD: return "RSP_FAILED_DOWNLOAD";
+	case RSP_INVALID_VALUE: return "RSP_INVALID_VALUE";
+	case RSP_INVALID_ENUM: return "RSP_INVALID_ENUM";
+	case RSP_INVALID_PATH: return "RSP_INVALID_PATH";
+	case RSP_INVALID_KERNEL_NAME: return "RSP_INVALID_KERNEL_NAME";
+	case RSP_INVALID_KERNEL_INSTANCE: return "RSP_INVALID_KERNEL_INSTANCE";
+	default: return "RSP_UNKNOWN_ERROR";
+	}
+}
+
+#endif
@@ -0,0 +1,124 @@
+#pragma once
+
+// Stand-in for the BSP's rsp.h when building with M3202A_SIMULATED_DEVICE.
+// Declares the subset of the rsp API this library uses; rsp_sim.cpp
+// implements it against in-memory modules instead of linking rsp.lib.
+//
+// Each simulated module exposes the PWFPGA_EnvelopeTracker address map:
+//   Host_axilite_Inst  0x20000   DMA_1, DMA_2 (+0x400) and the pager (+0x800)
+//   Et_Inst            0x21000   envelope tracker registers; writing ET_CLR makes
+//                                the next DMA_1 MM2S block go through et_model.h
+//   Host_aximm_Inst    0x100000  1 MB host window into DDR, selected by the pager
+// Everything else below the host window is plain register storage.
+// M3202A_SIM_DEVICES sets the number of modules (default 2),
+// M3202A_SIM_DMA_FAULTS makes that many DMA transfers fail with DMASlvErr.
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef int32_t rsp_int;
+typedef uint32_t rsp_uint;
+typedef uint64_t rsp_ulong;
+
+typedef struct _rsp_platform_id *rsp_platform_id;
+typedef struct _rsp_device_id *rsp_device_id;
+typedef struct _rsp_context *rsp_context;
+typedef struct _rsp_program *rsp_program;
+typedef struct _rsp_kernel *rsp_kernel;
+typedef struct _rsp_kernel_instance *rsp_kernel_instance;
+
+typedef rsp_uint rsp_platform_info;
+typedef rsp_uint rsp_device_info;
+typedef rsp_uint rsp_device_type;
+typedef rsp_uint rsp_program_info;
+typedef rsp_uint rsp_address_info;
+
+// error codes
+#define RSP_SUCCESS                     0
+#define RSP_DEVICE_NOT_FOUND            -1
+#define RSP_PLATFORM_NOT_FOUND          -2
+#define RSP_FAILED_DOWNLOAD             -3
+#define RSP_INVALID_VALUE               -30
+#define RSP_INVALID_ENUM                -31
+#define RSP_INVALID_PATH                -32
+#define RSP_INVALID_KERNEL_NAME         -33
+#define RSP_INVALID_KERNEL_INSTANCE     -34
+
+// rsp_platform_info
+#define RSP_PLATFORM_NAME               0x0902
+
+// rsp_device_type
+#define RSP_DEVICE_TYPE_FPGA            (1 << 4)
+
+// rsp_device_info
+#define RSP_DEVICE_UUID_KS              0x1100
+
+// rsp_program_info
+#define RSP_PROGRAM_KERNEL_NAMES        0x1168
+
+// rsp_address_info
+#define RSP_ADDRESS_MAP                 0x1200
+#define RSP_ADDRESS_COUNT               0x1201
+#define RSP_ADDRESS_NAME                0x1202
+#define RSP_ADDRESS_LENGTH              0x1203
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+rsp_int rspGetPlatformIDs(rsp_uint num_entries, rsp_platform_id *platforms, rsp_uint *num_platforms);
+
+rsp_int rspGetPlatformInfo(rsp_platform_id platform, rsp_platform_info param_name,
+                           size_t param_value_size, void *param_value, size_t *param_value_size_ret);
+
+rsp_int rspGetDeviceIDs(rsp_platform_id platform, rsp_device_type device_type, rsp_uint num_entries,
+                        rsp_device_id *devices, rsp_uint *num_devices);
+
+rsp_int rspGetDeviceInfo(rsp_device_id device, rsp_device_info param_name,
+                         size_t param_value_size, void *param_value, size_t *param_value_size_ret);
+
+rsp_context rspCreateContext(const void *properties, rsp_uint num_devices, const rsp_device_id *devices,
+                             void *pfn_notify, void *user_data, rsp_int *errcode_ret);
+
+rsp_program rspCreateProgramWithK7z(rsp_context context, rsp_uint num_devices, const rsp_device_id *device_list,
+                                    rsp_uint num_files, const char **files, rsp_int *errcode_ret);
+
+rsp_int rspGetProgramInfo(rsp_program program, rsp_program_info param_name,
+                          size_t param_value_size, void *param_value, size_t *param_value_size_ret);
+
+rsp_kernel rspCreateKernel(rsp_program program, const char *kernel_name, rsp_int *errcode_ret);
+
+rsp_kernel_instance rspCreateKernelInstance(rsp_kernel kernel, rsp_int *errcode_ret);
+
+rsp_int rspGetAddressInfo(rsp_kernel_instance kernel_instance, rsp_uint index, rsp_address_info param_name,
+                          size_t param_value_size, void *param_value, size_t *param_value_size_ret);
+
+rsp_int rspGetAddress(rsp_kernel_instance kernel_instance, const char *name, uint64_t *address);
+
+rsp_int rspKernelInstanceRegisterRead(rsp_kernel_instance kernel_instance, uint32_t *data, const uint64_t address);
+
+rsp_int rspKernelInstanceRegisterWrite(rsp_kernel_instance kernel_instance, const uint32_t data, const uint64_t address);
+
+rsp_int rspKernelInstanceArrayRead(rsp_kernel_instance kernel_instance, uint32_t *data, const uint64_t address,
+                                   size_t length);
+
+rsp_int rspKernelInstanceArrayWrite(rsp_kernel_instance kernel_instance, const uint32_t *data, const uint64_t address,
+                                    size_t length);
+
+rsp_int rspKernelInstanceStreamRead(rsp_kernel_instance kernel_instance, size_t stream_index, void *data,
+                                    size_t length);
+
+rsp_int rspKernelInstanceStreamWrite(rsp_kernel_instance kernel_instance, size_t stream_index, const void *data,
+                                     size_t length);
+
+rsp_int rspReleaseKernelInstance(rsp_kernel_instance kernel_instance);
+rsp_int rspReleaseKernel(rsp_kernel kernel);
+rsp_int rspReleaseProgram(rsp_program program);
+rsp_int rspReleaseContext(rsp_context context);
+rsp_int rspReleaseDevice(rsp_device_id device);
+
+const char *rspGetErrorCodeName(rsp_int error_code);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,505 @@
+#include "stdafx.h"
+
+#include "sample_format.h"
+#include "pipeline.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <emmintrin.h>
+
+// Pairs taken through quantizing and packing at a time, small enough to stay in L1
+const size_t SAMPLE_CODE_BLOCK = 256;
+
+// Rounds values * factor to the nearest code, ties to even like Math.Round,
+// saturating at +-full_scale. Returns how many values saturated.
+static size_t quantize(const double *values, size_t count, double factor, double full_scale, int32_t *codes)
+{
+	const __m128d scale = _mm_set1_pd(factor);
+	const __m128d high = _mm_set1_pd(full_scale);
+	const __m128d low = _mm_set1_pd(-full_scale);
+	// from here on a value rounds to a code beyond full scale
+	const __m128d limit = _mm_set1_pd(full_scale + 0.5);
+	const __m128d magnitude = _mm_castsi128_pd(_mm_set1_epi64x(0x7FFFFFFFFFFFFFFFLL));
+
+	size_t clipped = 0;
+	size_t n = 0;
+	for (; n + 4 <= count; n += 4)
+	{
+		__m128d a = _mm_mul_pd(_mm_loadu_pd(values + n), scale);
+		__m128d b = _mm_mul_pd(_mm_loadu_pd(values + n + 2), scale);
+		const int over = _mm_movemask_pd(_mm_cmpge_pd(_mm_and_pd(a, magnitude), limit)) |
+            _mm_movemask_pd(_mm_cmpge_pd(_mm_and_pd(b, magnitude), limit)) << 2;
+		clipped += (over & 1) + (over >> 1 & 1) + (over >> 2 & 1) + (over >> 3);
+
+		__m128i ca = _mm_cvtpd_epi32(_mm_min_pd(_mm_max_pd(a, low), high));
+		__m128i cb = _mm_cvtpd_epi32(_mm_min_pd(_mm_max_pd(b, low), high));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(codes + n), _mm_unpacklo_epi64(ca, cb));
+	}
+	for (; n < count; n++)
+	{
+		const double v = values[n] * factor;
+		if (std::fabs(v) >= full_scale + 0.5) clipped++;
+		codes[n] = _mm_cvtsd_si32(_mm_set_sd(std::min(std::max(v, -full_scale), full_scale)));
+	}
+	return clipped;
+}
+
+static void dequantize(const int32_t *codes, size_t count, double scale, double *values)
+{
+	const __m128d factor = _mm_set1_pd(scale);
+
+	size_t n = 0;
+	for (; n + 2 <= count; n += 2)
+	{
+		__m128d v = _mm_cvtepi32_pd(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(codes + n)));
+		_mm_storeu_pd(values + n, _mm_mul_pd(v, factor));
+	}
+	for (; n < count; n++)
+	{
+		values[n] = codes[n] * scale;
+	}
+}
+
+// Packing of one DDR layout. Integer formats pack and unpack the codes of
+// quantize; float32 converts the values directly.
+template <SampleFormat F> struct sample_codec;
+
+template <> struct sample_codec<SAMPLE_IQ16>
+{
+	static const bool has_markers = false;
+	static double fullScale() { return 32767; }
+	static size_t words(size_t pairs) { return pairs; }
+
+	static void pack(const int32_t *codes, const uint8_t *, size_t pairs, uint32_t *words)
+	{
+		size_t n = 0;
+		// the codes are in range, so the saturation of packs changes nothing
+		for (; n + 4 <= pairs; n += 4)
+		{
+			__m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(codes + 2 * n));
+			__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(codes + 2 * n + 4));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(words + n), _mm_packs_epi32(a, b));
+		}
+		for (; n < pairs; n++)
+		{
+			words[n] = (static_cast<uint32_t>(codes[2 * n]) & 0xFFFF) | static_cast<uint32_t>(codes[2 * n + 1]) << 16;
+		}
+	}
+
+	static void unpack(const uint32_t *words, size_t pairs, int32_t *codes, uint8_t *)
+	{
+		size_t n = 0;
+		for (; n + 4 <= pairs; n += 4)
+		{
+			__m128i w = _mm_loadu_si128(reinterpret_cast<const __m128i*>(words + n));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(codes + 2 * n), _mm_srai_epi32(_mm_unpacklo_epi16(w, w), 16));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(codes + 2 * n + 4), _mm_srai_epi32(_mm_unpackhi_epi16(w, w), 16));
+		}
+		for (; n < pairs; n++)
+		{
+			codes[2 * n] = static_cast<int16_t>(words[n] & 0xFFFF);
+			codes[2 * n + 1] = static_cast<int16_t>(words[n] >> 16);
+		}
+	}
+};
+
+template <> struct sample_codec<SAMPLE_IQ24_MARKERS>
+{
+	static const bool has_markers = true;
+	static double fullScale() { return 8388607; }
+	static size_t words(size_t pairs) { return 2 * pairs; }
+
+	static void pack(const int32_t *codes, const uint8_t *markers, size_t pairs, uint32_t *words)
+	{
+		size_t n = 0;
+		for (; n + 2 <= pairs; n += 2)
+		{
+			__m128i w = _mm_slli_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(codes + 2 * n)), 8);
+			if (markers) w = _mm_or_si128(w, _mm_set_epi32(0, markers[n + 1] & 0xF, 0, markers[n] & 0xF));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(words + 2 * n), w);
+		}
+		for (; n < pairs; n++)
+		{
+			words[2 * n] = static_cast<uint32_t>(codes[2 * n]) << 8 | (markers ? markers[n] & 0xF : 0);
+			words[2 * n + 1] = static_cast<uint32_t>(codes[2 * n + 1]) << 8;
+		}
+	}
+
+	static void unpack(const uint32_t *words, size_t pairs, int32_t *codes, uint8_t *markers)
+	{
+		size_t n = 0;
+		for (; n + 2 <= pairs; n += 2)
+		{
+			__m128i w = _mm_loadu_si128(reinterpret_cast<const __m128i*>(words + 2 * n));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(codes + 2 * n), _mm_srai_epi32(w, 8));
+		}
+		for (; n < pairs; n++)
+		{
+			codes[2 * n] = static_cast<int32_t>(words[2 * n]) >> 8;
+			codes[2 * n + 1] = static_cast<int32_t>(words[2 * n + 1]) >> 8;
+		}
+		if (markers)
+		{
+			for (n = 0; n < pairs; n++) markers[n] = static_cast<uint8_t>(words[2 * n] & 0xF);
+		}
+	}
+};
+
+// Four pairs of 24 bits in three words. The bit packing stays scalar, SSE2
+// has no byte shuffle to do it with; quantizing is the expensive part.
+template <> struct sample_codec<SAMPLE_IQ12_PACKED>
+{
+	static const bool has_markers = false;
+	static double fullScale() { return 2047; }
+	static size_t words(size_t pairs) { return (pairs * 3 + 3) / 4; }
+
+	static uint32_t field(int32_t code)
+	{
+		return static_cast<uint32_t>(code) & 0xFFF;
+	}
+
+	static int32_t signExtend(uint32_t field)
+	{
+		return static_cast<int32_t>(field << 20) >> 20;
+	}
+
+	static void pack(const int32_t *codes, const uint8_t *, size_t pairs, uint32_t *words)
+	{
+		for (size_t n = 0; n < pairs; n += 4)
+		{
+			uint32_t p[4] = {};
+			const size_t count = std::min<size_t>(4, pairs - n);
+			for (size_t k = 0; k < count; k++)
+			{
+				p[k] = field(codes[2 * (n + k)]) | field(codes[2 * (n + k) + 1]) << 12;
+			}
+
+			const uint32_t group[3] = { p[0] | p[1] << 24, p[1] >> 8 | p[2] << 16, p[2] >> 16 | p[3] << 8 };
+			std::copy(group, group + sample_codec::words(count), words + n / 4 * 3);
+		}
+	}
+
+	static void unpack(const uint32_t *words, size_t pairs, int32_t *codes, uint8_t *)
+	{
+		for (size_t n = 0; n < pairs; n += 4)
+		{
+			uint32_t group[3] = {};
+			const size_t count = std::min<size_t>(4, pairs - n);
+			std::copy(words + n / 4 * 3, words + n / 4 * 3 + sample_codec::words(count), group);
+
+			const uint32_t p[4] = { group[0] & 0xFFFFFF, group[0] >> 24 | (group[1] & 0xFFFF) << 8,
+                group[1] >> 16 | (group[2] & 0xFF) << 16, group[2] >> 8 };
+			for (size_t k = 0; k < count; k++)
+			{
+				codes[2 * (n + k)] = signExtend(p[k] & 0xFFF);
+				codes[2 * (n + k) + 1] = signExtend(p[k] >> 12);
+			}
+		}
+	}
+};
+
+template <> struct sample_codec<SAMPLE_FLOAT32>
+{
+	static const bool has_markers = false;
+	static double fullScale() { return 1; }
+	static size_t words(size_t pairs) { return 2 * pairs; }
+
+	static void pack(const double *values, size_t pairs, double factor, uint32_t *words)
+	{
+		const __m128d scale = _mm_set1_pd(factor);
+		float *out = reinterpret_cast<float*>(words);
+		const size_t count = 2 * pairs;
+
+		size_t n = 0;
+		for (; n + 4 <= count; n += 4)
+		{
+			__m128 a = _mm_cvtpd_ps(_mm_mul_pd(_mm_loadu_pd(values + n), scale));
+			__m128 b = _mm_cvtpd_ps(_mm_mul_pd(_mm_loadu_pd(values + n + 2), scale));
+			_mm_storeu_ps(out + n, _mm_movelh_ps(a, b));
+		}
+		for (; n < count; n++)
+		{
+			out[n] = static_cast<float>(values[n] * factor);
+		}
+	}
+
+	static void unpack(const uint32_t *words, size_t pairs, double scale, double *values)
+	{
+		const __m128d factor = _mm_set1_pd(scale);
+		const float *in = reinterpret_cast<const float*>(words);
+		const size_t count = 2 * pairs;
+
+		size_t n = 0;
+		for (; n + 4 <= count; n += 4)
+		{
+			__m128 v = _mm_loadu_ps(in + n);
+			_mm_storeu_pd(values + n, _mm_mul_pd(_mm_cvtps_pd(v), factor));
+			_mm_storeu_pd(values + n + 2, _mm_mul_pd(_mm_cvtps_pd(_mm_movehl_ps(v, v)), factor));
+		}
+		for (; n < count; n++)
+		{
+			values[n] = in[n] * scale;
+		}
+	}
+};
+
+// At most SAMPLE_CODE_BLOCK pairs; returns the values that saturated
+template <SampleFormat F>
+static size_t packBlock(const double *iq, size_t pairs, double factor, const uint8_t *markers, uint32_t *words)
+{
+	int32_t codes[2 * SAMPLE_CODE_BLOCK];
+	const size_t clipped = quantize(iq, 2 * pairs, factor, sample_codec<F>::fullScale(), codes);
+	sample_codec<F>::pack(codes, markers, pairs, words);
+	return clipped;
+}
+
+template <>
+size_t packBlock<SAMPLE_FLOAT32>(const double *iq, size_t pairs, double factor, const uint8_t *, uint32_t *words)
+{
+	sample_codec<SAMPLE_FLOAT32>::pack(iq, pairs, factor, words);
+	return 0;
+}
+
+template <SampleFormat F>
+static void unpackBlock(const uint32_t *words, size_t pairs, double scale, double *iq, uint8_t *markers)
+{
+	int32_t codes[2 * SAMPLE_CODE_BLOCK];
+	sample_codec<F>::unpack(words, pairs, codes, markers);
+	dequantize(codes, 2 * pairs, scale, iq);
+}
+
+template <>
+void unpackBlock<SAMPLE_FLOAT32>(const uint32_t *words, size_t pairs, double scale, double *iq, uint8_t *)
+{
+	sample_codec<SAMPLE_FLOAT32>::unpack(words, pairs, scale, iq);
+}
+
+// A format picked at run time, bound to its compile-time codec
+struct sample_format_ops
+{
+	bool has_markers;
+	double full_scale;
+	size_t (*words)(size_t pairs);
+	size_t (*pack)(const double *iq, size_t pairs, double factor, const uint8_t *markers, uint32_t *words);
+	void (*unpack)(const uint32_t *words, size_t pairs, double scale, double *iq, uint8_t *markers);
+};
+
+template <SampleFormat F>
+static sample_format_ops opsOf()
+{
+	sample_format_ops ops = { sample_codec<F>::has_markers, sample_codec<F>::fullScale(),
+        sample_codec<F>::words, packBlock<F>, unpackBlock<F> };
+	return ops;
+}
+
+static const sample_format_ops *formatOps(SampleFormat format)
+{
+	static const sample_format_ops table[SAMPLE_FORMAT_COUNT] = {
+		opsOf<SAMPLE_IQ16>(),
+		opsOf<SAMPLE_IQ24_MARKERS>(),
+		opsOf<SAMPLE_FLOAT32>(),
+		opsOf<SAMPLE_IQ12_PACKED>()
+	};
+	if (format < SAMPLE_IQ16 || format >= SAMPLE_FORMAT_COUNT) return nullptr;
+	return &table[format];
+}
+
+// Largest sqrt(I^2 + Q^2), the magnitude GetMaxMagnitude scales by
+static double peakMagnitude(const double *iq, size_t pairs)
+{
+	__m128d peak = _mm_setzero_pd();
+
+	size_t n = 0;
+	for (; n + 2 <= pairs; n += 2)
+	{
+		__m128d a = _mm_loadu_pd(iq + 2 * n);
+		__m128d b = _mm_loadu_pd(iq + 2 * n + 2);
+		a = _mm_mul_pd(a, a);
+		b = _mm_mul_pd(b, b);
+		peak = _mm_max_pd(peak, _mm_add_pd(_mm_unpacklo_pd(a, b), _mm_unpackhi_pd(a, b)));
+	}
+
+	double lanes[2];
+	_mm_storeu_pd(lanes, peak);
+	double power = std::max(lanes[0], lanes[1]);
+	for (; n < pairs; n++)
+	{
+		power = std::max(power, iq[2 * n] * iq[2 * n] + iq[2 * n + 1] * iq[2 * n + 1]);
+	}
+	return std::sqrt(power);
+}
+
+size_t rspSampleWords(SampleFormat format, size_t pairs)
+{
+	const sample_format_ops *ops = formatOps(format);
+	return ops ? ops->words(pairs) : 0;
+}
+
+double rspSampleAutoScale(SampleFormat format, const double *iq, size_t pairs)
+{
+	const sample_format_ops *ops = formatOps(format);
+	const double peak = iq ? peakMagnitude(iq, pairs) : 0;
+	return ops && peak > 0 ? peak / ops->full_scale : 1.0;
+}
+
+rsp_int rspSamplePack(SampleFormat format,
+                      const double *iq,
+                      size_t pairs,
+                      double scale,
+                      const uint8_t *markers,
+                      uint32_t *words,
+                      size_t *clipped)
+{
+	const sample_format_ops *ops = formatOps(format);
+	if (!ops) return RSP_INVALID_ENUM;
+	if ((pairs && (!iq || !words)) || !(scale > 0) || (markers && !ops->has_markers)) return RSP_INVALID_VALUE;
+
+	size_t saturated = 0;
+	for (size_t done = 0; done < pairs;)
+	{
+		// blocks start on whole words, SAMPLE_CODE_BLOCK being a multiple of every group
+		const size_t part = std::min(pairs - done, SAMPLE_CODE_BLOCK);
+		saturated += ops->pack(iq + 2 * done, part, 1.0 / scale, markers ? markers + done : nullptr,
+            words + ops->words(done));
+		done += part;
+	}
+
+	if (clipped) *clipped = saturated;
+	return RSP_SUCCESS;
+}
+
+rsp_int rspSampleUnpack(SampleFormat format,
+                        const uint32_t *words,
+                        size_t pairs,
+                        double scale,
+                        double *iq,
+                        uint8_t *markers)
+{
+	const sample_format_ops *ops = formatOps(format);
+	if (!ops) return RSP_INVALID_ENUM;
+	if ((pairs && (!iq || !words)) || (markers && !ops->has_markers)) return RSP_INVALID_VALUE;
+
+	for (size_t done = 0; done < pairs;)
+	{
+		const size_t part = std::min(pairs - done, SAMPLE_CODE_BLOCK);
+		ops->unpack(words + ops->words(done), part, scale, iq + 2 * done, markers ? markers + done : nullptr);
+		done += part;
+	}
+	return RSP_SUCCESS;
+}
+
+static rsp_int transferBlock(const rsp_streamer *streamer, RSP_STREAMER_IO io, uint32_t address, uint32_t *words, uint32_t bytes)
+{
+	const rsp_trace_time start = rspTraceNow();
+	rsp_int ret = io == RSP_STREAMER_READ
+            ? rspStreamerReadHost(streamer, address, words, bytes)
+            : rspStreamerWriteHost(streamer, address, words, bytes);
+	if (rspTraceActive) rspTraceRecord(io == RSP_STREAMER_WRITE ? TRACE_DDR_WRITE : TRACE_DDR_READ, start, ret, address, 0, bytes, words);
+	return ret;
+}
+
+// Words of pairs pairs at address stay below 4 GB, the end of the host window
+static bool fitsWindow(const sample_format_ops *ops, uint32_t address, size_t pairs)
+{
+	return pairs <= 0x100000000ULL && address + static_cast<uint64_t>(ops->words(pairs)) * 4 <= 0x100000000ULL;
+}
+
+rsp_int rspDdrWriteSamples(const rsp_streamer *streamer,
+                           SampleFormat format,
+                           const double *iq,
+                           uint32_t address,
+                           size_t pairs,
+                           double *scale,
+                           const uint8_t *markers,
+                           size_t *clipped)
+{
+	const sample_format_ops *ops = formatOps(format);
+	if (!ops) return RSP_INVALID_ENUM;
+	if (!streamer || !iq || !scale || address % 4 != 0 || (markers && !ops->has_markers)) return RSP_INVALID_VALUE;
+	if (!fitsWindow(ops, address, pairs)) return RSP_INVALID_VALUE;
+
+	if (!(*scale > 0)) *scale = rspSampleAutoScale(format, iq, pairs);
+
+	std::vector<uint32_t> buffers[2];
+	for (std::vector<uint32_t> &buffer : buffers) buffer.resize(ops->words(std::min(pairs, SAMPLE_TRANSFER_PAIRS)));
+
+	rsp_int returnCode = RSP_SUCCESS;
+	size_t saturated = 0;
+	rsp_pipeline writing;
+	int current = 0;
+	for (size_t done = 0; done < pairs;)
+	{
+		const size_t part = std::min(pairs - done, SAMPLE_TRANSFER_PAIRS);
+		uint32_t *words = buffers[current].data();
+
+		// packed while the worker writes the previous block
+		size_t blockClipped = 0;
+		rspSamplePack(format, iq + 2 * done, part, *scale, markers ? markers + done : nullptr, words, &blockClipped);
+		saturated += blockClipped;
+
+		returnCode = rspPipelineWait(&writing);
+		if (returnCode != RSP_SUCCESS) break;
+
+		const uint32_t bytes = static_cast<uint32_t>(ops->words(part) * 4);
+		rspPipelineSubmit(&writing, [streamer, address, words, bytes] {
+			return transferBlock(streamer, RSP_STREAMER_WRITE, address, words, bytes);
+		});
+
+		address += bytes;
+		done += part;
+		current ^= 1;
+	}
+	rsp_int writeCode = rspPipelineWait(&writing);
+	if (returnCode == RSP_SUCCESS) returnCode = writeCode;
+
+	if (clipped) *clipped = saturated;
+	return returnCode;
+}
+
+rsp_int rspDdrReadSamples(const rsp_streamer *streamer,
+                          SampleFormat format,
+                          double *iq,
+                          uint32_t address,
+                          size_t pairs,
+                          double scale,
+                          uint8_t *markers)
+{
+	const sample_format_ops *ops = formatOps(format);
+	if (!ops) return RSP_INVALID_ENUM;
+	if (!streamer || !iq || address % 4 != 0 || (markers && !ops->has_markers)) return RSP_INVALID_VALUE;
+	if (!fitsWindow(ops, address, pairs)) return RSP_INVALID_VALUE;
+	if (pairs == 0) return RSP_SUCCESS;
+
+	std::vector<uint32_t> buffers[2];
+	for (std::vector<uint32_t> &buffer : buffers) buffer.resize(ops->words(std::min(pairs, SAMPLE_TRANSFER_PAIRS)));
+
+	rsp_pipeline reading;
+	auto startRead = [&](size_t done, int buffer) {
+		const uint32_t blockAddress = address + static_cast<uint32_t>(ops->words(done) * 4);
+		const uint32_t bytes = static_cast<uint32_t>(ops->words(std::min(pairs - done, SAMPLE_TRANSFER_PAIRS)) * 4);
+		uint32_t *words = buffers[buffer].data();
+		rspPipelineSubmit(&reading, [streamer, blockAddress, words, bytes] {
+			return transferBlock(streamer, RSP_STREAMER_READ, blockAddress, words, bytes);
+		});
+	};
+
+	// block k is unpacked while the worker reads block k+1 into the other buffer
+	startRead(0, 0);
+	int current = 0;
+	for (size_t done = 0; done < pairs;)
+	{
+		const size_t part = std::min(pairs - done, SAMPLE_TRANSFER_PAIRS);
+		rsp_int returnCode = rspPipelineWait(&reading);
+		if (returnCode != RSP_SUCCESS) return returnCode;
+
+		if (done + part < pairs) startRead(done + part, current ^ 1);
+
+		rspSampleUnpack(format, buffers[current].data(), part, scale, iq + 2 * done, markers ? markers + done : nullptr);
+		done += part;
+		current ^= 1;
+	}
+	return RSP_SUCCESS;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "M3202A_Library.h"
+
+// Pairs converted per DDR transfer by rspDdrWriteSamples and
+// rspDdrReadSamples; a multiple of every format's group of pairs
+const size_t SAMPLE_TRANSFER_PAIRS = 256 * 1024;
+
+// Words holding pairs IQ pairs of format, 0 for an unknown format. A packed
+// 12-bit tail shorter than four pairs still takes whole words.
+size_t rspSampleWords(SampleFormat format, size_t pairs);
+
+// Scale that fits the largest magnitude of iq into format, as
+// ScaleToFixedPoint picks it; 1 for silence
+double rspSampleAutoScale(SampleFormat format, const double *iq, size_t pairs);
+
+// Quantizes interleaved I,Q values by 1/scale into words. Codes beyond the
+// full scale of the format saturate and are counted in clipped. markers (one
+// byte per pair, low four bits used) may only be given for formats that carry
+// them; without it the marker bits are 0.
+rsp_int rspSamplePack(SampleFormat format,
+                      const double *iq,
+                      size_t pairs,
+                      double scale,
+                      const uint8_t *markers,
+                      uint32_t *words,
+                      size_t *clipped);
+
+rsp_int rspSampleUnpack(SampleFormat format,
+                        const uint32_t *words,
+                        size_t pairs,
+                        double scale,
+                        double *iq,
+                        uint8_t *markers);
+
+// Packs SAMPLE_TRANSFER_PAIRS at a time while the previous block is being
+// written, so converting and the DDR transfer overlap. A scale of 0 or less
+// is replaced by rspSampleAutoScale and returned.
+rsp_int rspDdrWriteSamples(const rsp_streamer *streamer,
+                           SampleFormat format,
+                           const double *iq,
+                           uint32_t address,
+                           size_t pairs,
+                           double *scale,
+                           const uint8_t *markers,
+                           size_t *clipped);
+
+// Reads the next block while the current one is unpacked
+rsp_int rspDdrReadSamples(const rsp_streamer *streamer,
+                          SampleFormat format,
+                          double *iq,
+                          uint32_t address,
+                          size_t pairs,
+                          double scale,
+                          uint8_t *markers);
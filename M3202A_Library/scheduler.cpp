@@ -0,0 +1,235 @@
+#include "stdafx.h"
+
+#include "scheduler.h"
+#include "mirror.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+
+typedef std::chrono::steady_clock Clock;
+
+static uint32_t highestBit(uint64_t value)
+{
+	uint32_t bit = 0;
+	while (value >>= 1) bit++;
+	return bit;
+}
+
+// Values below 4 ns get a bucket each, above that every power of two is
+// split in four
+static uint32_t bucketOf(uint64_t ns)
+{
+	if (ns < 4) return static_cast<uint32_t>(ns);
+
+	const uint32_t bit = highestBit(ns);
+	const uint32_t quarter = static_cast<uint32_t>(ns >> (bit - 2)) & 3;
+	return std::min((bit - 1) * 4 + quarter, SCHEDULER_BUCKETS - 1);
+}
+
+static uint64_t bucketLimit(uint32_t bucket)
+{
+	if (bucket < 4) return bucket + 1;
+	return static_cast<uint64_t>(5 + bucket % 4) << (bucket / 4 - 1);
+}
+
+static double percentile(const rsp_io_class &io_class, double fraction)
+{
+	const uint64_t rank = static_cast<uint64_t>(std::ceil(io_class.requests * fraction));
+	uint64_t seen = 0;
+	for (uint32_t bucket = 0; bucket < SCHEDULER_BUCKETS; bucket++)
+	{
+		seen += io_class.histogram[bucket];
+		if (seen >= rank) return std::min(bucketLimit(bucket), io_class.max_ns) * 1e-9;
+	}
+	return io_class.max_ns * 1e-9;
+}
+
+// Issues the request, or the next page of it for DDR. Returns whether the
+// request is complete.
+static bool runPiece(rsp_scheduler *scheduler, rsp_io_request *request, rsp_int *result)
+{
+	const rsp_streamer *streamer = scheduler->streamer;
+	rsp_kernel_instance kernel_inst = streamer->kernel_inst;
+
+	switch (request->op)
+	{
+	case IO_REG_READ:
+		*result = rspKernelInstanceRegisterRead(kernel_inst, request->data, request->address);
+		return true;
+	case IO_REG_WRITE:
+		*result = rspKernelInstanceRegisterWrite(kernel_inst, request->data[0], request->address);
+		return true;
+	case IO_REG_ARRAY_READ:
+		*result = rspKernelInstanceArrayRead(kernel_inst, request->data, request->address, request->length);
+		return true;
+	case IO_REG_ARRAY_WRITE:
+		*result = rspKernelInstanceArrayWrite(kernel_inst, request->data, request->address, request->length);
+		return true;
+	default:
+		break;
+	}
+
+	// up to the end of the host window page holding the current address
+	const uint32_t address = static_cast<uint32_t>(request->address) + request->done;
+	const uint32_t page = streamer->page_size;
+	uint32_t part = request->length - request->done;
+	if (page != 0) part = std::min(part, page - address % page);
+
+	uint32_t *data = request->data + request->done / 4;
+	*result = request->op == IO_DDR_READ
+        ? rspStreamerReadHost(streamer, address, data, part)
+        : rspStreamerWriteHost(streamer, address, data, part);
+
+	request->done += part;
+	scheduler->pieces++;
+	return *result != RSP_SUCCESS || request->done == request->length;
+}
+
+static void serve(rsp_scheduler *scheduler)
+{
+	std::unique_lock<std::mutex> lock(scheduler->lock);
+	for (;;)
+	{
+		auto waiting = std::find_if(std::begin(scheduler->queues), std::end(scheduler->queues),
+            [](const std::deque<rsp_io_request*> &queue) { return !queue.empty(); });
+		if (waiting == std::end(scheduler->queues))
+		{
+			if (scheduler->stopping) return;
+			scheduler->work.wait(lock);
+			continue;
+		}
+
+		rsp_io_request *request = waiting->front();
+		waiting->pop_front();
+
+		lock.unlock();
+		rsp_int result;
+		const bool complete = runPiece(scheduler, request, &result);
+		lock.lock();
+
+		if (!complete)
+		{
+			waiting->push_back(request);
+			continue;
+		}
+
+		const uint64_t ns = static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - request->submitted).count());
+		rsp_io_class &io_class = scheduler->classes[request->priority];
+		io_class.requests++;
+		io_class.bytes += request->length;
+		io_class.total_ns += ns;
+		io_class.max_ns = std::max(io_class.max_ns, ns);
+		io_class.histogram[bucketOf(ns)]++;
+
+		scheduler->counters->queue_depth.fetch_sub(1, std::memory_order_relaxed);
+		request->result = result;
+		request->finished = true;
+		request->completed.notify_one();
+	}
+}
+
+rsp_scheduler *rspSchedulerOpen(const rsp_streamer *streamer, rsp_int *error)
+{
+	if (!streamer || !streamer->kernel_inst)
+	{
+		if (error) *error = RSP_INVALID_VALUE;
+		return nullptr;
+	}
+
+	rsp_scheduler *scheduler = new rsp_scheduler();
+	scheduler->streamer = streamer;
+	scheduler->counters = &rspStreamerCounters(streamer->kernel_inst);
+	scheduler->thread = std::thread(serve, scheduler);
+
+	if (error) *error = RSP_SUCCESS;
+	return scheduler;
+}
+
+rsp_int rspSchedulerSubmit(rsp_scheduler *scheduler,
+                           IoPriority priority,
+                           IoOp op,
+                           uint32_t *data,
+                           uint64_t address,
+                           uint32_t length)
+{
+	if (priority < IO_PRIORITY_CONTROL || priority >= IO_PRIORITY_COUNT) return RSP_INVALID_ENUM;
+	if (op < IO_REG_READ || op > IO_DDR_WRITE) return RSP_INVALID_ENUM;
+	if (!scheduler || !data) return RSP_INVALID_VALUE;
+
+	const bool ddr = op == IO_DDR_READ || op == IO_DDR_WRITE;
+	if (ddr && (address % 4 != 0 || length % 4 != 0)) return RSP_INVALID_VALUE;
+	if (ddr && address > 0x100000000ULL - length) return RSP_INVALID_VALUE;
+	// the I/O thread would hold the module while a DdrMap view is fetched
+	// through it; DDR requests are refused by rspStreamerReadHost/WriteHost
+	if (!ddr && rspMirrorOverlaps(data, op == IO_REG_READ || op == IO_REG_WRITE ? 4 : length)) return RSP_INVALID_VALUE;
+
+	rsp_io_request request;
+	request.op = op;
+	request.priority = priority;
+	request.address = address;
+	request.data = data;
+	request.length = op == IO_REG_READ || op == IO_REG_WRITE ? 4 : length;
+	request.submitted = Clock::now();
+
+	std::unique_lock<std::mutex> lock(scheduler->lock);
+	if (scheduler->stopping) return RSP_INVALID_VALUE;
+
+	scheduler->queues[priority].push_back(&request);
+	scheduler->counters->queue_depth.fetch_add(1, std::memory_order_relaxed);
+	scheduler->work.notify_one();
+
+	request.completed.wait(lock, [&] { return request.finished; });
+	return request.result;
+}
+
+void rspSchedulerGetStats(rsp_scheduler *scheduler, IoSchedulerStats *stats)
+{
+	std::lock_guard<std::mutex> guard(scheduler->lock);
+
+	*stats = IoSchedulerStats();
+	stats->pieces = scheduler->pieces;
+	for (int priority = 0; priority < IO_PRIORITY_COUNT; priority++)
+	{
+		const rsp_io_class &io_class = scheduler->classes[priority];
+		IoClassStats &out = stats->classes[priority];
+
+		stats->queued += scheduler->queues[priority].size();
+		out.requests = io_class.requests;
+		out.bytes = io_class.bytes;
+		if (io_class.requests == 0) continue;
+
+		out.meanSeconds = io_class.total_ns * 1e-9 / io_class.requests;
+		out.p50Seconds = percentile(io_class, 0.5);
+		out.p99Seconds = percentile(io_class, 0.99);
+		out.p999Seconds = percentile(io_class, 0.999);
+		out.maxSeconds = io_class.max_ns * 1e-9;
+	}
+}
+
+void rspSchedulerResetStats(rsp_scheduler *scheduler)
+{
+	std::lock_guard<std::mutex> guard(scheduler->lock);
+
+	scheduler->pieces = 0;
+	for (rsp_io_class &io_class : scheduler->classes) io_class = rsp_io_class();
+}
+
+void rspSchedulerStop(rsp_scheduler *scheduler)
+{
+	{
+		std::lock_guard<std::mutex> guard(scheduler->lock);
+		scheduler->stopping = true;
+	}
+	scheduler->work.notify_all();
+	if (scheduler->thread.joinable()) scheduler->thread.join();
+}
+
+void rspSchedulerClose(rsp_scheduler *scheduler)
+{
+	if (!scheduler) return;
+
+	rspSchedulerStop(scheduler);
+	delete scheduler;
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#include "M3202A_Library.h"
+
+// Buckets of the latency histograms: four per power of two nanoseconds
+const uint32_t SCHEDULER_BUCKETS = 256;
+
+// One IoSubmit call, on the stack of the client waiting for it
+struct rsp_io_request
+{
+	IoOp op = IO_REG_READ;
+	IoPriority priority = IO_PRIORITY_NORMAL;
+	uint64_t address = 0;
+	uint32_t *data = nullptr;
+	uint32_t length = 0;         // bytes
+	uint32_t done = 0;           // bytes of a DDR request already issued
+
+	std::chrono::steady_clock::time_point submitted;
+	std::condition_variable completed;
+	bool finished = false;
+	rsp_int result = RSP_SUCCESS;
+};
+
+struct rsp_io_class
+{
+	uint64_t requests = 0;
+	uint64_t bytes = 0;
+	uint64_t total_ns = 0;
+	uint64_t max_ns = 0;
+	uint64_t histogram[SCHEDULER_BUCKETS] = {};
+};
+
+// I/O thread of one module. Clients queue requests by priority class and
+// block until theirs is done; the thread always serves the highest class
+// waiting. DDR requests are issued one host window page at a time and go
+// to the back of their class after each page, so register traffic waits
+// for at most one page of a bulk transfer and bulk clients share the module
+// in turn.
+struct rsp_scheduler
+{
+	const rsp_streamer *streamer = nullptr;
+	rsp_streamer_counters *counters = nullptr;
+
+	std::mutex lock;
+	std::condition_variable work;
+	std::thread thread;
+	bool stopping = false;
+
+	std::deque<rsp_io_request*> queues[IO_PRIORITY_COUNT];
+	uint64_t pieces = 0;
+	rsp_io_class classes[IO_PRIORITY_COUNT];
+};
+
+rsp_scheduler *rspSchedulerOpen(const rsp_streamer *streamer, rsp_int *error);
+
+// Queues the request and waits for it. length is in bytes and ignored for
+// the single register operations.
+rsp_int rspSchedulerSubmit(rsp_scheduler *scheduler,
+                           IoPriority priority,
+                           IoOp op,
+                           uint32_t *data,
+                           uint64_t address,
+                           uint32_t length);
+
+void rspSchedulerGetStats(rsp_scheduler *scheduler, IoSchedulerStats *stats);
+
+void rspSchedulerResetStats(rsp_scheduler *scheduler);
+
+// Serves the requests still queued, then joins the thread. Requests
+// submitted meanwhile are refused.
+void rspSchedulerStop(rsp_scheduler *scheduler);
+
+// rspSchedulerStop, then frees the scheduler. No client may be inside
+// rspSchedulerSubmit: one whose request was just completed may still be
+// re-acquiring the scheduler lock.
+void rspSchedulerClose(rsp_scheduler *scheduler);
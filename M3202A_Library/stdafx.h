@@ -5,14 +5,23 @@
 
 #pragma once
 
+#ifdef _WIN32
 #include "targetver.h"
 
 #define WIN32_LEAN_AND_MEAN             // Exclude rarely-used stuff from Windows headers
 // Windows Header Files:
 #include <windows.h>
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
 
 
 
 // TODO: reference additional headers your program requires here
+#ifdef M3202A_SIMULATED_DEVICE
+#include "rsp_sim.h"
+#else
 #include "rsp.h"
+#endif
 #include "ddr.h"
\ No newline at end of file
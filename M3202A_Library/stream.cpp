@@ -0,0 +1,319 @@
+#include "stdafx.h"
+
+#include "stream.h"
+
+#include <algorithm>
+#include <cstring>
+
+// contiguous bytes that can be consumed starting at head
+static size_t ringReadable(const rsp_stream_ring &ring)
+{
+	return std::min(ring.count, ring.buffer.size() - ring.head);
+}
+
+// contiguous bytes that can be produced starting after the last held byte
+static size_t ringWritable(const rsp_stream_ring &ring)
+{
+	size_t tail = (ring.head + ring.count) % ring.buffer.size();
+	size_t space = ring.buffer.size() - ring.count;
+	return std::min(space, ring.buffer.size() - tail);
+}
+
+static uint8_t *ringTail(rsp_stream_ring &ring)
+{
+	return ring.buffer.data() + (ring.head + ring.count) % ring.buffer.size();
+}
+
+static void ringConsume(rsp_stream_ring &ring, size_t length)
+{
+	ring.head = (ring.head + length) % ring.buffer.size();
+	ring.count -= length;
+}
+
+static void streamFail(rsp_stream *stream, rsp_int returnCode)
+{
+	std::lock_guard<std::mutex> guard(stream->lock);
+	if (stream->error == RSP_SUCCESS) stream->error = returnCode;
+	stream->stopping = true;
+	stream->changed.notify_all();
+}
+
+// Drains to_kernel in chunk_size transfers. A partial chunk only goes out
+// when a flush or close has been requested.
+static void streamWriterThread(rsp_stream *stream)
+{
+	std::unique_lock<std::mutex> guard(stream->lock);
+	while (true)
+	{
+		stream->changed.wait(guard, [stream] {
+			return stream->stopping
+				|| stream->to_kernel.count >= stream->chunk_size
+				|| (stream->flush_requested && stream->to_kernel.count > 0);
+		});
+
+		if (stream->to_kernel.count == 0 || (stream->stopping && stream->error != RSP_SUCCESS))
+		{
+			if (stream->stopping) return;
+			continue;
+		}
+
+		size_t length = std::min(ringReadable(stream->to_kernel), stream->chunk_size);
+		const uint8_t *chunk = stream->to_kernel.buffer.data() + stream->to_kernel.head;
+
+		guard.unlock();
+		rsp_int returnCode = rspKernelInstanceStreamWrite(stream->kernel_inst, stream->index,
+            chunk, length);
+		guard.lock();
+
+		if (returnCode != RSP_SUCCESS)
+		{
+			guard.unlock();
+			streamFail(stream, returnCode);
+			return;
+		}
+
+		ringConsume(stream->to_kernel, length);
+		stream->stats.bytesWritten += length;
+		stream->stats.chunksWritten++;
+		if (stream->to_kernel.count == 0) stream->flush_requested = false;
+		stream->changed.notify_all();
+	}
+}
+
+// Fetches only what readers have asked for, so an idle kernel stream never
+// leaves this thread blocked with data nobody wants.
+static void streamReaderThread(rsp_stream *stream)
+{
+	std::unique_lock<std::mutex> guard(stream->lock);
+	while (true)
+	{
+		stream->changed.wait(guard, [stream] {
+			return stream->stopping
+				|| (stream->read_outstanding > 0 && ringWritable(stream->from_kernel) > 0);
+		});
+
+		if (stream->stopping) return;
+
+		size_t length = std::min(ringWritable(stream->from_kernel), stream->chunk_size);
+		length = std::min(length, stream->read_outstanding);
+		uint8_t *chunk = ringTail(stream->from_kernel);
+
+		guard.unlock();
+		rsp_int returnCode = rspKernelInstanceStreamRead(stream->kernel_inst, stream->index,
+            chunk, length);
+		guard.lock();
+
+		if (returnCode != RSP_SUCCESS)
+		{
+			guard.unlock();
+			streamFail(stream, returnCode);
+			return;
+		}
+
+		stream->from_kernel.count += length;
+		stream->read_outstanding -= length;
+		stream->stats.bytesRead += length;
+		stream->stats.chunksRead++;
+		stream->changed.notify_all();
+	}
+}
+
+// An abandoned stream is freed by whichever of its threads finishes last
+static void streamThread(rsp_stream *stream, void (*body)(rsp_stream *))
+{
+	body(stream);
+
+	bool last;
+	{
+		std::lock_guard<std::mutex> guard(stream->lock);
+		stream->running--;
+		stream->changed.notify_all();
+		last = stream->abandoned && stream->running == 0;
+	}
+	if (last) delete stream;
+}
+
+rsp_stream *rspStreamOpen(rsp_kernel_instance kernel_inst,
+                          size_t index,
+                          size_t chunk_size,
+                          size_t ring_size,
+                          rsp_int *error)
+{
+	if (!kernel_inst)
+	{
+		if (error) *error = RSP_INVALID_KERNEL_INSTANCE;
+		return nullptr;
+	}
+
+	// the ring has to hold at least two chunks so the client can fill one
+	// while the I/O thread is busy with the other
+	if (chunk_size == 0 || chunk_size % STREAM_WORD_BYTES != 0
+		|| ring_size % STREAM_WORD_BYTES != 0 || ring_size < 2 * chunk_size)
+	{
+		if (error) *error = RSP_INVALID_VALUE;
+		return nullptr;
+	}
+
+	rsp_stream *stream = new rsp_stream();
+	stream->kernel_inst = kernel_inst;
+	stream->index = index;
+	stream->chunk_size = chunk_size;
+	stream->to_kernel.buffer.resize(ring_size);
+	stream->from_kernel.buffer.resize(ring_size);
+	stream->opened = std::chrono::steady_clock::now();
+
+	stream->writer = std::thread(streamThread, stream, streamWriterThread);
+	stream->reader = std::thread(streamThread, stream, streamReaderThread);
+
+	if (error) *error = RSP_SUCCESS;
+	return stream;
+}
+
+rsp_int rspStreamWrite(rsp_stream *stream, const void *data, size_t length)
+{
+	if (!stream || (!data && length > 0)) return RSP_INVALID_VALUE;
+	if (length % STREAM_WORD_BYTES != 0) return RSP_INVALID_VALUE;
+
+	const uint8_t *src = static_cast<const uint8_t*>(data);
+
+	std::unique_lock<std::mutex> guard(stream->lock);
+	while (length > 0)
+	{
+		if (ringWritable(stream->to_kernel) == 0 && !stream->stopping)
+		{
+			// backpressure: the writer thread has not caught up yet
+			stream->stats.producerStalls++;
+			stream->changed.wait(guard, [stream] {
+				return stream->stopping || ringWritable(stream->to_kernel) > 0;
+			});
+		}
+		if (stream->stopping) return stream->error != RSP_SUCCESS ? stream->error : RSP_INVALID_VALUE;
+
+		size_t part = std::min(ringWritable(stream->to_kernel), length);
+		uint8_t *dst = ringTail(stream->to_kernel);
+
+		guard.unlock();
+		std::memcpy(dst, src, part);
+		guard.lock();
+
+		stream->to_kernel.count += part;
+		src += part;
+		length -= part;
+		stream->changed.notify_all();
+	}
+	return RSP_SUCCESS;
+}
+
+rsp_int rspStreamRead(rsp_stream *stream, void *data, size_t length)
+{
+	if (!stream || (!data && length > 0)) return RSP_INVALID_VALUE;
+	if (length % STREAM_WORD_BYTES != 0) return RSP_INVALID_VALUE;
+
+	uint8_t *dst = static_cast<uint8_t*>(data);
+
+	std::unique_lock<std::mutex> guard(stream->lock);
+	while (length > 0)
+	{
+		// ask the reader thread for whatever is not already buffered or in flight
+		size_t pending = stream->from_kernel.count + stream->read_outstanding;
+		if (pending < length)
+		{
+			stream->read_outstanding += length - pending;
+			stream->changed.notify_all();
+		}
+
+		if (stream->from_kernel.count == 0 && !stream->stopping)
+		{
+			stream->stats.consumerStalls++;
+			stream->changed.wait(guard, [stream] {
+				return stream->stopping || stream->from_kernel.count > 0;
+			});
+		}
+		if (stream->from_kernel.count == 0)
+		{
+			return stream->error != RSP_SUCCESS ? stream->error : RSP_INVALID_VALUE;
+		}
+
+		size_t part = std::min(ringReadable(stream->from_kernel), length);
+		const uint8_t *src = stream->from_kernel.buffer.data() + stream->from_kernel.head;
+
+		guard.unlock();
+		std::memcpy(dst, src, part);
+		guard.lock();
+
+		ringConsume(stream->from_kernel, part);
+		dst += part;
+		length -= part;
+		stream->changed.notify_all();
+	}
+	return RSP_SUCCESS;
+}
+
+rsp_int rspStreamFlush(rsp_stream *stream)
+{
+	if (!stream) return RSP_INVALID_VALUE;
+
+	std::unique_lock<std::mutex> guard(stream->lock);
+	stream->flush_requested = true;
+	stream->changed.notify_all();
+	stream->changed.wait(guard, [stream] {
+		return stream->stopping || stream->to_kernel.count == 0;
+	});
+
+	return stream->error;
+}
+
+rsp_int rspStreamGetStats(rsp_stream *stream, StreamStats *stats)
+{
+	if (!stream || !stats) return RSP_INVALID_VALUE;
+
+	std::lock_guard<std::mutex> guard(stream->lock);
+	*stats = stream->stats;
+
+	double seconds = std::chrono::duration<double>(
+		std::chrono::steady_clock::now() - stream->opened).count();
+	if (seconds > 0)
+	{
+		stats->writeBytesPerSecond = stats->bytesWritten / seconds;
+		stats->readBytesPerSecond = stats->bytesRead / seconds;
+	}
+	stats->writeQueued = stream->to_kernel.count;
+	stats->readQueued = stream->from_kernel.count;
+
+	return RSP_SUCCESS;
+}
+
+rsp_int rspStreamClose(rsp_stream *stream)
+{
+	if (!stream) return RSP_INVALID_VALUE;
+
+	const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(STREAM_CLOSE_TIMEOUT_MS);
+	std::unique_lock<std::mutex> guard(stream->lock);
+
+	// push out whatever the client left behind before the threads stop
+	stream->flush_requested = true;
+	stream->changed.notify_all();
+	bool flushed = stream->changed.wait_until(guard, deadline, [stream] {
+		return stream->stopping || stream->to_kernel.count == 0;
+	});
+	rsp_int returnCode = flushed ? stream->error : LIBRARY_TIMEOUT;
+
+	stream->stopping = true;
+	stream->changed.notify_all();
+	if (!stream->changed.wait_until(guard, deadline, [stream] { return stream->running == 0; }))
+	{
+		// still inside rspKernelInstanceStreamRead/Write; detached under the
+		// lock so the thread cannot free the stream before
+		stream->abandoned = true;
+		stream->writer.detach();
+		stream->reader.detach();
+		return LIBRARY_TIMEOUT;
+	}
+	guard.unlock();
+
+	stream->writer.join();
+	stream->reader.join();
+
+	delete stream;
+	return returnCode;
+}
\ No newline at end of file
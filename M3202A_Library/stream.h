@@ -0,0 +1,72 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "M3202A_Library.h"
+
+// Kernel streams move data in 64-bit words
+const size_t STREAM_WORD_BYTES = 8;
+
+// How long rspStreamClose waits for the I/O threads to come back from rsp
+const uint32_t STREAM_CLOSE_TIMEOUT_MS = 2000;
+
+// Byte ring shared between one client thread and one stream I/O thread.
+// Only the producer touches the free region and only the consumer touches
+// [head, head + count), so the payload is copied outside of the lock.
+struct rsp_stream_ring
+{
+	std::vector<uint8_t> buffer;
+	size_t head = 0;   // offset of the oldest byte
+	size_t count = 0;  // bytes currently held
+};
+
+// A kernel stream with a ring in each direction. Each direction has its own
+// I/O thread because rspKernelInstanceStreamRead blocks until the kernel has
+// produced data, and a loopback must still be able to push its input.
+struct rsp_stream
+{
+	rsp_kernel_instance kernel_inst = nullptr;
+	size_t index = 0;
+	size_t chunk_size = 0;
+
+	rsp_stream_ring to_kernel;    // filled by StreamWrite, drained by the writer thread
+	rsp_stream_ring from_kernel;  // filled by the reader thread, drained by StreamRead
+	size_t read_outstanding = 0;  // bytes requested by readers but not yet fetched
+	bool flush_requested = false;
+	bool stopping = false;
+	bool abandoned = false;       // closed while an I/O thread was stuck in rsp
+	int running = 2;              // I/O threads that have not finished
+	rsp_int error = RSP_SUCCESS;
+
+	std::mutex lock;
+	std::condition_variable changed;
+	std::thread writer;
+	std::thread reader;
+
+	std::chrono::steady_clock::time_point opened;
+	StreamStats stats = StreamStats();
+};
+
+rsp_stream *rspStreamOpen(rsp_kernel_instance kernel_inst,
+                          size_t index,
+                          size_t chunk_size,
+                          size_t ring_size,
+                          rsp_int *error);
+
+rsp_int rspStreamWrite(rsp_stream *stream, const void *data, size_t length);
+
+rsp_int rspStreamRead(rsp_stream *stream, void *data, size_t length);
+
+rsp_int rspStreamFlush(rsp_stream *stream);
+
+rsp_int rspStreamGetStats(rsp_stream *stream, StreamStats *stats);
+
+// Flushes and stops the I/O threads. A thread blocked in rsp, e.g. a reader
+// waiting for words the kernel never produces, cannot be interrupted: after
+// STREAM_CLOSE_TIMEOUT_MS the stream is handed over to its threads, which free
+// it when the call returns, and LIBRARY_TIMEOUT is returned.
+rsp_int rspStreamClose(rsp_stream *stream);
@@ -0,0 +1,373 @@
+#include "stdafx.h"
+
+#include "telemetry.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+typedef std::chrono::steady_clock Clock;
+
+const size_t TELEMETRY_SAMPLE_WORDS = sizeof(TelemetrySample) / 8;
+
+// TelemetryRingHeader and TelemetrySlot as the library accesses them. Every
+// field another process reads while it changes is an atomic, so the copy of
+// a sample that is being rewritten is merely discarded.
+struct rsp_telemetry_header
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t slots;
+	uint32_t period_ms;
+	std::atomic<uint64_t> published;
+};
+
+struct rsp_telemetry_slot
+{
+	std::atomic<uint64_t> sequence;
+	std::atomic<uint64_t> words[TELEMETRY_SAMPLE_WORDS];
+};
+
+static_assert(sizeof(TelemetrySample) % 8 == 0, "TelemetrySample is copied in 64-bit words");
+static_assert(sizeof(rsp_telemetry_header) == sizeof(TelemetryRingHeader), "ring header layout");
+static_assert(sizeof(rsp_telemetry_slot) == sizeof(TelemetrySlot), "ring slot layout");
+// atomics in memory shared between processes must not be implemented with a lock
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "64-bit atomics are not lock free");
+
+struct rsp_telemetry_mapping
+{
+	uint8_t *base = nullptr;
+	size_t size = 0;
+#ifdef _WIN32
+	HANDLE section = nullptr;
+#endif
+};
+
+// Counters of a module as of the previous sample
+struct rsp_telemetry_source
+{
+	rsp_streamer_counters *counters = nullptr;
+	bool sampled = false;
+	Clock::time_point time;
+	uint64_t bytes_to_ddr = 0;
+	uint64_t bytes_from_ddr = 0;
+	uint64_t dma_busy_ns[2] = {};
+};
+
+static std::mutex sourcesLock;
+static std::map<uint32_t, rsp_telemetry_source> sources;
+
+// Start and stop; the sampler waits on samplerWake for its next period
+static std::mutex samplerLock;
+static std::condition_variable samplerWake;
+static std::thread sampler;
+static bool samplerStopping = false;
+static rsp_telemetry_mapping ring;
+
+static uint32_t currentProcess()
+{
+#ifdef _WIN32
+	return GetCurrentProcessId();
+#else
+	return static_cast<uint32_t>(getpid());
+#endif
+}
+
+static std::string ringName(uint32_t process_id)
+{
+#ifdef _WIN32
+	return "Local\\M3202A_Telemetry_" + std::to_string(process_id);
+#else
+	return "/M3202A_Telemetry_" + std::to_string(process_id);
+#endif
+}
+
+static size_t ringBytes(uint32_t slots)
+{
+	return sizeof(rsp_telemetry_header) + static_cast<size_t>(slots) * sizeof(rsp_telemetry_slot);
+}
+
+static bool createRing(uint32_t slots, rsp_telemetry_mapping *mapping)
+{
+	const std::string name = ringName(currentProcess());
+	const size_t size = ringBytes(slots);
+
+#ifdef _WIN32
+	mapping->section = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+        static_cast<DWORD>(static_cast<uint64_t>(size) >> 32), static_cast<DWORD>(size), name.c_str());
+	if (!mapping->section) return false;
+	mapping->base = static_cast<uint8_t*>(MapViewOfFile(mapping->section, FILE_MAP_ALL_ACCESS, 0, 0, size));
+#else
+	// a ring left behind by a process that had the same id
+	shm_unlink(name.c_str());
+	int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+	if (fd < 0) return false;
+	if (ftruncate(fd, static_cast<off_t>(size)) == 0)
+	{
+		void *base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		if (base != MAP_FAILED) mapping->base = static_cast<uint8_t*>(base);
+	}
+	close(fd);
+	if (!mapping->base) shm_unlink(name.c_str());
+#endif
+	mapping->size = size;
+	return mapping->base != nullptr;
+}
+
+static bool openRing(uint32_t process_id, rsp_telemetry_mapping *mapping)
+{
+	const std::string name = ringName(process_id);
+
+#ifdef _WIN32
+	mapping->section = OpenFileMappingA(FILE_MAP_READ, FALSE, name.c_str());
+	if (!mapping->section) return false;
+	mapping->base = static_cast<uint8_t*>(MapViewOfFile(mapping->section, FILE_MAP_READ, 0, 0, 0));
+	if (!mapping->base) return false;
+
+	MEMORY_BASIC_INFORMATION region;
+	if (VirtualQuery(mapping->base, &region, sizeof(region)) == 0) return false;
+	mapping->size = region.RegionSize;
+#else
+	int fd = shm_open(name.c_str(), O_RDONLY, 0);
+	if (fd < 0) return false;
+	struct stat info;
+	if (fstat(fd, &info) == 0 && info.st_size > 0)
+	{
+		mapping->size = static_cast<size_t>(info.st_size);
+		void *base = mmap(nullptr, mapping->size, PROT_READ, MAP_SHARED, fd, 0);
+		if (base != MAP_FAILED) mapping->base = static_cast<uint8_t*>(base);
+	}
+	close(fd);
+#endif
+	return mapping->base != nullptr && mapping->size >= sizeof(rsp_telemetry_header);
+}
+
+// owner removes the name, a reader only drops its view
+static void closeRing(rsp_telemetry_mapping *mapping, bool owner)
+{
+#ifdef _WIN32
+	if (mapping->base) UnmapViewOfFile(mapping->base);
+	if (mapping->section) CloseHandle(mapping->section);
+	(void)owner;
+#else
+	if (mapping->base) munmap(mapping->base, mapping->size);
+	if (owner) shm_unlink(ringName(currentProcess()).c_str());
+#endif
+	*mapping = rsp_telemetry_mapping();
+}
+
+static rsp_telemetry_header *headerOf(const rsp_telemetry_mapping &mapping)
+{
+	return reinterpret_cast<rsp_telemetry_header*>(mapping.base);
+}
+
+static rsp_telemetry_slot *slotsOf(const rsp_telemetry_mapping &mapping)
+{
+	return reinterpret_cast<rsp_telemetry_slot*>(mapping.base + sizeof(rsp_telemetry_header));
+}
+
+static double perSecond(uint64_t delta, double seconds)
+{
+	return seconds > 0 ? delta / seconds : 0;
+}
+
+// Busy time is booked when a chunk completes, so a chunk longer than the
+// period would read as more than fully busy
+static double busyFraction(uint64_t delta_ns, double seconds)
+{
+	return seconds > 0 ? std::min(1.0, delta_ns * 1e-9 / seconds) : 0;
+}
+
+static TelemetrySample takeSample(uint32_t session, rsp_telemetry_source &source, Clock::time_point now)
+{
+	const rsp_streamer_counters &counters = *source.counters;
+
+	TelemetrySample sample = TelemetrySample();
+	sample.timeNs = static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(now.time_since_epoch()).count());
+	sample.sessionIdx = session;
+	sample.queueDepth = counters.queue_depth.load(std::memory_order_relaxed);
+	sample.bytesToDdr = counters.bytes_to_ddr.load(std::memory_order_relaxed);
+	sample.bytesFromDdr = counters.bytes_from_ddr.load(std::memory_order_relaxed);
+	sample.bytesCopied = counters.bytes_copied.load(std::memory_order_relaxed);
+	sample.pagerSwitches = counters.pager_switches.load(std::memory_order_relaxed);
+
+	uint64_t busy[2];
+	for (int dma = 0; dma < 2; dma++) busy[dma] = counters.dma_busy_ns[dma].load(std::memory_order_relaxed);
+
+	// the first sample of a module only sets the baseline of the rates
+	if (source.sampled)
+	{
+		const double seconds = std::chrono::duration<double>(now - source.time).count();
+		sample.toDdrBytesPerSecond = perSecond(sample.bytesToDdr - source.bytes_to_ddr, seconds);
+		sample.fromDdrBytesPerSecond = perSecond(sample.bytesFromDdr - source.bytes_from_ddr, seconds);
+		for (int dma = 0; dma < 2; dma++)
+		{
+			sample.dmaBusy[dma] = busyFraction(busy[dma] - source.dma_busy_ns[dma], seconds);
+		}
+	}
+
+	source.sampled = true;
+	source.time = now;
+	source.bytes_to_ddr = sample.bytesToDdr;
+	source.bytes_from_ddr = sample.bytesFromDdr;
+	std::copy(busy, busy + 2, source.dma_busy_ns);
+	return sample;
+}
+
+// Sample n goes to slot n % slots; only the sampler thread writes
+static void publish(const rsp_telemetry_mapping &mapping, uint64_t n, const TelemetrySample &sample)
+{
+	rsp_telemetry_header *header = headerOf(mapping);
+	rsp_telemetry_slot &slot = slotsOf(mapping)[n % header->slots];
+	const uint64_t sequence = 2 * (n / header->slots);
+
+	uint64_t words[TELEMETRY_SAMPLE_WORDS];
+	std::memcpy(words, &sample, sizeof(sample));
+
+	slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	for (size_t w = 0; w < TELEMETRY_SAMPLE_WORDS; w++) slot.words[w].store(words[w], std::memory_order_relaxed);
+	slot.sequence.store(sequence + 2, std::memory_order_release);
+
+	header->published.store(n + 1, std::memory_order_release);
+}
+
+static void run(rsp_telemetry_mapping mapping, uint32_t period_ms)
+{
+	const Clock::duration period = std::chrono::milliseconds(period_ms);
+	Clock::time_point next = Clock::now();
+	uint64_t published = 0;
+	std::vector<TelemetrySample> samples;
+
+	std::unique_lock<std::mutex> lock(samplerLock);
+	for (;;)
+	{
+		next += period;
+		if (samplerWake.wait_until(lock, next, [] { return samplerStopping; })) return;
+
+		samples.clear();
+		{
+			std::lock_guard<std::mutex> guard(sourcesLock);
+			const Clock::time_point now = Clock::now();
+			for (auto &source : sources) samples.push_back(takeSample(source.first, source.second, now));
+		}
+		for (const TelemetrySample &sample : samples) publish(mapping, published++, sample);
+
+		// after a stall, carry on from now rather than catching up
+		next = std::max(next, Clock::now() - period);
+	}
+}
+
+void rspTelemetryAddSession(uint32_t session, rsp_kernel_instance kernel_inst)
+{
+	rsp_telemetry_source source;
+	source.counters = &rspStreamerCounters(kernel_inst);
+
+	std::lock_guard<std::mutex> guard(sourcesLock);
+	sources[session] = source;
+}
+
+void rspTelemetryRemoveSession(uint32_t session)
+{
+	std::lock_guard<std::mutex> guard(sourcesLock);
+	sources.erase(session);
+}
+
+rsp_int rspTelemetryStart(uint32_t period_ms, uint32_t slots)
+{
+	if (period_ms == 0) period_ms = TELEMETRY_DEFAULT_PERIOD_MS;
+	if (slots == 0) slots = TELEMETRY_DEFAULT_SLOTS;
+
+	std::lock_guard<std::mutex> guard(samplerLock);
+	if (ring.base) return RSP_INVALID_VALUE;
+
+	if (!createRing(slots, &ring))
+	{
+		closeRing(&ring, true);
+		return RSP_INVALID_VALUE;
+	}
+
+	rsp_telemetry_header *header = headerOf(ring);
+	header->magic = TELEMETRY_MAGIC;
+	header->version = TELEMETRY_VERSION;
+	header->slots = slots;
+	header->period_ms = period_ms;
+	header->published.store(0, std::memory_order_release);
+
+	sampler = std::thread(run, ring, period_ms);
+	return RSP_SUCCESS;
+}
+
+rsp_int rspTelemetryStop()
+{
+	{
+		std::lock_guard<std::mutex> guard(samplerLock);
+		if (!ring.base || samplerStopping) return RSP_INVALID_VALUE;
+		samplerStopping = true;
+	}
+	samplerWake.notify_all();
+	sampler.join();
+
+	std::lock_guard<std::mutex> guard(samplerLock);
+	closeRing(&ring, true);
+	samplerStopping = false;
+	return RSP_SUCCESS;
+}
+
+rsp_int rspTelemetryRead(uint32_t process_id, TelemetrySample *samples, size_t max_samples, size_t *count)
+{
+	if (!samples || !count) return RSP_INVALID_VALUE;
+	*count = 0;
+
+	rsp_telemetry_mapping mapping;
+	if (!openRing(process_id ? process_id : currentProcess(), &mapping))
+	{
+		closeRing(&mapping, false);
+		return RSP_INVALID_VALUE;
+	}
+
+	const rsp_telemetry_header *header = headerOf(mapping);
+	if (header->magic != TELEMETRY_MAGIC || header->version != TELEMETRY_VERSION || header->slots == 0 ||
+        ringBytes(header->slots) > mapping.size)
+	{
+		closeRing(&mapping, false);
+		return RSP_INVALID_VALUE;
+	}
+
+	const uint32_t slots = header->slots;
+	const uint64_t published = header->published.load(std::memory_order_acquire);
+	const uint64_t available = std::min<uint64_t>(published, std::min<uint64_t>(slots, max_samples));
+
+	for (uint64_t n = published - available; n < published; n++)
+	{
+		const rsp_telemetry_slot &slot = slotsOf(mapping)[n % slots];
+		const uint64_t expected = 2 * (n / slots + 1);
+
+		// anything else means the writer has moved on to a later sample
+		if (slot.sequence.load(std::memory_order_acquire) != expected) continue;
+
+		uint64_t words[TELEMETRY_SAMPLE_WORDS];
+		for (size_t w = 0; w < TELEMETRY_SAMPLE_WORDS; w++) words[w] = slot.words[w].load(std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (slot.sequence.load(std::memory_order_relaxed) != expected) continue;
+
+		std::memcpy(&samples[(*count)++], words, sizeof(words));
+	}
+
+	closeRing(&mapping, false);
+	return RSP_SUCCESS;
+}
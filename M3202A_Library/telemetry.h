@@ -0,0 +1,24 @@
+#pragma once
+
+#include "M3202A_Library.h"
+
+const uint32_t TELEMETRY_DEFAULT_PERIOD_MS = 100;
+const uint32_t TELEMETRY_DEFAULT_SLOTS = 1024;
+
+// Modules the sampler publishes, whether or not telemetry is running
+void rspTelemetryAddSession(uint32_t session, rsp_kernel_instance kernel_inst);
+
+void rspTelemetryRemoveSession(uint32_t session);
+
+// Creates the shared memory ring of this process and starts the thread that
+// fills it once per period from the counters of rspStreamerCounters. The
+// transfer paths only ever touch those counters, never the ring.
+rsp_int rspTelemetryStart(uint32_t period_ms, uint32_t slots);
+
+rsp_int rspTelemetryStop();
+
+// Copies the newest samples, at most max_samples and oldest first, from the
+// ring of another process (0 for this one). Takes no lock and does not call
+// into rsp, so it is safe from a monitor that never opened a session.
+// Samples overwritten while being copied are left out.
+rsp_int rspTelemetryRead(uint32_t process_id, TelemetrySample *samples, size_t max_samples, size_t *count);
@@ -0,0 +1,241 @@
+#include "stdafx.h"
+
+#include "trace.h"
+#include "crc.h"
+
+#include <algorithm>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Records are written through a large buffer so a capture costs a memcpy per
+// call and a disk write every few thousand calls
+const size_t TRACE_BUFFER_BYTES = 1024 * 1024;
+
+std::atomic<bool> rspTraceActive(false);
+
+static std::mutex traceLock;
+static std::ofstream traceFile;
+static std::vector<char> traceBuffer;
+static uint32_t traceFlags = 0;
+static rsp_trace_time traceOrigin;
+
+static uint64_t nanoseconds(std::chrono::steady_clock::duration duration)
+{
+	return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count());
+}
+
+static double seconds(uint64_t ns)
+{
+	return ns * 1e-9;
+}
+
+rsp_int rspTraceStart(const char *path, uint32_t flags)
+{
+	if (!path) return RSP_INVALID_VALUE;
+
+	std::lock_guard<std::mutex> guard(traceLock);
+	if (traceFile.is_open()) return RSP_INVALID_VALUE;
+
+	traceBuffer.resize(TRACE_BUFFER_BYTES);
+	traceFile.rdbuf()->pubsetbuf(traceBuffer.data(), traceBuffer.size());
+	traceFile.open(path, std::ios::binary | std::ios::trunc);
+	if (!traceFile.is_open()) return RSP_INVALID_VALUE;
+
+	rsp_trace_header header = { TRACE_MAGIC, TRACE_VERSION, flags, 0 };
+	traceFile.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+	traceFlags = flags;
+	traceOrigin = rspTraceNow();
+	rspTraceActive = true;
+	return RSP_SUCCESS;
+}
+
+rsp_int rspTraceStop()
+{
+	std::lock_guard<std::mutex> guard(traceLock);
+	if (!traceFile.is_open()) return RSP_INVALID_VALUE;
+
+	rspTraceActive = false;
+	traceFile.close();
+	const bool failed = traceFile.fail();
+	traceFile.clear();
+	return failed ? RSP_INVALID_VALUE : RSP_SUCCESS;
+}
+
+void rspTraceRecord(TraceOp op,
+                    rsp_trace_time start,
+                    rsp_int result,
+                    uint64_t address,
+                    uint64_t address2,
+                    uint64_t length,
+                    const void *data)
+{
+	const rsp_trace_time end = rspTraceNow();
+
+	rsp_trace_record record = rsp_trace_record();
+	record.op = static_cast<uint8_t>(op);
+	record.result = result;
+	record.duration = nanoseconds(end - start);
+	record.address = address;
+	record.address2 = address2;
+	record.length = length;
+
+	if (op == TRACE_DDR_CHECKSUM)
+	{
+		record.crc = data ? *static_cast<const uint32_t*>(data) : 0;
+	}
+	else if (data)
+	{
+		// hashed outside the lock so concurrent callers only serialize on the write
+		record.crc = rspCrc32c(0, data, length);
+	}
+
+	std::lock_guard<std::mutex> guard(traceLock);
+	if (!traceFile.is_open()) return;
+
+	const bool registerWrite = op == TRACE_REG_WRITE || op == TRACE_REG_ARRAY_WRITE;
+	const bool ddrWrite = op == TRACE_DDR_WRITE && (traceFlags & TRACE_CAPTURE_DATA);
+	record.has_data = data && (registerWrite || ddrWrite);
+	record.start = start > traceOrigin ? nanoseconds(start - traceOrigin) : 0;
+
+	traceFile.write(reinterpret_cast<const char*>(&record), sizeof(record));
+	if (record.has_data) traceFile.write(static_cast<const char*>(data), static_cast<std::streamsize>(length));
+}
+
+// Issues the call of one record; mismatch tells whether the data read back
+// differs from the capture
+static rsp_int replayRecord(const rsp_streamer *streamer,
+                            const rsp_trace_record &record,
+                            std::vector<uint32_t> &data,
+                            bool *mismatch)
+{
+	rsp_int ret = RSP_INVALID_VALUE;
+	uint32_t crc = 0;
+	// the rsp calls take 32-bit lengths; longer calls failed when captured
+	const uint32_t length = static_cast<uint32_t>(record.length);
+	switch (record.op)
+	{
+	case TRACE_REG_READ:
+		ret = rspKernelInstanceRegisterRead(streamer->kernel_inst, data.data(), record.address);
+		crc = rspCrc32c(0, data.data(), length);
+		break;
+	case TRACE_REG_WRITE:
+		ret = rspKernelInstanceRegisterWrite(streamer->kernel_inst, data[0], record.address);
+		break;
+	case TRACE_REG_ARRAY_READ:
+		ret = rspKernelInstanceArrayRead(streamer->kernel_inst, data.data(), record.address, length);
+		crc = rspCrc32c(0, data.data(), length);
+		break;
+	case TRACE_REG_ARRAY_WRITE:
+		ret = rspKernelInstanceArrayWrite(streamer->kernel_inst, data.data(), record.address, length);
+		break;
+	case TRACE_DDR_READ:
+		ret = rspStreamerReadHost(streamer, static_cast<uint32_t>(record.address), data.data(), length);
+		crc = rspCrc32c(0, data.data(), length);
+		break;
+	case TRACE_DDR_WRITE:
+		ret = rspStreamerWriteHost(streamer, static_cast<uint32_t>(record.address), data.data(), length);
+		break;
+	case TRACE_DDR_COPY:
+		ret = rspStreamerCopyDMA(streamer, RSP_STREAMER_DMA_1, static_cast<uint32_t>(record.address),
+            static_cast<uint32_t>(record.address2), length);
+		break;
+	case TRACE_DDR_CHECKSUM:
+		ret = rspStreamerChecksum(streamer, static_cast<uint32_t>(record.address), length, &crc);
+		break;
+	}
+
+	const bool read = record.op == TRACE_REG_READ || record.op == TRACE_REG_ARRAY_READ ||
+        record.op == TRACE_DDR_READ || record.op == TRACE_DDR_CHECKSUM;
+	*mismatch = read && ret == RSP_SUCCESS && record.result == RSP_SUCCESS && crc != record.crc;
+	return ret;
+}
+
+rsp_int rspTraceReplay(const rsp_streamer *streamer, const char *path, uint32_t flags, TraceReplayStats *stats)
+{
+	if (!streamer || !streamer->kernel_inst || !path || !stats) return RSP_INVALID_VALUE;
+
+	std::vector<char> buffer(TRACE_BUFFER_BYTES);
+	std::ifstream file;
+	file.rdbuf()->pubsetbuf(buffer.data(), buffer.size());
+	file.open(path, std::ios::binary);
+	if (!file.is_open()) return RSP_INVALID_VALUE;
+
+	rsp_trace_header header;
+	if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        header.magic != TRACE_MAGIC || header.version != TRACE_VERSION)
+	{
+		return RSP_INVALID_VALUE;
+	}
+
+	*stats = TraceReplayStats();
+
+	std::vector<uint32_t> data;
+	uint64_t firstStart = 0;
+	uint64_t lastEnd = 0;
+	uint64_t busy = 0;
+	const rsp_trace_time origin = rspTraceNow();
+
+	rsp_trace_record record;
+	while (file.read(reinterpret_cast<char*>(&record), sizeof(record)))
+	{
+		if (record.op >= TRACE_OP_COUNT) return RSP_INVALID_VALUE;
+
+		// no rsp call moves 4 GB at once; skip the record rather than buffer it
+		const bool replayable = record.length <= 0xFFFFFFFF;
+		const size_t words = replayable ? std::max<size_t>(1, static_cast<size_t>((record.length + 3) / 4)) : 1;
+		if (data.size() < words) data.resize(words);
+		if (record.has_data && !replayable)
+		{
+			if (!file.seekg(static_cast<std::streamoff>(record.length), std::ios::cur)) return RSP_INVALID_VALUE;
+		}
+		else if (record.has_data)
+		{
+			if (!file.read(reinterpret_cast<char*>(data.data()), static_cast<std::streamsize>(record.length))) return RSP_INVALID_VALUE;
+		}
+		else if (record.op == TRACE_DDR_WRITE)
+		{
+			// written data was not captured; the transfer still costs the same
+			std::fill(data.begin(), data.begin() + words, 0);
+		}
+
+		if (stats->records == 0) firstStart = record.start;
+		if (flags & TRACE_REPLAY_TIMED)
+		{
+			// calls captured from several threads are not strictly ordered by start
+			const uint64_t offset = record.start > firstStart ? record.start - firstStart : 0;
+			std::this_thread::sleep_until(origin + std::chrono::nanoseconds(offset));
+		}
+
+		bool mismatch = false;
+		const rsp_trace_time start = rspTraceNow();
+		rsp_int ret = replayable ? replayRecord(streamer, record, data, &mismatch) : RSP_INVALID_VALUE;
+		const uint64_t elapsed = nanoseconds(rspTraceNow() - start);
+
+		lastEnd = std::max(lastEnd, record.start + record.duration);
+		busy += record.duration;
+
+		stats->records++;
+		if (ret != RSP_SUCCESS) stats->errors++;
+		if (mismatch) stats->mismatches++;
+
+		TraceOpStats &op = stats->ops[record.op];
+		op.calls++;
+		op.bytes += record.length;
+		op.recordedSeconds += seconds(record.duration);
+		op.replaySeconds += seconds(elapsed);
+		op.maxReplaySeconds = std::max(op.maxReplaySeconds, seconds(elapsed));
+	}
+	if (!file.eof()) return RSP_INVALID_VALUE;
+
+	stats->replaySeconds = seconds(nanoseconds(rspTraceNow() - origin));
+	if (stats->records > 0)
+	{
+		const uint64_t span = lastEnd - firstStart;
+		stats->recordedSeconds = seconds(span);
+		stats->recordedIdleSeconds = seconds(span > busy ? span - busy : 0);
+	}
+	return RSP_SUCCESS;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+
+#include "M3202A_Library.h"
+
+// "M3TR"
+const uint32_t TRACE_MAGIC = 0x5254334D;
+const uint32_t TRACE_VERSION = 2;   // 2: 64-bit record length
+
+#pragma pack(push, 1)
+// Start of a trace file, followed by records up to the end of the file
+struct rsp_trace_header
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t flags;              // TraceFlags of the capture
+	uint32_t reserved;
+};
+
+// One traced call. Register writes are always followed by the words written,
+// DDR writes only in a TRACE_CAPTURE_DATA trace (has_data tells). Only calls
+// of the exports listed under TraceOp are recorded; see there for what is
+// left out.
+struct rsp_trace_record
+{
+	uint8_t op;                  // TraceOp
+	uint8_t has_data;
+	uint16_t reserved;
+	int32_t result;
+	uint64_t start;              // ns since TraceStart
+	uint64_t duration;           // ns
+	uint64_t address;
+	uint64_t address2;           // destination of TRACE_DDR_COPY
+	uint64_t length;             // bytes
+	uint32_t crc;                // CRC32C of the data, the result of TRACE_DDR_CHECKSUM
+};
+#pragma pack(pop)
+
+typedef std::chrono::steady_clock::time_point rsp_trace_time;
+
+// Set while a capture is running so the exports skip tracing cheaply
+extern std::atomic<bool> rspTraceActive;
+
+inline rsp_trace_time rspTraceNow()
+{
+	return std::chrono::steady_clock::now();
+}
+
+rsp_int rspTraceStart(const char *path, uint32_t flags);
+rsp_int rspTraceStop();
+
+// Appends a record for a call entered at start. data is what was written or
+// read, for TRACE_DDR_CHECKSUM the checksum; it may be null for a copy.
+void rspTraceRecord(TraceOp op,
+                    rsp_trace_time start,
+                    rsp_int result,
+                    uint64_t address,
+                    uint64_t address2,
+                    uint64_t length,
+                    const void *data);
+
+// Issues the calls of a trace against streamer, in order and from one thread,
+// and accounts recorded against replayed time per TraceOp
+rsp_int rspTraceReplay(const rsp_streamer *streamer, const char *path, uint32_t flags, TraceReplayStats *stats);
@@ -0,0 +1,176 @@
+#include "stdafx.h"
+
+#include "transfer.h"
+#include "trace.h"
+
+#include <algorithm>
+
+typedef std::chrono::steady_clock Clock;
+
+static rsp_int runChunk(const rsp_transfer *transfer, uint32_t offset, uint32_t part)
+{
+	const uint32_t address = transfer->address + offset;
+	const rsp_trace_time start = rspTraceNow();
+	rsp_int ret = RSP_INVALID_ENUM;
+
+	switch (transfer->op)
+	{
+	case TRANSFER_READ:
+		ret = rspStreamerReadHost(transfer->streamer, address, transfer->data + offset / 4, part);
+		if (rspTraceActive) rspTraceRecord(TRACE_DDR_READ, start, ret, address, 0, part, transfer->data + offset / 4);
+		break;
+	case TRANSFER_WRITE:
+		ret = rspStreamerWriteHost(transfer->streamer, address, transfer->data + offset / 4, part);
+		if (rspTraceActive) rspTraceRecord(TRACE_DDR_WRITE, start, ret, address, 0, part, transfer->data + offset / 4);
+		break;
+	case TRANSFER_COPY:
+		ret = rspStreamerCopyDMA(transfer->streamer, RSP_STREAMER_DMA_1, address,
+            transfer->copy_address + offset, part);
+		if (rspTraceActive) rspTraceRecord(TRACE_DDR_COPY, start, ret, address, transfer->copy_address + offset, part, nullptr);
+		break;
+	}
+	return ret;
+}
+
+static void run(rsp_transfer *transfer)
+{
+	rsp_int result = RSP_SUCCESS;
+	uint32_t offset = 0;
+
+	while (offset < transfer->length)
+	{
+		if (transfer->cancelled)
+		{
+			result = LIBRARY_CANCELLED;
+			break;
+		}
+		if (transfer->has_deadline && Clock::now() >= transfer->deadline)
+		{
+			result = LIBRARY_TIMEOUT;
+			break;
+		}
+
+		const uint32_t part = std::min(transfer->length - offset, TRANSFER_CHUNK_BYTES);
+		result = runChunk(transfer, offset, part);
+		if (result != RSP_SUCCESS) break;
+
+		offset += part;
+		transfer->done = offset;
+		if (transfer->callback && offset < transfer->length)
+		{
+			transfer->callback(transfer->id, offset, transfer->length, transfer->user);
+		}
+	}
+
+	// the DMA may be part way into a page; the next user gets it reset
+	if (transfer->op == TRANSFER_COPY && result != RSP_SUCCESS)
+	{
+		rspStreamerResetDMA(transfer->streamer, RSP_STREAMER_DMA_1);
+	}
+
+	transfer->counters->queue_depth.fetch_sub(1, std::memory_order_relaxed);
+
+	// reported before finished is set, so a waiter has seen every callback
+	if (transfer->callback) transfer->callback(transfer->id, offset, transfer->length, transfer->user);
+
+	{
+		std::lock_guard<std::mutex> guard(transfer->lock);
+		transfer->finished = true;
+		transfer->result = result;
+		transfer->seconds = std::chrono::duration<double>(Clock::now() - transfer->start).count();
+	}
+	transfer->changed.notify_all();
+}
+
+rsp_transfer *rspTransferStart(const rsp_streamer *streamer,
+                               uint32_t id,
+                               TransferOp op,
+                               uint32_t *data,
+                               uint32_t address,
+                               uint32_t copy_address,
+                               uint32_t length,
+                               uint32_t deadline_ms,
+                               TransferCallback callback,
+                               void *user,
+                               rsp_int *error)
+{
+	if (op != TRANSFER_READ && op != TRANSFER_WRITE && op != TRANSFER_COPY)
+	{
+		if (error) *error = RSP_INVALID_ENUM;
+		return nullptr;
+	}
+	if (!streamer || (op != TRANSFER_COPY && !data) || address % 4 != 0 || length % 4 != 0 ||
+        static_cast<uint64_t>(address) + length > 0x100000000ULL ||
+        (op == TRANSFER_COPY && static_cast<uint64_t>(copy_address) + length > 0x100000000ULL))
+	{
+		if (error) *error = RSP_INVALID_VALUE;
+		return nullptr;
+	}
+
+	rsp_transfer *transfer = new rsp_transfer();
+	transfer->streamer = streamer;
+	transfer->counters = &rspStreamerCounters(streamer->kernel_inst);
+	transfer->id = id;
+	transfer->op = op;
+	transfer->data = data;
+	transfer->address = address;
+	transfer->copy_address = copy_address;
+	transfer->length = length;
+	transfer->callback = callback;
+	transfer->user = user;
+	transfer->start = Clock::now();
+	transfer->has_deadline = deadline_ms != 0;
+	transfer->deadline = transfer->start + std::chrono::milliseconds(deadline_ms);
+
+	transfer->counters->queue_depth.fetch_add(1, std::memory_order_relaxed);
+	transfer->worker = std::thread(run, transfer);
+
+	if (error) *error = RSP_SUCCESS;
+	return transfer;
+}
+
+void rspTransferGetProgress(rsp_transfer *transfer, TransferProgress *progress)
+{
+	std::lock_guard<std::mutex> guard(transfer->lock);
+
+	*progress = TransferProgress();
+	progress->bytesDone = transfer->done;
+	progress->bytesTotal = transfer->length;
+	progress->finished = transfer->finished;
+	progress->result = transfer->finished ? transfer->result : RSP_SUCCESS;
+	progress->seconds = transfer->finished ? transfer->seconds :
+        std::chrono::duration<double>(Clock::now() - transfer->start).count();
+}
+
+void rspTransferCancel(rsp_transfer *transfer)
+{
+	transfer->cancelled = true;
+}
+
+rsp_int rspTransferWait(rsp_transfer *transfer, uint32_t timeout_ms)
+{
+	std::unique_lock<std::mutex> lock(transfer->lock);
+	if (timeout_ms == 0)
+	{
+		transfer->changed.wait(lock, [&] { return transfer->finished; });
+	}
+	else if (!transfer->changed.wait_for(lock, std::chrono::milliseconds(timeout_ms), [&] { return transfer->finished; }))
+	{
+		return LIBRARY_TIMEOUT;
+	}
+	return transfer->result;
+}
+
+void rspTransferStop(rsp_transfer *transfer)
+{
+	rspTransferCancel(transfer);
+	if (transfer->worker.joinable()) transfer->worker.join();
+}
+
+void rspTransferClose(rsp_transfer *transfer)
+{
+	if (!transfer) return;
+
+	rspTransferStop(transfer);
+	delete transfer;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "M3202A_Library.h"
+
+// Bytes moved between two checks for cancel and deadline.
+const uint32_t TRANSFER_CHUNK_BYTES = 8 * 1024 * 1024;
+
+// A DdrRead, DdrWrite or DdrCopy run in chunks on its own thread, so that it
+// reports progress and can be stopped between two chunks by a cancel or its
+// deadline.
+struct rsp_transfer
+{
+	const rsp_streamer *streamer = nullptr;
+	rsp_streamer_counters *counters = nullptr;
+	uint32_t id = 0;
+	TransferOp op = TRANSFER_READ;
+	uint32_t *data = nullptr;
+	uint32_t address = 0;
+	uint32_t copy_address = 0;   // destination of TRANSFER_COPY
+	uint32_t length = 0;
+	std::chrono::steady_clock::time_point start;
+	std::chrono::steady_clock::time_point deadline;
+	bool has_deadline = false;
+	TransferCallback callback = nullptr;
+	void *user = nullptr;
+
+	std::atomic<uint32_t> done{ 0 };
+	std::atomic<bool> cancelled{ false };
+
+	std::mutex lock;
+	std::condition_variable changed;
+	bool finished = false;
+	rsp_int result = RSP_SUCCESS;
+	double seconds = 0;
+
+	std::thread worker;
+};
+
+// Starts the transfer thread; deadline_ms 0 lets the transfer take as long as
+// it needs. A copy is done by DMA_1, which is reset when the copy stops early.
+rsp_transfer *rspTransferStart(const rsp_streamer *streamer,
+                               uint32_t id,
+                               TransferOp op,
+                               uint32_t *data,
+                               uint32_t address,
+                               uint32_t copy_address,
+                               uint32_t length,
+                               uint32_t deadline_ms,
+                               TransferCallback callback,
+                               void *user,
+                               rsp_int *error);
+
+void rspTransferGetProgress(rsp_transfer *transfer, TransferProgress *progress);
+
+// Asks the transfer to stop after the chunk in progress
+void rspTransferCancel(rsp_transfer *transfer);
+
+// Waits up to timeout_ms (0 for no limit) for the transfer to finish. Returns
+// the result of the transfer, or LIBRARY_TIMEOUT if it is still running.
+rsp_int rspTransferWait(rsp_transfer *transfer, uint32_t timeout_ms);
+
+// Cancels the transfer if it still runs and joins its thread. The data
+// buffer is no longer used afterwards; the transfer can still be queried.
+void rspTransferStop(rsp_transfer *transfer);
+
+// rspTransferStop, then frees the transfer
+void rspTransferClose(rsp_transfer *transfer);
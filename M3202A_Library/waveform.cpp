@@ -0,0 +1,487 @@
+#include "stdafx.h"
+
+#include "waveform.h"
+#include "crc.h"
+#include "pipeline.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <string>
+
+typedef std::chrono::steady_clock Clock;
+
+static double secondsSince(Clock::time_point start)
+{
+	return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+static int32_t sampleI(uint32_t word)
+{
+	return static_cast<int16_t>(word & 0xFFFF);
+}
+
+static int32_t sampleQ(uint32_t word)
+{
+	return static_cast<int16_t>(word >> 16);
+}
+
+static uint8_t *putVarint(uint8_t *out, int32_t value)
+{
+	uint32_t zigzag = (static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31);
+	while (zigzag >= 0x80)
+	{
+		*out++ = static_cast<uint8_t>(zigzag | 0x80);
+		zigzag >>= 7;
+	}
+	*out++ = static_cast<uint8_t>(zigzag);
+	return out;
+}
+
+// Returns false when the payload ends in the middle of a value
+static bool getVarint(const uint8_t *&in, const uint8_t *end, int32_t *value)
+{
+	uint32_t zigzag = 0;
+	for (int shift = 0; shift < 32; shift += 7)
+	{
+		if (in == end) return false;
+		const uint8_t byte = *in++;
+		zigzag |= static_cast<uint32_t>(byte & 0x7F) << shift;
+		if (!(byte & 0x80))
+		{
+			*value = static_cast<int32_t>(zigzag >> 1) ^ -static_cast<int32_t>(zigzag & 1);
+			return true;
+		}
+	}
+	return false;
+}
+
+// Deltas stay within 17 bits, so a sample takes at most six bytes
+static size_t encodeDelta(const uint32_t *words, size_t count, uint8_t *out)
+{
+	uint8_t *p = out;
+	int32_t i = 0;
+	int32_t q = 0;
+	for (size_t n = 0; n < count; n++)
+	{
+		p = putVarint(p, sampleI(words[n]) - i);
+		p = putVarint(p, sampleQ(words[n]) - q);
+		i = sampleI(words[n]);
+		q = sampleQ(words[n]);
+	}
+	return p - out;
+}
+
+static rsp_int writeBlock(rsp_waveform_writer *writer)
+{
+	const std::vector<uint32_t> &words = writer->pending;
+
+	rsp_waveform_block block = rsp_waveform_block();
+	block.samples = static_cast<uint32_t>(words.size());
+	block.encoding = WAVEFORM_RAW;
+	block.bytes = block.samples * 4;
+	block.crc = rspCrc32c(0, words.data(), words.size() * 4);
+	block.scale = writer->header.scale;
+
+	const char *payload = reinterpret_cast<const char*>(words.data());
+	if (writer->flags & WAVEFORM_DELTA)
+	{
+		writer->encoded.resize(words.size() * 6);
+		const size_t bytes = encodeDelta(words.data(), words.size(), writer->encoded.data());
+		if (bytes < block.bytes)
+		{
+			block.encoding = WAVEFORM_DELTA_VARINT;
+			block.bytes = static_cast<uint32_t>(bytes);
+			payload = reinterpret_cast<const char*>(writer->encoded.data());
+		}
+	}
+
+	writer->index.push_back(writer->offset);
+	writer->file.write(reinterpret_cast<const char*>(&block), sizeof(block));
+	writer->file.write(payload, block.bytes);
+	writer->offset += sizeof(block) + block.bytes;
+
+	writer->header.samples += block.samples;
+	writer->header.blocks++;
+	writer->pending.clear();
+	return writer->file.good() ? RSP_SUCCESS : RSP_INVALID_VALUE;
+}
+
+rsp_waveform_writer *rspWaveformWriterOpen(const char *path, double scale, uint32_t flags, rsp_int *error)
+{
+	rsp_waveform_writer *writer = path ? new rsp_waveform_writer() : nullptr;
+	if (writer) writer->file.open(path, std::ios::binary | std::ios::trunc);
+	if (!writer || !writer->file.is_open())
+	{
+		delete writer;
+		if (error) *error = RSP_INVALID_VALUE;
+		return nullptr;
+	}
+
+	writer->flags = flags;
+	writer->header.magic = WAVEFORM_MAGIC;
+	writer->header.version = WAVEFORM_VERSION;
+	writer->header.block_samples = WAVEFORM_BLOCK_SAMPLES;
+	writer->header.scale = scale;
+	writer->pending.reserve(WAVEFORM_BLOCK_SAMPLES);
+
+	// rewritten with the totals on close
+	writer->file.write(reinterpret_cast<const char*>(&writer->header), sizeof(writer->header));
+	writer->offset = sizeof(writer->header);
+
+	if (error) *error = RSP_SUCCESS;
+	return writer;
+}
+
+rsp_int rspWaveformWriterAppend(rsp_waveform_writer *writer, const uint32_t *iq, size_t length)
+{
+	if (!writer || (!iq && length > 0)) return RSP_INVALID_VALUE;
+
+	while (length > 0)
+	{
+		const size_t part = std::min<size_t>(length, WAVEFORM_BLOCK_SAMPLES - writer->pending.size());
+		writer->pending.insert(writer->pending.end(), iq, iq + part);
+		iq += part;
+		length -= part;
+
+		if (writer->pending.size() == WAVEFORM_BLOCK_SAMPLES)
+		{
+			rsp_int returnCode = writeBlock(writer);
+			if (returnCode != RSP_SUCCESS) return returnCode;
+		}
+	}
+	return RSP_SUCCESS;
+}
+
+rsp_int rspWaveformWriterClose(rsp_waveform_writer *writer)
+{
+	if (!writer) return RSP_INVALID_VALUE;
+
+	rsp_int returnCode = writer->pending.empty() ? RSP_SUCCESS : writeBlock(writer);
+
+	writer->header.index_offset = writer->offset;
+	writer->file.write(reinterpret_cast<const char*>(writer->index.data()), writer->index.size() * sizeof(uint64_t));
+	writer->file.seekp(0);
+	writer->file.write(reinterpret_cast<const char*>(&writer->header), sizeof(writer->header));
+	writer->file.close();
+	if (writer->file.fail() && returnCode == RSP_SUCCESS) returnCode = RSP_INVALID_VALUE;
+
+	delete writer;
+	return returnCode;
+}
+
+// Parses "I,Q" into two doubles; further columns are ignored
+static bool parseLine(const std::string &line, double *i, double *q)
+{
+	const char *text = line.c_str();
+	char *end;
+	*i = std::strtod(text, &end);
+	if (end == text) return false;
+
+	while (*end == ' ' || *end == '\t') end++;
+	if (*end != ',') return false;
+
+	text = end + 1;
+	*q = std::strtod(text, &end);
+	return end != text;
+}
+
+static bool isBlank(const std::string &line)
+{
+	return line.find_first_not_of(" \t\r") == std::string::npos;
+}
+
+rsp_int rspWaveformConvertCsv(const char *csv_path, const char *path, uint32_t flags, double *scale)
+{
+	if (!csv_path || !path || !scale) return RSP_INVALID_VALUE;
+
+	std::ifstream csv(csv_path);
+	if (!csv.is_open()) return RSP_INVALID_VALUE;
+
+	std::string line;
+	double i, q;
+	if (*scale <= 0)
+	{
+		double peak = 0;
+		while (std::getline(csv, line))
+		{
+			if (isBlank(line)) continue;
+			if (!parseLine(line, &i, &q)) return RSP_INVALID_VALUE;
+			peak = std::max(peak, i * i + q * q);
+		}
+		*scale = peak > 0 ? std::sqrt(peak) / INT16_MAX : 1.0;
+
+		csv.clear();
+		csv.seekg(0);
+	}
+
+	rsp_int returnCode;
+	rsp_waveform_writer *writer = rspWaveformWriterOpen(path, *scale, flags, &returnCode);
+	if (!writer) return returnCode;
+
+	const double factor = 1.0 / *scale;
+	std::vector<uint32_t> words;
+	words.reserve(WAVEFORM_BLOCK_SAMPLES);
+
+	while (returnCode == RSP_SUCCESS && std::getline(csv, line))
+	{
+		if (isBlank(line)) continue;
+		if (!parseLine(line, &i, &q))
+		{
+			returnCode = RSP_INVALID_VALUE;
+			break;
+		}
+
+		const double codeI = std::round(i * factor);
+		const double codeQ = std::round(q * factor);
+		if (std::fabs(codeI) > INT16_MAX || std::fabs(codeQ) > INT16_MAX)
+		{
+			// the given scale does not fit the waveform
+			returnCode = RSP_INVALID_VALUE;
+			break;
+		}
+
+		words.push_back(static_cast<uint16_t>(static_cast<int16_t>(codeI)) |
+            static_cast<uint32_t>(static_cast<uint16_t>(static_cast<int16_t>(codeQ))) << 16);
+		if (words.size() == WAVEFORM_BLOCK_SAMPLES)
+		{
+			returnCode = rspWaveformWriterAppend(writer, words.data(), words.size());
+			words.clear();
+		}
+	}
+
+	if (returnCode == RSP_SUCCESS) returnCode = rspWaveformWriterAppend(writer, words.data(), words.size());
+
+	rsp_int closeCode = rspWaveformWriterClose(writer);
+	return returnCode != RSP_SUCCESS ? returnCode : closeCode;
+}
+
+// Sequential decoder over the blocks of a waveform file
+struct rsp_waveform_reader
+{
+	std::ifstream file;
+	rsp_waveform_header header = rsp_waveform_header();
+	std::vector<uint64_t> index;
+	uint64_t file_bytes = 0;
+
+	uint32_t next_block = 0;
+	rsp_waveform_block block = rsp_waveform_block();
+	std::vector<uint8_t> payload;
+	size_t cursor = 0;
+	uint32_t decoded = 0;        // samples of block already returned
+	int32_t i = 0;
+	int32_t q = 0;
+	uint32_t crc = 0;
+
+	uint64_t bytes_read = 0;
+	double read_seconds = 0;
+};
+
+static rsp_int openReader(rsp_waveform_reader *reader, const char *path)
+{
+	if (!path) return RSP_INVALID_VALUE;
+
+	reader->file.open(path, std::ios::binary | std::ios::ate);
+	if (!reader->file.is_open()) return RSP_INVALID_VALUE;
+	reader->file_bytes = static_cast<uint64_t>(reader->file.tellg());
+	reader->file.seekg(0);
+
+	rsp_waveform_header &header = reader->header;
+	if (!reader->file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        header.magic != WAVEFORM_MAGIC || header.version != WAVEFORM_VERSION || header.block_samples == 0 ||
+        header.index_offset + header.blocks * sizeof(uint64_t) > reader->file_bytes)
+	{
+		return RSP_INVALID_VALUE;
+	}
+
+	reader->index.resize(header.blocks);
+	reader->file.seekg(header.index_offset);
+	if (!reader->file.read(reinterpret_cast<char*>(reader->index.data()), header.blocks * sizeof(uint64_t)))
+	{
+		return RSP_INVALID_VALUE;
+	}
+	return RSP_SUCCESS;
+}
+
+static rsp_int loadBlock(rsp_waveform_reader *reader, uint32_t number)
+{
+	if (number >= reader->header.blocks) return RSP_INVALID_VALUE;
+
+	const Clock::time_point start = Clock::now();
+	rsp_waveform_block &block = reader->block;
+	reader->file.seekg(reader->index[number]);
+	if (!reader->file.read(reinterpret_cast<char*>(&block), sizeof(block)) ||
+        block.samples > reader->header.block_samples || block.bytes > block.samples * 6)
+	{
+		return RSP_INVALID_VALUE;
+	}
+
+	reader->payload.resize(block.bytes);
+	if (!reader->file.read(reinterpret_cast<char*>(reader->payload.data()), block.bytes)) return RSP_INVALID_VALUE;
+	if (block.encoding == WAVEFORM_RAW && block.bytes != block.samples * 4) return RSP_INVALID_VALUE;
+	if (block.encoding != WAVEFORM_RAW && block.encoding != WAVEFORM_DELTA_VARINT) return RSP_INVALID_VALUE;
+
+	reader->read_seconds += secondsSince(start);
+	reader->bytes_read += sizeof(block) + block.bytes;
+
+	reader->next_block = number + 1;
+	reader->cursor = 0;
+	reader->decoded = 0;
+	reader->i = 0;
+	reader->q = 0;
+	reader->crc = 0;
+	return RSP_SUCCESS;
+}
+
+// Decodes the next count samples, loading blocks as needed. Every block is
+// checked against its CRC once fully decoded.
+static rsp_int decode(rsp_waveform_reader *reader, uint32_t *out, size_t count)
+{
+	while (count > 0)
+	{
+		if (reader->decoded == reader->block.samples)
+		{
+			rsp_int returnCode = loadBlock(reader, reader->next_block);
+			if (returnCode != RSP_SUCCESS) return returnCode;
+			continue;
+		}
+
+		const uint32_t part = static_cast<uint32_t>(std::min<size_t>(count, reader->block.samples - reader->decoded));
+		if (reader->block.encoding == WAVEFORM_RAW)
+		{
+			std::copy_n(reinterpret_cast<const uint32_t*>(reader->payload.data()) + reader->decoded, part, out);
+		}
+		else
+		{
+			const uint8_t *in = reader->payload.data() + reader->cursor;
+			const uint8_t *end = reader->payload.data() + reader->payload.size();
+			int32_t i = reader->i;
+			int32_t q = reader->q;
+			for (uint32_t n = 0; n < part; n++)
+			{
+				int32_t di, dq;
+				if (!getVarint(in, end, &di) || !getVarint(in, end, &dq)) return RSP_INVALID_VALUE;
+				i += di;
+				q += dq;
+				out[n] = static_cast<uint16_t>(i) | static_cast<uint32_t>(static_cast<uint16_t>(q)) << 16;
+			}
+			reader->cursor = in - reader->payload.data();
+			reader->i = i;
+			reader->q = q;
+		}
+
+		reader->crc = rspCrc32c(reader->crc, out, part * 4);
+		reader->decoded += part;
+		if (reader->decoded == reader->block.samples && reader->crc != reader->block.crc) return RSP_INVALID_VALUE;
+
+		out += part;
+		count -= part;
+	}
+	return RSP_SUCCESS;
+}
+
+rsp_int rspWaveformGetInfo(const char *path, WaveformInfo *info)
+{
+	if (!info) return RSP_INVALID_VALUE;
+
+	rsp_waveform_reader reader;
+	rsp_int returnCode = openReader(&reader, path);
+	if (returnCode != RSP_SUCCESS) return returnCode;
+
+	*info = WaveformInfo();
+	info->samples = reader.header.samples;
+	info->fileBytes = reader.file_bytes;
+	info->blockSamples = reader.header.block_samples;
+	info->blocks = reader.header.blocks;
+	info->scale = reader.header.scale;
+	return RSP_SUCCESS;
+}
+
+rsp_int rspWaveformUpload(const rsp_streamer *streamer,
+                          const char *path,
+                          uint32_t address,
+                          uint64_t first,
+                          uint64_t length,
+                          WaveformUploadStats *stats)
+{
+	if (!streamer || address % 4 != 0) return RSP_INVALID_VALUE;
+
+	const Clock::time_point begin = Clock::now();
+	rsp_waveform_reader reader;
+	rsp_int returnCode = openReader(&reader, path);
+	if (returnCode != RSP_SUCCESS) return returnCode;
+
+	const uint64_t samples = reader.header.samples;
+	if (length == 0 && first < samples) length = samples - first;
+	if (first + length > samples || address + length * 4 > 0x100000000ULL) return RSP_INVALID_VALUE;
+
+	// pieces end on host window pages so no piece pages the window twice
+	const uint32_t piece = std::min(streamer->page_size, WAVEFORM_MAX_PIECE_BYTES);
+	std::vector<uint32_t> buffers[2];
+	buffers[0].resize(piece / 4);
+	buffers[1].resize(piece / 4);
+
+	double writeSeconds = 0;
+	Clock::time_point start = Clock::now();
+
+	// the samples of the first block ahead of first are decoded and dropped
+	if (length > 0)
+	{
+		const uint32_t block = static_cast<uint32_t>(first / reader.header.block_samples);
+		uint64_t skip = first % reader.header.block_samples;
+		returnCode = loadBlock(&reader, block);
+		while (returnCode == RSP_SUCCESS && skip > 0)
+		{
+			const size_t part = static_cast<size_t>(std::min<uint64_t>(skip, piece / 4));
+			returnCode = decode(&reader, buffers[0].data(), part);
+			skip -= part;
+		}
+	}
+	double decodeSeconds = secondsSince(start);
+
+	rsp_pipeline writing;
+	int current = 0;
+	uint64_t remaining = length * 4;
+	while (returnCode == RSP_SUCCESS && remaining > 0)
+	{
+		const uint32_t part = static_cast<uint32_t>(std::min<uint64_t>(remaining, piece - address % piece));
+
+		// the worker writes the previous piece meanwhile
+		start = Clock::now();
+		returnCode = decode(&reader, buffers[current].data(), part / 4);
+		decodeSeconds += secondsSince(start);
+
+		start = Clock::now();
+		rsp_int writeCode = rspPipelineWait(&writing);
+		if (returnCode == RSP_SUCCESS) returnCode = writeCode;
+		writeSeconds += secondsSince(start);
+		if (returnCode != RSP_SUCCESS) break;
+
+		uint32_t *data = buffers[current].data();
+		rspPipelineSubmit(&writing, [streamer, address, data, part] {
+			return rspStreamerWriteHost(streamer, address, data, part);
+		});
+
+		address += part;
+		remaining -= part;
+		current ^= 1;
+	}
+
+	start = Clock::now();
+	rsp_int writeCode = rspPipelineWait(&writing);
+	if (returnCode == RSP_SUCCESS) returnCode = writeCode;
+	writeSeconds += secondsSince(start);
+
+	if (stats)
+	{
+		*stats = WaveformUploadStats();
+		stats->samples = returnCode == RSP_SUCCESS ? length : 0;
+		stats->fileBytes = reader.bytes_read;
+		stats->readSeconds = reader.read_seconds;
+		stats->decodeSeconds = decodeSeconds - reader.read_seconds;
+		stats->writeSeconds = writeSeconds;
+		stats->seconds = secondsSince(begin);
+	}
+	return returnCode;
+}
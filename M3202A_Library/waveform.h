@@ -0,0 +1,84 @@
+#pragma once
+
+#include <fstream>
+#include <vector>
+
+#include "M3202A_Library.h"
+
+// Waveform file: a header, the blocks, then an index holding the file offset
+// of every block. Each block is a rsp_waveform_block followed by its payload
+// and decodes on its own, so an upload can start at any block. All fields
+// are little endian.
+const uint32_t WAVEFORM_MAGIC = 0x314D4657;   // "WFM1"
+const uint32_t WAVEFORM_VERSION = 1;
+
+// IQ samples per block
+const uint32_t WAVEFORM_BLOCK_SAMPLES = 64 * 1024;
+
+// Largest buffer handed to rspStreamerWriteHost by rspWaveformUpload; smaller
+// host window pages are used as they are
+const uint32_t WAVEFORM_MAX_PIECE_BYTES = 4 * 1024 * 1024;
+
+enum WAVEFORM_ENCODING
+{
+	WAVEFORM_RAW = 0,            // the 32-bit words as stored in DDR
+	WAVEFORM_DELTA_VARINT = 1    // I and Q deltas to the previous sample, zigzag LEB128
+};
+
+struct rsp_waveform_header
+{
+	uint32_t magic;
+	uint32_t version;
+	uint64_t samples;
+	uint32_t block_samples;
+	uint32_t blocks;
+	uint64_t index_offset;
+	double scale;
+};
+
+struct rsp_waveform_block
+{
+	uint32_t samples;
+	uint32_t encoding;
+	uint32_t bytes;          // payload following this header
+	uint32_t crc;            // CRC32C of the decoded words
+	double scale;            // the converter writes the file scale into every block
+};
+
+// Collects samples into blocks as they are appended; nothing is readable
+// before rspWaveformWriterClose has written the index.
+struct rsp_waveform_writer
+{
+	std::ofstream file;
+	rsp_waveform_header header = rsp_waveform_header();
+	uint32_t flags = 0;
+	std::vector<uint32_t> pending;
+	std::vector<uint8_t> encoded;
+	std::vector<uint64_t> index;
+	uint64_t offset = 0;
+};
+
+rsp_waveform_writer *rspWaveformWriterOpen(const char *path, double scale, uint32_t flags, rsp_int *error);
+
+rsp_int rspWaveformWriterAppend(rsp_waveform_writer *writer, const uint32_t *iq, size_t length);
+
+// Writes the last block and the index, then frees the writer
+rsp_int rspWaveformWriterClose(rsp_waveform_writer *writer);
+
+// Quantizes the I,Q lines of a CSV file to int16 codes like
+// ScaleToFixedPoint. A scale of 0 or less is replaced by the one that fits
+// the largest magnitude, which takes a first pass over the file.
+rsp_int rspWaveformConvertCsv(const char *csv_path, const char *path, uint32_t flags, double *scale);
+
+rsp_int rspWaveformGetInfo(const char *path, WaveformInfo *info);
+
+// Writes length samples of the file from sample first on (0 for the rest of
+// the file) to DDR at address. Blocks are decoded a host window page at a
+// time into one of two buffers while the other one is being written, so the
+// waveform never has to fit in host memory.
+rsp_int rspWaveformUpload(const rsp_streamer *streamer,
+                          const char *path,
+                          uint32_t address,
+                          uint64_t first,
+                          uint64_t length,
+                          WaveformUploadStats *stats);